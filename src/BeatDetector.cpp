@@ -8,77 +8,347 @@ namespace audiotomidi {
 namespace
 {
 constexpr float kPi = 3.14159265358979323846f;
-constexpr float kMinThreshold = 0.0035f;
+
+// Share of the lookahead spent searching before the threshold crossing for the onset; the rest
+// follows the crossing and catches a peak that arrives after it.
+constexpr float kOnsetSearchFraction = 0.75f;
+
+// The onset is the first sample above this fraction of the window's peak...
+constexpr float kOnsetPeakFraction = 0.1f;
+
+// ...and above this multiple of the noise floor, so background noise is not mistaken for it.
+constexpr float kOnsetNoiseFactor = 4.0f;
+
+// Quiet time before the peak that separates the hit from earlier sound.
+constexpr float kQuietRunMs = 1.0f;
+
+// Mean of a rectified sine over its peak; puts a peak sample on the envelope's scale.
+constexpr float kPeakToEnvelope = 2.0f / kPi;
+
+// The decimated path never runs below this rate.
+constexpr double kMinDecimatedRate = 44100.0;
+
+// Blocks whose peak is below this fraction of minThreshold may skip the per-sample loop.
+constexpr float kSilentPeakFraction = 0.01f;
+
+template <typename Prefilter>
+using EnvelopeDetector = Detector<Prefilter, RectifiedOnePole, AdaptiveNoiseFloor, RefractoryGate>;
+} // namespace
+
+DetectorCoefficients BeatDetector::makeCoefficients(double rate) noexcept
+{
+    DetectorCoefficients coefficients;
+    coefficients.envAlpha = 1.0f - std::exp(-1.0f / (0.001f * envelopeTimeMs * static_cast<float>(rate)));
+    coefficients.noiseAlpha = 1.0f - std::exp(-1.0f / (0.001f * noiseFloorTimeMs * static_cast<float>(rate)));
+    coefficients.lowAlpha = 1.0f - std::exp(-2.0f * kPi * focusLowHz / static_cast<float>(rate));
+    return coefficients;
 }
 
 void BeatDetector::prepare(double sr) noexcept
 {
     sampleRateHz = sr > 0.0 ? sr : 44100.0;
+    fullRate = makeCoefficients(sampleRateHz);
+
+    int decimationFactor = 1;
+    while (decimationFactor < maxDecimationFactor && sampleRateHz / (2 * decimationFactor) >= kMinDecimatedRate)
+        decimationFactor *= 2;
+    decimator.prepare(decimationFactor);
+    decimatedRate = makeCoefficients(sampleRateHz / decimationFactor);
+
+    // The onset search reads back one sample further than the lookahead itself.
+    Params longest;
+    longest.lookaheadMs = maxLookaheadMs;
+    size_t historySize = 1;
+    while (historySize < static_cast<size_t>(getLatencySamples(longest)) + 2)
+        historySize <<= 1;
+    history.assign(historySize, 0.0f);
+    historyMask = static_cast<int>(historySize) - 1;
+
+    silenceDecay = {};
     reset();
 }
 
 void BeatDetector::reset() noexcept
 {
-    envelope = 0.0f;
-    noiseFloor = 0.0f;
-    lowPassed = 0.0f;
-    wasAboveThreshold = false;
-    samplesSinceLastTrigger = static_cast<int>(sampleRateHz);
+    state = {};
+    state.samplesSinceLastTrigger = static_cast<int>(sampleRateHz);
+    std::fill(history.begin(), history.end(), 0.0f);
+    samplePosition = 0;
+    numPendingTriggers = 0;
+    activeLookahead = 0;
+    decimator.reset();
+    decimating = false;
+}
+
+int BeatDetector::getGapSamples(const Params& params) const noexcept
+{
+    return std::max(1, static_cast<int>(params.minGapMs * 0.001f * static_cast<float>(sampleRateHz)));
+}
+
+float BeatDetector::getThresholdLift(float sensitivity) noexcept
+{
+    return (1.0f - std::clamp(sensitivity, 0.0f, 100.0f) * 0.01f) * 0.18f;
+}
+
+int BeatDetector::getLatencySamples(const Params& params) const noexcept
+{
+    const auto lookaheadMs = std::clamp(params.lookaheadMs, 0.0f, maxLookaheadMs);
+    return static_cast<int>(std::lround(0.001 * static_cast<double>(lookaheadMs) * sampleRateHz));
+}
+
+void BeatDetector::locateOnset(PendingTrigger& trigger, int lookahead) const noexcept
+{
+    const auto rectified = [this](std::int64_t position) { return history[static_cast<size_t>(position & historyMask)]; };
+
+    // Called lookahead - searchBack samples after the crossing, so the window ends now.
+    const auto windowStart = trigger.crossingSample - static_cast<int>(kOnsetSearchFraction * static_cast<float>(lookahead));
+    auto peakPosition = samplePosition;
+    float peak = 0.0f;
+    for (auto position = windowStart; position <= samplePosition; ++position)
+    {
+        if (rectified(position) > peak)
+        {
+            peak = rectified(position);
+            peakPosition = position;
+        }
+    }
+
+    // Walk back from the peak to the earliest loud sample not separated from it by a quiet run.
+    const float level = std::max(kOnsetPeakFraction * peak, kOnsetNoiseFactor * trigger.noiseFloor);
+    const int quietRun = std::max(1, static_cast<int>(0.001 * kQuietRunMs * sampleRateHz));
+    auto onset = peakPosition;
+    int quiet = 0;
+    for (auto position = peakPosition; position >= windowStart && quiet < quietRun; --position)
+    {
+        if (rectified(position) >= level)
+        {
+            onset = position;
+            quiet = 0;
+        }
+        else
+        {
+            ++quiet;
+        }
+    }
+
+    // Linear interpolation of where the input crossed the onset level between two samples.
+    float subSample = 0.0f;
+    const float before = rectified(onset - 1);
+    const float at = rectified(onset);
+    if (at > before && before < level)
+    {
+        const float fraction = (level - before) / (at - before);
+        if (fraction < 0.5f)
+        {
+            --onset;
+            subSample = fraction;
+        }
+        else
+        {
+            subSample = fraction - 1.0f;
+        }
+    }
+
+    trigger.emitSample = std::max(samplePosition, onset + lookahead);
+    trigger.subSampleOffset = subSample;
+    trigger.strength = std::clamp((kPeakToEnvelope * peak - trigger.threshold) * 8.0f, 0.0f, 1.0f);
 }
 
 void BeatDetector::processBlock(const float* monoSamples, int numSamples, const Params& params, TriggerBuffer& out) noexcept
 {
     out.count = 0;
+    processRange(monoSamples, 0, numSamples, params, out);
+}
+
+void BeatDetector::processBlock(const float* monoSamples, int numSamples, const Params& params, TriggerBuffer& out, float inputPeak) noexcept
+{
+    out.count = 0;
+    if (inputPeak < kSilentPeakFraction * minThreshold && skipSilentBlock(numSamples, params, out))
+        return;
+
+    processRange(monoSamples, 0, numSamples, params, out);
+}
+
+bool BeatDetector::skipSilentBlock(int numSamples, const Params& params, TriggerBuffer& out) noexcept
+{
+    // Mode switches and lookahead triggers in flight take the per-sample path.
+    const int lookahead = getLatencySamples(params);
+    const bool decimate = decimator.getFactor() > 1 && params.focusLow && lookahead == 0;
+    if (lookahead != activeLookahead || decimate != decimating || numPendingTriggers > 0)
+        return false;
+
+    // With zero input the filter output, the envelope and the noise floor all decay. The envelope
+    // stays below every threshold, and while it is within 0.08 of the noise floor the floor's
+    // target is the envelope itself, so both recurrences are linear and have a closed form.
+    const float silentLevel = kSilentPeakFraction * minThreshold;
+    if ((params.focusLow && std::abs(state.lowPassed) > silentLevel) || state.envelope >= minThreshold
+        || state.envelope > state.noiseFloor + 0.08f)
+        return false;
+
+    const int steps = decimate ? decimator.skip(numSamples) : numSamples;
+    if (steps != silenceDecay.steps || decimate != silenceDecay.decimated)
+    {
+        // envelope[k] = envelope[0] * re^k and noiseFloor[k + 1] = rn * noiseFloor[k] + an * envelope[k + 1],
+        // so noiseFloor[n] = rn^n * noiseFloor[0] + an * re * (rn^n - re^n) / (rn - re) * envelope[0].
+        const auto& coefficients = decimate ? decimatedRate : fullRate;
+        const double re = 1.0 - static_cast<double>(coefficients.envAlpha);
+        const double rn = 1.0 - static_cast<double>(coefficients.noiseAlpha);
+        const double envelopeDecay = std::pow(re, steps);
+        const double noiseFloorDecay = std::pow(rn, steps);
+
+        silenceDecay.steps = steps;
+        silenceDecay.decimated = decimate;
+        silenceDecay.lowPassed = static_cast<float>(std::pow(1.0 - static_cast<double>(coefficients.lowAlpha), steps));
+        silenceDecay.envelope = static_cast<float>(envelopeDecay);
+        silenceDecay.noiseFloor = static_cast<float>(noiseFloorDecay);
+        silenceDecay.envelopeIntoNoiseFloor
+            = static_cast<float>(static_cast<double>(coefficients.noiseAlpha) * re * (noiseFloorDecay - envelopeDecay) / (rn - re));
+    }
+
+    if (params.focusLow)
+        state.lowPassed *= silenceDecay.lowPassed;
+    state.noiseFloor = silenceDecay.noiseFloor * state.noiseFloor + silenceDecay.envelopeIntoNoiseFloor * state.envelope;
+    state.envelope *= silenceDecay.envelope;
+    state.wasAboveThreshold = false;
+    state.samplesSinceLastTrigger += steps * (decimate ? decimator.getFactor() : 1);
 
-    const auto gapSamples = std::max(1, static_cast<int>(params.minGapMs * 0.001f * static_cast<float>(sampleRateHz)));
-    const float sensitivity = std::clamp(params.sensitivity, 0.0f, 100.0f) * 0.01f;
+    if (steps > 0)
+    {
+        out.envelope = state.envelope;
+        out.threshold = std::max(minThreshold, state.noiseFloor + getThresholdLift(params.sensitivity));
+    }
 
-    const float envTimeMs = 8.0f;
-    const float envAlpha = 1.0f - std::exp(-1.0f / (0.001f * envTimeMs * static_cast<float>(sampleRateHz)));
+    if (lookahead > 0)
+        for (int i = 0; i < std::min(numSamples, historyMask + 1); ++i)
+            history[static_cast<size_t>((samplePosition + i) & historyMask)] = 0.0f;
 
-    const float noiseTimeMs = 350.0f;
-    const float noiseAlpha = 1.0f - std::exp(-1.0f / (0.001f * noiseTimeMs * static_cast<float>(sampleRateHz)));
+    samplePosition += numSamples;
+    return true;
+}
 
-    const float lowHz = 180.0f;
-    const float lowAlpha = 1.0f - std::exp(-2.0f * kPi * lowHz / static_cast<float>(sampleRateHz));
+void BeatDetector::processRange(const float* blockSamples, int startSample, int numSamples, const Params& params, TriggerBuffer& out) noexcept
+{
+    DetectorSettings settings;
+    settings.thresholdLift = getThresholdLift(params.sensitivity);
+    settings.minThreshold = minThreshold;
+    settings.gapSamples = getGapSamples(params);
 
-    for (int i = 0; i < numSamples; ++i)
+    const int lookahead = getLatencySamples(params);
+    if (lookahead != activeLookahead)
     {
-        float x = monoSamples[i];
+        activeLookahead = lookahead;
+        numPendingTriggers = 0;
+    }
+
+    const bool decimate = decimator.getFactor() > 1 && params.focusLow && lookahead == 0;
+    if (decimate && !decimating)
+        decimator.reset(); // partial outputs from before the switch are stale
+    decimating = decimate;
 
+    if (lookahead > 0)
+    {
         if (params.focusLow)
+            processLookahead<OnePoleLowPass>(blockSamples, startSample, numSamples, settings, lookahead, out);
+        else
+            processLookahead<PassThrough>(blockSamples, startSample, numSamples, settings, lookahead, out);
+        return;
+    }
+
+    const auto addTrigger = [&out](int sampleOffset, float strength)
+    {
+        if (out.count < static_cast<int>(out.events.size()))
         {
-            lowPassed += lowAlpha * (x - lowPassed);
-            x = lowPassed;
+            auto& event = out.events[static_cast<size_t>(out.count++)];
+            event = {};
+            event.sampleOffset = sampleOffset;
+            event.strength = strength;
         }
+    };
 
-        const float rectified = std::abs(x);
-        envelope += envAlpha * (rectified - envelope);
+    if (decimate)
+    {
+        settings.samplesPerStep = decimator.getFactor();
+        EnvelopeDetector<OnePoleLowPass>::processDecimated(state, decimator, decimatedRate, settings, blockSamples, startSample, numSamples,
+                                                           out.envelope, out.threshold, addTrigger);
+    }
+    else if (params.focusLow)
+    {
+        EnvelopeDetector<OnePoleLowPass>::process(state, fullRate, settings, blockSamples, startSample, numSamples, out.envelope, out.threshold,
+                                                  addTrigger);
+    }
+    else
+    {
+        EnvelopeDetector<PassThrough>::process(state, fullRate, settings, blockSamples, startSample, numSamples, out.envelope, out.threshold,
+                                               addTrigger);
+    }
+
+    samplePosition += numSamples;
+}
 
-        const float noiseTarget = std::min(envelope, noiseFloor + 0.08f);
-        noiseFloor += noiseAlpha * (noiseTarget - noiseFloor);
+// The same stages as EnvelopeDetector, plus the input history and the pending triggers.
+template <typename Prefilter>
+void BeatDetector::processLookahead(const float* blockSamples, int startSample, int numSamples, const DetectorSettings& settings, int lookahead,
+                                    TriggerBuffer& out) noexcept
+{
+    const int locateDelay = lookahead - static_cast<int>(kOnsetSearchFraction * static_cast<float>(lookahead));
+
+    Prefilter prefilter(fullRate, state);
+    RectifiedOnePole follower(fullRate, state);
+    AdaptiveNoiseFloor thresholdPolicy(fullRate, state, settings);
+    RefractoryGate gate(state, settings);
 
-        const float thresholdLift = (1.0f - sensitivity) * 0.18f;
-        const float threshold = std::max(kMinThreshold, noiseFloor + thresholdLift);
-        const bool above = envelope >= threshold;
+    for (int i = startSample; i < startSample + numSamples; ++i)
+    {
+        const float x = prefilter.process(blockSamples[i]);
+        history[static_cast<size_t>(samplePosition & historyMask)] = std::abs(x);
 
-        ++samplesSinceLastTrigger;
+        const float envelope = follower.process(x);
+        const float threshold = thresholdPolicy.process(envelope);
 
-        if (!wasAboveThreshold && above && samplesSinceLastTrigger >= gapSamples)
+        if (gate.process(envelope, threshold) && numPendingTriggers < static_cast<int>(pendingTriggers.size()))
         {
+            auto& trigger = pendingTriggers[static_cast<size_t>(numPendingTriggers++)];
+            trigger.crossingSample = samplePosition;
+            trigger.emitSample = -1;
+            trigger.noiseFloor = thresholdPolicy.noiseFloor;
+            trigger.threshold = threshold;
+        }
+
+        out.envelope = envelope;
+        out.threshold = threshold;
+
+        for (int p = 0; p < numPendingTriggers;)
+        {
+            auto& trigger = pendingTriggers[static_cast<size_t>(p)];
+            if (trigger.emitSample < 0 && samplePosition == trigger.crossingSample + locateDelay)
+                locateOnset(trigger, lookahead);
+
+            if (trigger.emitSample != samplePosition)
+            {
+                ++p;
+                continue;
+            }
+
             if (out.count < static_cast<int>(out.events.size()))
             {
                 auto& event = out.events[static_cast<size_t>(out.count++)];
+                event = {};
                 event.sampleOffset = i;
-                event.strength = std::clamp((envelope - threshold) * 8.0f, 0.0f, 1.0f);
+                event.strength = trigger.strength;
+                event.subSampleOffset = trigger.subSampleOffset;
             }
-            samplesSinceLastTrigger = 0;
+
+            std::move(pendingTriggers.begin() + p + 1, pendingTriggers.begin() + numPendingTriggers, pendingTriggers.begin() + p);
+            --numPendingTriggers;
         }
 
-        wasAboveThreshold = above;
-        out.envelope = envelope;
-        out.threshold = threshold;
+        ++samplePosition;
     }
+
+    prefilter.store(state);
+    follower.store(state);
+    thresholdPolicy.store(state);
+    gate.store(state);
 }
 
 } // namespace audiotomidi
@@ -1,9 +1,36 @@
 #pragma once
 
 #include <array>
+#include <cstdint>
+#include <vector>
+
+#include "DetectorPipeline.h"
 
 namespace audiotomidi {
 
+enum class DetectorEngine
+{
+    Envelope = 0,
+    SpectralFlux = 1,
+    Neural = 2
+};
+
+// Envelope-follower onset detector, built from the stages in DetectorPipeline.h; each block runs
+// the instantiation that matches the parameters. By default a trigger is placed at the sample where the
+// envelope crosses the adaptive threshold, which is a few milliseconds after the transient
+// starts. With Params::lookaheadMs > 0 every crossing is held back: the detector searches the
+// recent input around it for the transient's start and peak, interpolates the start to a
+// fraction of a sample, and emits the trigger exactly getLatencySamples() after that start, with
+// a strength taken from the peak. A host that compensates the reported latency then sees
+// triggers aligned with the waveform.
+//
+// At 88.2 kHz and above with focusLow on (and lookahead off), the input is first decimated by
+// getDecimationFactor() to 44.1/48 kHz with a polyphase FIR, and the filter, envelope and
+// threshold stages run at that rate. Triggers land on the full-rate sample that completed their
+// decimated sample. The FIR is a second-order CIC (triangular) kernel, whose double nulls at
+// every multiple of the reduced rate keep aliases out of the low band. Its group delay is
+// factor - 1 samples and the output step adds at most factor - 1 more, so the extra latency
+// stays below 2 * factor samples (42 us at 192 kHz).
 class BeatDetector
 {
 public:
@@ -12,14 +39,19 @@ public:
         float sensitivity = 60.0f;
         float minGapMs = 120.0f;
         bool focusLow = true;
+        float lookaheadMs = 0.0f; // 0 places triggers at the threshold crossing
     };
 
     struct TriggerEvent
     {
         int sampleOffset = 0;
         float strength = 0.0f;
+        int noteNumber = -1; // -1 uses MidiEngineParams::noteNumber
+        float subSampleOffset = 0.0f; // lookahead mode: onset position minus sampleOffset, in [-0.5, 0.5)
     };
 
+    // Reused for every block. A writer resets each event it fills, so no field of an earlier
+    // trigger survives into a later one.
     struct TriggerBuffer
     {
         std::array<TriggerEvent, 64> events{};
@@ -28,17 +60,94 @@ public:
         float threshold = 0.0f;
     };
 
+    static constexpr float envelopeTimeMs = 8.0f;
+    static constexpr float noiseFloorTimeMs = 350.0f;
+    static constexpr float focusLowHz = 180.0f;
+    static constexpr float minThreshold = 0.0035f;
+    static constexpr float maxLookaheadMs = 20.0f;
+    static constexpr int maxDecimationFactor = PolyphaseDecimator::maxFactor;
+
     void prepare(double sampleRate) noexcept;
     void reset() noexcept;
     void processBlock(const float* monoSamples, int numSamples, const Params& params, TriggerBuffer& out) noexcept;
 
+    // Same, given the block's absolute peak (as returned by downmixToMono). A block far below
+    // minThreshold, arriving while the detector has settled, is not looped over: the envelope,
+    // noise floor and filter decay are advanced in closed form, as if the input were zero. The
+    // state then differs from the per-sample result by at most about the block's peak.
+    void processBlock(const float* monoSamples, int numSamples, const Params& params, TriggerBuffer& out, float inputPeak) noexcept;
+
+    // Processes blockSamples[startSample, startSample + numSamples) and appends its triggers to
+    // out with offsets relative to blockSamples. Lets a caller split one block into slices with
+    // different parameters; out.count is not reset.
+    void processRange(const float* blockSamples, int startSample, int numSamples, const Params& params, TriggerBuffer& out) noexcept;
+
+    int getGapSamples(const Params& params) const noexcept;
+
+    // How far above the noise floor the threshold sits for a sensitivity setting.
+    static float getThresholdLift(float sensitivity) noexcept;
+
+    // Smoothing coefficients of the stages running at rate (the decimated rate behind a decimator).
+    static DetectorCoefficients makeCoefficients(double rate) noexcept;
+
+    // Delay added by the lookahead mode, in samples.
+    int getLatencySamples(const Params& params) const noexcept;
+    double getSampleRate() const noexcept { return sampleRateHz; }
+
+    // The adaptive noise floor as of the end of the last block, before the sensitivity lift.
+    float getNoiseFloor() const noexcept { return state.noiseFloor; }
+
+    // 1 below 88.2 kHz; always divides maxDecimationFactor.
+    int getDecimationFactor() const noexcept { return decimator.getFactor(); }
+
 private:
+    bool skipSilentBlock(int numSamples, const Params& params, TriggerBuffer& out) noexcept;
+
+    template <typename Prefilter>
+    void processLookahead(const float* blockSamples, int startSample, int numSamples, const DetectorSettings& settings, int lookahead,
+                          TriggerBuffer& out) noexcept;
+
     double sampleRateHz = 44100.0;
-    float envelope = 0.0f;
-    float noiseFloor = 0.0f;
-    float lowPassed = 0.0f;
-    bool wasAboveThreshold = false;
-    int samplesSinceLastTrigger = 0;
+    DetectorCoefficients fullRate;
+    DetectorCoefficients decimatedRate;
+    DetectorState state;
+
+    // A threshold crossing waiting for the rest of its lookahead window.
+    struct PendingTrigger
+    {
+        std::int64_t crossingSample = 0;
+        std::int64_t emitSample = -1; // -1 until the onset has been located
+        float noiseFloor = 0.0f;
+        float threshold = 0.0f;
+        float strength = 0.0f;
+        float subSampleOffset = 0.0f;
+    };
+
+    void locateOnset(PendingTrigger& trigger, int lookahead) const noexcept;
+
+    // Rectified detector input, indexed by absolute sample position.
+    std::vector<float> history;
+    int historyMask = 0;
+    std::int64_t samplePosition = 0;
+    int activeLookahead = 0;
+
+    std::array<PendingTrigger, 8> pendingTriggers{};
+    int numPendingTriggers = 0;
+
+    PolyphaseDecimator decimator;
+    bool decimating = false;
+
+    // Per-step decay factors raised to the step count of the last silent block.
+    struct SilenceDecay
+    {
+        int steps = -1;
+        bool decimated = false;
+        float lowPassed = 1.0f;
+        float envelope = 1.0f;
+        float noiseFloor = 1.0f;
+        float envelopeIntoNoiseFloor = 0.0f;
+    };
+    SilenceDecay silenceDecay;
 };
 
 } // namespace audiotomidi
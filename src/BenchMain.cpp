@@ -0,0 +1,759 @@
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include <juce_audio_basics/juce_audio_basics.h>
+
+#include "BeatDetector.h"
+#include "CallbackTelemetry.h"
+#include "DetectorBank.h"
+#include "DownmixKernel.h"
+#include "DrumSampler.h"
+#include "FixedPointDetector.h"
+#include "Int8Kernel.h"
+#include "MidiEngine.h"
+#include "NeuralOnsetDetector.h"
+#include "SpectralFluxDetector.h"
+
+namespace
+{
+struct BenchOptions
+{
+    juce::String filter;
+    juce::File jsonFile;
+    juce::File baselineFile;
+    juce::File writeBaselineFile;
+    double threshold = 0.15;
+    double minSecondsPerRun = 0.02;
+    int runs = 5;
+};
+
+struct BenchResult
+{
+    juce::String name;
+    double nsPerSample = 0.0;
+};
+
+volatile int sink = 0;
+
+// One second of low-level noise with a decaying drum-like hit every 125 ms, so the detector
+// spends time both idle and triggering.
+std::vector<float> makeTestSignal(double sampleRate)
+{
+    const auto length = static_cast<size_t>(sampleRate);
+    std::vector<float> signal(length);
+
+    std::mt19937 rng(1234);
+    std::normal_distribution<float> noise(0.0f, 0.003f);
+    for (auto& s : signal)
+        s = noise(rng);
+
+    const auto hitSpacing = static_cast<size_t>(sampleRate * 0.125);
+    const float omega = 2.0f * 3.14159265f * 70.0f / static_cast<float>(sampleRate);
+    const float decay = 1.0f / static_cast<float>(sampleRate * 0.04);
+    for (size_t start = 0; start < length; start += hitSpacing)
+        for (size_t i = 0; start + i < length && i < hitSpacing; ++i)
+            signal[start + i] += 0.6f * std::exp(-static_cast<float>(i) * decay) * std::sin(omega * static_cast<float>(i));
+
+    return signal;
+}
+
+// Calls processBlock(offset, blockSize) over a cyclic signal until minSecondsPerRun has passed,
+// repeats that `runs` times and keeps the fastest run.
+double measureNsPerSample(const BenchOptions& options, int blockSize, int signalLength, const std::function<void(int)>& processBlock)
+{
+    int offset = 0;
+    auto advance = [&]
+    {
+        processBlock(offset);
+        offset += blockSize;
+        if (offset + blockSize > signalLength)
+            offset = 0;
+    };
+
+    for (int i = 0; i < 8; ++i)
+        advance();
+
+    double best = 1.0e30;
+    for (int run = 0; run < options.runs; ++run)
+    {
+        juce::int64 samples = 0;
+        const auto start = juce::Time::getHighResolutionTicks();
+        double elapsed = 0.0;
+
+        do
+        {
+            for (int i = 0; i < 16; ++i)
+                advance();
+
+            samples += 16 * static_cast<juce::int64>(blockSize);
+            elapsed = juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - start);
+        } while (elapsed < options.minSecondsPerRun);
+
+        best = std::min(best, elapsed * 1.0e9 / static_cast<double>(samples));
+    }
+
+    return best;
+}
+
+class BenchRunner
+{
+public:
+    explicit BenchRunner(const BenchOptions& o) : options(o) {}
+
+    void add(const juce::String& name, int blockSize, int signalLength, const std::function<void(int)>& processBlock)
+    {
+        if (options.filter.isNotEmpty() && !name.contains(options.filter))
+            return;
+
+        const auto ns = measureNsPerSample(options, blockSize, signalLength, processBlock);
+        results.push_back({ name, ns });
+        std::cerr << name << "  " << juce::String(ns, 3) << " ns/sample\n";
+    }
+
+    const std::vector<BenchResult>& getResults() const noexcept { return results; }
+
+private:
+    const BenchOptions& options;
+    std::vector<BenchResult> results;
+};
+
+void benchDetector(BenchRunner& runner)
+{
+    for (const double sampleRate : { 44100.0, 48000.0, 96000.0, 192000.0 })
+    {
+        const auto signal = makeTestSignal(sampleRate);
+        const auto signalLength = static_cast<int>(signal.size());
+
+        for (const bool focusLow : { true, false })
+        {
+            for (const int blockSize : { 16, 64, 256, 1024, 4096, 8192 })
+            {
+                audiotomidi::BeatDetector detector;
+                detector.prepare(sampleRate);
+                audiotomidi::BeatDetector::Params params;
+                params.focusLow = focusLow;
+                audiotomidi::BeatDetector::TriggerBuffer triggers;
+
+                runner.add("detector/focusLow=" + juce::String(focusLow ? "on" : "off") + "/sr=" + juce::String(static_cast<int>(sampleRate))
+                               + "/block=" + juce::String(blockSize),
+                           blockSize,
+                           signalLength,
+                           [&](int offset)
+                           {
+                               detector.processBlock(signal.data() + offset, blockSize, params, triggers);
+                               sink = sink + triggers.count;
+                           });
+            }
+        }
+    }
+}
+
+// The fixed-point variant, on float input (converted per chunk) and on Q15 input as an embedded
+// codec would deliver it; compare with the detector/ cases of the same name.
+void benchFixedPoint(BenchRunner& runner)
+{
+    for (const double sampleRate : { 44100.0, 48000.0, 96000.0 })
+    {
+        const auto signal = makeTestSignal(sampleRate);
+        const auto signalLength = static_cast<int>(signal.size());
+
+        std::vector<audiotomidi::FixedPointBeatDetector::Q15> q15Signal(signal.size());
+        std::transform(signal.begin(), signal.end(), q15Signal.begin(), audiotomidi::FixedPointBeatDetector::toQ15);
+
+        for (const bool q15Input : { false, true })
+        {
+            for (const bool focusLow : { true, false })
+            {
+                for (const int blockSize : { 64, 1024 })
+                {
+                    audiotomidi::FixedPointBeatDetector detector;
+                    detector.prepare(sampleRate);
+                    audiotomidi::BeatDetector::Params params;
+                    params.focusLow = focusLow;
+                    audiotomidi::BeatDetector::TriggerBuffer triggers;
+
+                    runner.add("fixedPoint/input=" + juce::String(q15Input ? "q15" : "float") + "/focusLow=" + juce::String(focusLow ? "on" : "off")
+                                   + "/sr=" + juce::String(static_cast<int>(sampleRate)) + "/block=" + juce::String(blockSize),
+                               blockSize,
+                               signalLength,
+                               [&](int offset)
+                               {
+                                   if (q15Input)
+                                       detector.processBlock(q15Signal.data() + offset, blockSize, params, triggers);
+                                   else
+                                       detector.processBlock(signal.data() + offset, blockSize, params, triggers);
+                                   sink = sink + triggers.count;
+                               });
+                }
+            }
+        }
+    }
+}
+
+// An idle instance: digital silence, with and without the block peak that enables the silence
+// fast path.
+void benchSilentDetector(BenchRunner& runner)
+{
+    for (const double sampleRate : { 48000.0, 192000.0 })
+    {
+        const std::vector<float> silence(static_cast<size_t>(sampleRate), 0.0f);
+        const auto signalLength = static_cast<int>(silence.size());
+
+        for (const bool passPeak : { false, true })
+        {
+            for (const int blockSize : { 64, 512 })
+            {
+                audiotomidi::BeatDetector detector;
+                detector.prepare(sampleRate);
+                audiotomidi::BeatDetector::Params params;
+                audiotomidi::BeatDetector::TriggerBuffer triggers;
+
+                runner.add("detector/silence/peak=" + juce::String(passPeak ? "on" : "off") + "/sr=" + juce::String(static_cast<int>(sampleRate))
+                               + "/block=" + juce::String(blockSize),
+                           blockSize,
+                           signalLength,
+                           [&](int offset)
+                           {
+                               if (passPeak)
+                                   detector.processBlock(silence.data() + offset, blockSize, params, triggers, 0.0f);
+                               else
+                                   detector.processBlock(silence.data() + offset, blockSize, params, triggers);
+                               sink = sink + triggers.count;
+                           });
+            }
+        }
+    }
+}
+
+void benchSpectralFlux(BenchRunner& runner)
+{
+    for (const double sampleRate : { 48000.0, 96000.0 })
+    {
+        const auto signal = makeTestSignal(sampleRate);
+        const auto signalLength = static_cast<int>(signal.size());
+
+        for (const int blockSize : { 64, 512, 4096 })
+        {
+            audiotomidi::SpectralFluxDetector detector;
+            detector.prepare(sampleRate);
+            audiotomidi::BeatDetector::Params params;
+            audiotomidi::BeatDetector::TriggerBuffer triggers;
+
+            runner.add("spectralFlux/sr=" + juce::String(static_cast<int>(sampleRate)) + "/block=" + juce::String(blockSize),
+                       blockSize,
+                       signalLength,
+                       [&](int offset)
+                       {
+                           detector.processBlock(signal.data() + offset, blockSize, params, triggers);
+                           sink = sink + triggers.count;
+                       });
+        }
+    }
+}
+
+constexpr std::array<audiotomidi::SimdIsa, 4> kAllIsas { audiotomidi::SimdIsa::Scalar, audiotomidi::SimdIsa::Sse2,
+                                                        audiotomidi::SimdIsa::Avx2, audiotomidi::SimdIsa::Neon };
+
+void benchNeuralOnset(BenchRunner& runner)
+{
+    constexpr double sampleRate = 48000.0;
+    const auto signal = makeTestSignal(sampleRate);
+    const auto signalLength = static_cast<int>(signal.size());
+
+    for (const auto isa : kAllIsas)
+    {
+        if (!audiotomidi::isSimdIsaSupported(isa))
+            continue;
+
+        for (const int blockSize : { 64, 512 })
+        {
+            audiotomidi::NeuralOnsetDetector detector;
+            detector.prepare(sampleRate, isa);
+            audiotomidi::BeatDetector::Params params;
+            audiotomidi::BeatDetector::TriggerBuffer triggers;
+
+            runner.add("neuralOnset/" + juce::String(audiotomidi::getSimdIsaName(isa)) + "/sr=48000/block=" + juce::String(blockSize),
+                       blockSize,
+                       signalLength,
+                       [&](int offset)
+                       {
+                           detector.processBlock(signal.data() + offset, blockSize, params, triggers);
+                           sink = sink + triggers.count;
+                       });
+        }
+    }
+
+    // The first layer alone, once per 128-sample hop as at 48 kHz.
+    std::mt19937 rng(7);
+    std::uniform_int_distribution<int> dist(-127, 127);
+    std::vector<std::int8_t> weights(static_cast<size_t>(audiotomidi::neuralmodel::hidden1Size * audiotomidi::neuralmodel::inputSize));
+    std::vector<std::int8_t> input(static_cast<size_t>(audiotomidi::neuralmodel::inputSize));
+    for (auto& w : weights)
+        w = static_cast<std::int8_t>(dist(rng));
+    for (auto& x : input)
+        x = static_cast<std::int8_t>(dist(rng));
+    std::array<std::int32_t, audiotomidi::neuralmodel::hidden1Size> out {};
+
+    for (const auto isa : kAllIsas)
+    {
+        if (!audiotomidi::isSimdIsaSupported(isa))
+            continue;
+
+        runner.add("int8MatVec/" + juce::String(audiotomidi::getSimdIsaName(isa)) + "/256x32/hop=128",
+                   128,
+                   128,
+                   [&, isa](int)
+                   {
+                       audiotomidi::int8MatVec(isa, weights.data(), input.data(), audiotomidi::neuralmodel::inputSize,
+                                               audiotomidi::neuralmodel::hidden1Size, out.data());
+                       sink = sink + out[0];
+                   });
+    }
+}
+
+// Times every 64-sample block of ten passes over the test signal at 48 kHz through the neural
+// engine on the best ISA. Every other block computes a frame, so the 99th percentile is the cost
+// of a frame; it must fit in the block's duration. The worst block is printed too, but on a busy
+// machine it mostly measures preemption, so it does not fail the run.
+bool reportNeuralBudget(const BenchOptions& options)
+{
+    if (options.filter.isNotEmpty() && !juce::String("neuralOnset/budget").contains(options.filter))
+        return true;
+
+    constexpr double sampleRate = 48000.0;
+    constexpr int blockSize = 64;
+    const auto signal = makeTestSignal(sampleRate);
+    const auto blocksPerPass = static_cast<int>(signal.size()) / blockSize;
+
+    audiotomidi::NeuralOnsetDetector detector;
+    detector.prepare(sampleRate);
+    audiotomidi::BeatDetector::Params params;
+    audiotomidi::BeatDetector::TriggerBuffer triggers;
+
+    std::vector<double> blockMicros;
+    blockMicros.reserve(static_cast<size_t>(blocksPerPass) * 10);
+    for (int pass = 0; pass < 10; ++pass)
+    {
+        for (int block = 0; block < blocksPerPass; ++block)
+        {
+            const auto start = juce::Time::getHighResolutionTicks();
+            detector.processBlock(signal.data() + block * blockSize, blockSize, params, triggers);
+            blockMicros.push_back(juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - start) * 1.0e6);
+            sink = sink + triggers.count;
+        }
+    }
+
+    std::sort(blockMicros.begin(), blockMicros.end());
+    const double budgetMicros = blockSize / sampleRate * 1.0e6;
+    const double worst = blockMicros.back();
+    const double p99 = blockMicros[blockMicros.size() * 99 / 100];
+
+    std::cerr << "neuralOnset/budget/" << audiotomidi::getSimdIsaName(audiotomidi::getBestSimdIsa()) << "/sr=48000/block=64  p99 "
+              << juce::String(p99, 2) << " us, worst " << juce::String(worst, 2) << " us of " << juce::String(budgetMicros, 0)
+              << " us (p99 " << juce::String(p99 / budgetMicros * 100.0, 1) << "%)" << (p99 > budgetMicros ? "  OVER BUDGET" : "") << "\n";
+    return p99 <= budgetMicros;
+}
+
+void benchDetectorBank(BenchRunner& runner)
+{
+    constexpr double sampleRate = 48000.0;
+    const auto signal = makeTestSignal(sampleRate);
+    const auto signalLength = static_cast<int>(signal.size());
+
+    for (const int lanes : { 4, 16 })
+    {
+        constexpr int blockSize = 512;
+        audiotomidi::DetectorBank bank;
+        bank.prepare(sampleRate);
+        audiotomidi::BeatDetector::Params params;
+        audiotomidi::BeatDetector::TriggerBuffer triggers;
+        std::array<int, audiotomidi::DetectorBank::maxLanes> notes {};
+        std::array<const float*, audiotomidi::DetectorBank::maxLanes> channels {};
+
+        runner.add("detectorBank/lanes=" + juce::String(lanes) + "/sr=48000/block=512",
+                   blockSize,
+                   signalLength,
+                   [&](int offset)
+                   {
+                       channels.fill(signal.data() + offset);
+                       bank.processBlock(channels.data(), lanes, blockSize, params, notes, triggers);
+                       sink = sink + triggers.count;
+                   });
+    }
+
+    // The same 16 channels through 16 separate BeatDetectors; compare with detectorBank/lanes=16.
+    {
+        constexpr int blockSize = 512;
+        std::array<audiotomidi::BeatDetector, audiotomidi::DetectorBank::maxLanes> detectors;
+        for (auto& detector : detectors)
+            detector.prepare(sampleRate);
+        audiotomidi::BeatDetector::Params params;
+        audiotomidi::BeatDetector::TriggerBuffer triggers;
+
+        runner.add("detectorBank/separate=16/sr=48000/block=512",
+                   blockSize,
+                   signalLength,
+                   [&](int offset)
+                   {
+                       for (auto& detector : detectors)
+                       {
+                           detector.processBlock(signal.data() + offset, blockSize, params, triggers);
+                           sink = sink + triggers.count;
+                       }
+                   });
+    }
+}
+
+void benchMidiEngine(BenchRunner& runner)
+{
+    constexpr double sampleRate = 48000.0;
+
+    for (const int blockSize : { 64, 512, 4096 })
+    {
+        for (const int triggersPerBlock : { 1, 16, 64 })
+        {
+            audiotomidi::MidiEngine engine;
+            engine.prepare(sampleRate);
+
+            // Notes on many different note numbers, long enough that even one trigger per 4096
+            // samples adds note-offs faster than they fall due, so once filled below the pending
+            // note-off heap stays full and every trigger first sends the earliest note-off early.
+            audiotomidi::MidiEngineParams params;
+            params.noteLengthMs = 100000;
+            params.velocityMode = audiotomidi::VelocityMode::Dynamic;
+
+            audiotomidi::BeatDetector::TriggerBuffer triggers;
+            triggers.count = triggersPerBlock;
+            for (int i = 0; i < triggersPerBlock; ++i)
+            {
+                auto& event = triggers.events[static_cast<size_t>(i)];
+                event.sampleOffset = i * blockSize / triggersPerBlock;
+                event.strength = static_cast<float>(i % 8) / 8.0f;
+                event.noteNumber = (i * 7) % 128;
+            }
+
+            juce::MidiBuffer midi;
+            midi.ensureSize(static_cast<size_t>(triggersPerBlock) * 32 + 4096);
+
+            audiotomidi::BeatDetector::TriggerBuffer fill;
+            fill.count = static_cast<int>(fill.events.size());
+            for (int i = 0; i < fill.count; ++i)
+                fill.events[static_cast<size_t>(i)].noteNumber = i;
+            while (engine.getNumPendingNoteOffs() < audiotomidi::MidiEngine::maxPendingNoteOffs)
+            {
+                midi.clear();
+                engine.process(fill, midi, blockSize, params);
+            }
+
+            runner.add("midiEngine/triggers=" + juce::String(triggersPerBlock) + "/block=" + juce::String(blockSize),
+                       blockSize,
+                       blockSize * 64,
+                       [&](int)
+                       {
+                           midi.clear();
+                           engine.process(triggers, midi, blockSize, params);
+                           sink = sink + midi.getNumEvents();
+                       });
+        }
+    }
+}
+
+// A kit of 4 velocity layers x 4 round-robin stereo one-shots, each a second long, so voices
+// pile up to the pool size and, at the higher trigger rates, every new hit steals one.
+void benchDrumSampler(BenchRunner& runner)
+{
+    constexpr double sampleRate = 48000.0;
+    constexpr int sampleLength = static_cast<int>(sampleRate);
+
+    std::mt19937 random(11);
+    std::uniform_real_distribution<float> noise(-1.0f, 1.0f);
+    auto set = std::make_unique<audiotomidi::DrumSampler::SampleSet>();
+    set->name = "bench";
+    set->sampleRate = sampleRate;
+    for (int layer = 0; layer < 4; ++layer)
+    {
+        auto& samples = set->layers.emplace_back();
+        for (int roundRobin = 0; roundRobin < 4; ++roundRobin)
+        {
+            auto& sample = samples.emplace_back(2, sampleLength);
+            for (int channel = 0; channel < 2; ++channel)
+                for (int i = 0; i < sampleLength; ++i)
+                    sample.setSample(channel, i, noise(random) * std::exp(-static_cast<float>(i) / 4800.0f));
+        }
+    }
+
+    audiotomidi::DrumSampler sampler;
+    sampler.prepare(sampleRate);
+    sampler.publish(std::move(set));
+    for (int i = 0; i < 500 && sampler.isLoading(); ++i)
+        juce::Thread::sleep(10);
+    sampler.skipBlock();
+
+    for (const int blockSize : { 64, 512 })
+    {
+        for (const int triggersPerBlock : { 1, 4 })
+        {
+            audiotomidi::MidiEngineParams params;
+            params.velocityMode = audiotomidi::VelocityMode::Dynamic;
+
+            audiotomidi::BeatDetector::TriggerBuffer triggers;
+            triggers.count = triggersPerBlock;
+            for (int i = 0; i < triggersPerBlock; ++i)
+            {
+                auto& event = triggers.events[static_cast<size_t>(i)];
+                event.sampleOffset = i * blockSize / triggersPerBlock;
+                event.strength = static_cast<float>(i % 8) / 8.0f;
+            }
+
+            juce::AudioBuffer<float> output(2, blockSize);
+            sampler.reset();
+
+            runner.add("drumSampler/triggers=" + juce::String(triggersPerBlock) + "/block=" + juce::String(blockSize),
+                       blockSize,
+                       blockSize * 64,
+                       [&](int)
+                       {
+                           output.clear();
+                           sampler.process(triggers, output, blockSize, params, 0.5f);
+                           sink = sink + sampler.getNumActiveVoices();
+                       });
+        }
+    }
+}
+
+void benchDownmix(BenchRunner& runner)
+{
+    constexpr int maxChannels = 32;
+    constexpr int maxBlock = 4096;
+
+    std::mt19937 rng(99);
+    std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+    std::vector<std::vector<float>> input(maxChannels, std::vector<float>(maxBlock));
+    for (auto& channel : input)
+        for (auto& s : channel)
+            s = dist(rng);
+
+    std::vector<const float*> pointers;
+    for (auto& channel : input)
+        pointers.push_back(channel.data());
+
+    std::vector<float> mono(maxBlock);
+
+    for (const int channels : { 2, 8, 32 })
+    {
+        for (const int blockSize : { 64, 512, 4096 })
+        {
+            // The per-sample, channel-inner loop the front ends used before the shared kernel.
+            runner.add("downmix/legacy/channels=" + juce::String(channels) + "/block=" + juce::String(blockSize),
+                       blockSize,
+                       blockSize,
+                       [&](int)
+                       {
+                           float peak = 0.0f;
+                           for (int s = 0; s < blockSize; ++s)
+                           {
+                               float m = 0.0f;
+                               for (int c = 0; c < channels; ++c)
+                                   m += pointers[static_cast<size_t>(c)][s];
+                               m *= 1.0f / static_cast<float>(channels);
+                               mono[static_cast<size_t>(s)] = m;
+                               peak = std::max(peak, std::abs(m));
+                           }
+                           sink = sink + static_cast<int>(peak);
+                       });
+
+            for (const auto isa : kAllIsas)
+            {
+                if (!audiotomidi::isSimdIsaSupported(isa))
+                    continue;
+
+                runner.add("downmix/" + juce::String(audiotomidi::getSimdIsaName(isa)) + "/channels=" + juce::String(channels)
+                               + "/block=" + juce::String(blockSize),
+                           blockSize,
+                           blockSize,
+                           [&, isa](int)
+                           {
+                               const auto peak = audiotomidi::downmixToMono(isa, pointers.data(), channels, mono.data(), blockSize);
+                               sink = sink + static_cast<int>(peak);
+                           });
+            }
+        }
+    }
+}
+
+// The instrumentation alone: every mark the plugin makes per callback, with no work between them.
+// Compare with the detector cases to see its share of a callback.
+void benchTelemetry(BenchRunner& runner)
+{
+    using Stage = audiotomidi::CallbackTelemetry::Stage;
+
+    for (const int blockSize : { 32, 64, 512 })
+    {
+        audiotomidi::CallbackTelemetry telemetry;
+        telemetry.prepare(48000.0);
+
+        runner.add("telemetry/block=" + juce::String(blockSize),
+                   blockSize,
+                   48000,
+                   [&](int)
+                   {
+                       telemetry.beginCallback();
+                       telemetry.endStage(Stage::Downmix);
+                       telemetry.endStage(Stage::Detection);
+                       telemetry.endStage(Stage::Midi);
+                       telemetry.endCallback(blockSize);
+                   });
+    }
+}
+
+juce::var resultsToJson(const std::vector<BenchResult>& results)
+{
+    auto root = std::make_unique<juce::DynamicObject>();
+    root->setProperty("version", 1);
+    root->setProperty("cpu", juce::SystemStats::getCpuModel());
+    root->setProperty("downmixIsa", juce::String(audiotomidi::getSimdIsaName(audiotomidi::getBestSimdIsa())));
+
+    juce::Array<juce::var> entries;
+    for (const auto& r : results)
+    {
+        auto entry = std::make_unique<juce::DynamicObject>();
+        entry->setProperty("name", r.name);
+        entry->setProperty("nsPerSample", r.nsPerSample);
+        entries.add(juce::var(entry.release()));
+    }
+    root->setProperty("results", entries);
+
+    return juce::var(root.release());
+}
+
+// Returns the number of cases that got slower than the baseline by more than the threshold.
+int compareWithBaseline(const std::vector<BenchResult>& results, const juce::File& baselineFile, double threshold)
+{
+    if (!baselineFile.existsAsFile())
+    {
+        std::cerr << "Baseline " << baselineFile.getFullPathName() << " not found; record one on this machine with --write-baseline\n";
+        return 1;
+    }
+
+    const auto baseline = juce::JSON::parse(baselineFile);
+    const auto* entries = baseline["results"].getArray();
+    if (entries == nullptr)
+    {
+        std::cerr << "Baseline " << baselineFile.getFullPathName() << " has no results array\n";
+        return 1;
+    }
+
+    if (baseline["cpu"].toString() != juce::SystemStats::getCpuModel())
+        std::cerr << "Baseline was recorded on " << baseline["cpu"].toString() << ", not this CPU; timings may not compare\n";
+
+    int regressions = 0;
+    for (const auto& r : results)
+    {
+        for (const auto& entry : *entries)
+        {
+            if (entry["name"].toString() != r.name)
+                continue;
+
+            const double reference = static_cast<double>(entry["nsPerSample"]);
+            const double ratio = reference > 0.0 ? r.nsPerSample / reference : 1.0;
+            if (ratio > 1.0 + threshold)
+            {
+                ++regressions;
+                std::cerr << "REGRESSION " << r.name << ": " << juce::String(r.nsPerSample, 3) << " ns/sample vs baseline "
+                          << juce::String(reference, 3) << " (+" << juce::String((ratio - 1.0) * 100.0, 1) << "%)\n";
+            }
+            break;
+        }
+    }
+
+    std::cerr << (regressions == 0 ? "No regressions" : juce::String(regressions) + " regression(s)") << " against "
+              << baselineFile.getFileName() << " at a " << juce::String(threshold * 100.0, 0) << "% threshold\n";
+    return regressions;
+}
+
+void printUsage()
+{
+    std::cout << "Usage: AudioToMidiBeatBench [options]\n"
+                 "\n"
+                 "Measures ns/sample of the detectors (float and fixed point), MidiEngine, the sample player, the\n"
+                 "downmix and int8 kernels and the callback telemetry, and checks that the neural engine fits a\n"
+                 "64-sample block at 48 kHz (exit code 2 if not).\n"
+                 "\n"
+                 "Options:\n"
+                 "  --filter=<text>          only run cases whose name contains text\n"
+                 "  --json=<file>            write results as JSON (default: stdout)\n"
+                 "  --baseline=<file>        compare with a baseline recorded on this machine\n"
+                 "  --write-baseline=<file>  write the current results as a new baseline\n"
+                 "  --threshold=<ratio>      allowed slowdown before failing (default: 0.15)\n"
+                 "  --quick                  shorter runs, for smoke testing\n";
+}
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    BenchOptions options;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const juce::String arg(juce::CharPointer_UTF8(argv[i]));
+        const auto value = arg.fromFirstOccurrenceOf("=", false, false);
+        const auto cwd = juce::File::getCurrentWorkingDirectory();
+
+        if (arg.startsWith("--filter="))
+            options.filter = value;
+        else if (arg.startsWith("--json="))
+            options.jsonFile = cwd.getChildFile(value);
+        else if (arg.startsWith("--baseline="))
+            options.baselineFile = cwd.getChildFile(value);
+        else if (arg.startsWith("--write-baseline="))
+            options.writeBaselineFile = cwd.getChildFile(value);
+        else if (arg.startsWith("--threshold="))
+            options.threshold = value.getDoubleValue();
+        else if (arg == "--quick")
+        {
+            options.minSecondsPerRun = 0.002;
+            options.runs = 2;
+        }
+        else
+        {
+            printUsage();
+            return arg == "--help" || arg == "-h" ? 0 : 1;
+        }
+    }
+
+    BenchRunner runner(options);
+    benchDetector(runner);
+    benchSilentDetector(runner);
+    benchFixedPoint(runner);
+    benchSpectralFlux(runner);
+    benchNeuralOnset(runner);
+    benchDetectorBank(runner);
+    benchMidiEngine(runner);
+    benchDrumSampler(runner);
+    benchDownmix(runner);
+    benchTelemetry(runner);
+
+    const auto json = juce::JSON::toString(resultsToJson(runner.getResults()));
+    if (options.jsonFile != juce::File())
+        options.jsonFile.replaceWithText(json);
+    else
+        std::cout << json << "\n";
+
+    if (options.writeBaselineFile != juce::File())
+    {
+        options.writeBaselineFile.replaceWithText(json);
+        std::cerr << "Wrote " << options.writeBaselineFile.getFullPathName() << "\n";
+    }
+
+    const bool withinBudget = reportNeuralBudget(options);
+
+    if (options.baselineFile != juce::File() && compareWithBaseline(runner.getResults(), options.baselineFile, options.threshold) != 0)
+        return 2;
+
+    return withinBudget ? 0 : 2;
+}
@@ -0,0 +1,100 @@
+#include "CallbackTelemetry.h"
+
+#include <algorithm>
+
+namespace audiotomidi {
+
+namespace
+{
+// Stage and callback histograms cover 0-2 and 0-4 ms in 10 and 20 us bins; longer values land in
+// the overflow bin but still count towards the mean and maximum.
+constexpr double kStageRangeMs = 2.0;
+constexpr double kCallbackRangeMs = 4.0;
+constexpr int kNumBins = 200;
+
+constexpr float kLoadSmoothing = 0.05f;
+} // namespace
+
+CallbackTelemetry::CallbackTelemetry()
+    : stageTimes { TimingHistogram { 0.0, kStageRangeMs, kNumBins },
+                   TimingHistogram { 0.0, kStageRangeMs, kNumBins },
+                   TimingHistogram { 0.0, kStageRangeMs, kNumBins } },
+      callbackTimes(0.0, kCallbackRangeMs, kNumBins)
+{
+}
+
+void CallbackTelemetry::prepare(double sampleRate) noexcept
+{
+    sampleRateHz = sampleRate > 0.0 ? sampleRate : 44100.0;
+    secondsPerTick = 1.0 / static_cast<double>(juce::Time::getHighResolutionTicksPerSecond());
+    reset();
+}
+
+void CallbackTelemetry::beginCallback() noexcept
+{
+    callbackStartTicks = juce::Time::getHighResolutionTicks();
+    lastMarkTicks = callbackStartTicks;
+}
+
+double CallbackTelemetry::endStage(Stage stage) noexcept
+{
+    const auto now = juce::Time::getHighResolutionTicks();
+    const double seconds = static_cast<double>(now - lastMarkTicks) * secondsPerTick;
+    lastMarkTicks = now;
+
+    stageTimes[static_cast<size_t>(stage)].record(seconds * 1000.0);
+    return seconds;
+}
+
+void CallbackTelemetry::endCallback(int numSamples) noexcept
+{
+    const double seconds = static_cast<double>(juce::Time::getHighResolutionTicks() - callbackStartTicks) * secondsPerTick;
+    callbackTimes.record(seconds * 1000.0);
+
+    if (numSamples <= 0)
+        return;
+
+    const auto current = static_cast<float>(seconds * sampleRateHz / static_cast<double>(numSamples));
+    const auto previous = load.load(std::memory_order_relaxed);
+    load.store(previous + kLoadSmoothing * (current - previous), std::memory_order_relaxed);
+
+    if (current > peakLoad.load(std::memory_order_relaxed))
+        peakLoad.store(current, std::memory_order_relaxed);
+
+    if (current > 1.0f)
+        overruns.fetch_add(1, std::memory_order_relaxed);
+}
+
+const char* CallbackTelemetry::getStageName(Stage stage) noexcept
+{
+    switch (stage)
+    {
+        case Stage::Downmix: return "downmix";
+        case Stage::Detection: return "detection";
+        case Stage::Midi: return "midi";
+    }
+
+    return "";
+}
+
+void CallbackTelemetry::reset() noexcept
+{
+    for (auto& histogram : stageTimes)
+        histogram.reset();
+    callbackTimes.reset();
+
+    load.store(0.0f, std::memory_order_relaxed);
+    peakLoad.store(0.0f, std::memory_order_relaxed);
+    overruns.store(0, std::memory_order_relaxed);
+}
+
+std::string CallbackTelemetry::toCsv() const
+{
+    std::string csv = "histogram,bin_start_ms,bin_end_ms,count\n";
+    csv += callbackTimes.toCsvRows("callback");
+    for (int stage = 0; stage < numStages; ++stage)
+        csv += stageTimes[static_cast<size_t>(stage)].toCsvRows(getStageName(static_cast<Stage>(stage)));
+    return csv;
+}
+
+} // namespace audiotomidi
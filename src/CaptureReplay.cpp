@@ -0,0 +1,113 @@
+#include "CaptureReplay.h"
+
+#include <vector>
+
+#include <juce_audio_basics/juce_audio_basics.h>
+
+#include "DownmixKernel.h"
+#include "InputCapture.h"
+#include "TriggerEngine.h"
+
+namespace audiotomidi {
+
+namespace
+{
+using Record = InputCapture::Reader::Record;
+
+juce::String describeEvent(int sampleOffset, int size, const juce::uint8* data)
+{
+    auto text = "@" + juce::String(sampleOffset) + " [";
+    for (int i = 0; i < size; ++i)
+        text << (i > 0 ? " " : "") << juce::String::toHexString(static_cast<int>(data[i])).paddedLeft('0', 2);
+    return text + "]";
+}
+
+// Compares one replayed block's MIDI with the captured events; describes the first difference.
+bool matchesCapture(const juce::MidiBuffer& midi, const Record& record, juce::String& difference)
+{
+    if (midi.getNumEvents() != record.numEvents)
+    {
+        difference = juce::String(midi.getNumEvents()) + " events, captured " + juce::String(record.numEvents);
+        return false;
+    }
+
+    int index = 0;
+    for (const auto metadata : midi)
+    {
+        const auto expected = record.getEvent(index++);
+        bool same = metadata.samplePosition == expected.sampleOffset && metadata.numBytes == expected.size;
+        for (int i = 0; same && i < metadata.numBytes; ++i)
+            same = i < static_cast<int>(expected.data.size()) && metadata.data[i] == expected.data[static_cast<size_t>(i)];
+
+        if (!same)
+        {
+            difference = "event " + juce::String(index - 1) + " is " + describeEvent(metadata.samplePosition, metadata.numBytes, metadata.data)
+                       + ", captured " + describeEvent(expected.sampleOffset, expected.size, expected.data.data());
+            return false;
+        }
+    }
+
+    return true;
+}
+} // namespace
+
+CaptureReplayResult replayCapture(const juce::File& file)
+{
+    CaptureReplayResult result;
+    InputCapture::Reader reader(file);
+    TriggerEngine engine;
+
+    std::vector<float> mono;
+    std::vector<const float*> channels;
+    juce::MidiBuffer midi;
+    midi.ensureSize(2048);
+
+    Record record;
+    while (reader.next(record))
+    {
+        if (record.kind == Record::Kind::Session)
+        {
+            result.sampleRate = record.sampleRate;
+            engine.prepare(record.sampleRate);
+            continue;
+        }
+
+        if (record.gapBefore)
+            ++result.numGaps;
+
+        // A single captured channel is the plugin's downmix; raw input channels are downmixed
+        // again with the same kernel, and the captured peak is the one the plugin measured.
+        channels.resize(static_cast<size_t>(record.numChannels));
+        for (int channel = 0; channel < record.numChannels; ++channel)
+            channels[static_cast<size_t>(channel)] = record.getChannel(channel);
+
+        const float* monoChannel = channels[0];
+        if (record.numChannels > 1)
+        {
+            mono.resize(static_cast<size_t>(record.numSamples));
+            downmixToMono(channels.data(), record.numChannels, mono.data(), record.numSamples);
+            monoChannel = mono.data();
+        }
+
+        BeatDetector::TriggerBuffer triggers;
+        engine.detect(monoChannel, channels.data(), record.numChannels, record.numSamples, record.inputPeak, record.params, triggers);
+
+        midi.clear();
+        engine.generateMidi(triggers, midi, record.numSamples, record.params);
+
+        juce::String difference;
+        if (result.firstMismatchBlock < 0 && !matchesCapture(midi, record, difference))
+        {
+            result.firstMismatchBlock = result.numBlocks;
+            result.mismatch = difference;
+        }
+
+        ++result.numBlocks;
+        result.numSamples += record.numSamples;
+        result.numEvents += record.numEvents;
+    }
+
+    return result;
+}
+
+} // namespace audiotomidi
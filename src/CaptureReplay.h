@@ -0,0 +1,22 @@
+#pragma once
+
+#include <juce_core/juce_core.h>
+
+namespace audiotomidi {
+
+struct CaptureReplayResult
+{
+    int numBlocks = 0;
+    int numGaps = 0;
+    int numEvents = 0;
+    juce::int64 numSamples = 0;
+    double sampleRate = 0.0;
+    int firstMismatchBlock = -1; // -1 when every block matched
+    juce::String mismatch;       // the first difference
+};
+
+// Feeds an InputCapture file through a fresh TriggerEngine with the original block sizes and
+// parameters, and compares every block's MIDI with the captured events byte for byte.
+CaptureReplayResult replayCapture(const juce::File& file);
+
+} // namespace audiotomidi
@@ -0,0 +1,92 @@
+#include "ChunkedAnalysis.h"
+
+#include <algorithm>
+
+namespace audiotomidi {
+
+std::int64_t getChunkWarmupSamples(double sampleRate, const BeatDetector::Params& params) noexcept
+{
+    const double seconds = kChunkWarmupSeconds + 0.001 * static_cast<double>(std::max(0.0f, params.minGapMs));
+    return static_cast<std::int64_t>(seconds * sampleRate);
+}
+
+std::vector<AnalysisChunk> planAnalysisChunks(std::int64_t totalSamples, int numChunks, std::int64_t warmupSamples)
+{
+    std::vector<AnalysisChunk> chunks;
+    if (totalSamples <= 0)
+        return chunks;
+
+    // Chunks much shorter than their warm-up would spend most of their time re-reading audio
+    // that the previous chunk already analysed.
+    const auto maxUsefulChunks = std::max<std::int64_t>(1, totalSamples / std::max<std::int64_t>(1, warmupSamples));
+    const auto count = std::clamp<std::int64_t>(numChunks, 1, maxUsefulChunks);
+
+    chunks.reserve(static_cast<size_t>(count));
+    for (std::int64_t i = 0; i < count; ++i)
+    {
+        AnalysisChunk chunk;
+        chunk.start = totalSamples * i / count;
+        chunk.end = totalSamples * (i + 1) / count;
+        // Aligned so a decimating detector samples the same phase as the sequential run.
+        chunk.warmupStart = std::max<std::int64_t>(0, chunk.start - warmupSamples);
+        chunk.warmupStart -= chunk.warmupStart % BeatDetector::maxDecimationFactor;
+        chunks.push_back(chunk);
+    }
+
+    return chunks;
+}
+
+void OnsetAnalyser::prepare(double sampleRate, const BeatDetector::Params& params)
+{
+    detector.prepare(sampleRate);
+    detectorParams = params;
+}
+
+void OnsetAnalyser::begin(const AnalysisChunk& chunk)
+{
+    detector.reset();
+    current = chunk;
+    position = chunk.warmupStart;
+    onsets.clear();
+}
+
+void OnsetAnalyser::process(const float* monoSamples, int numSamples) noexcept
+{
+    detector.processBlock(monoSamples, numSamples, detectorParams, triggers);
+    const auto latency = getLatencySamples();
+
+    for (int i = 0; i < triggers.count; ++i)
+    {
+        const auto& event = triggers.events[static_cast<size_t>(i)];
+        const auto absolute = position + event.sampleOffset - latency;
+        if (absolute >= current.start && absolute < current.end)
+            onsets.push_back({ absolute, event.strength });
+    }
+
+    position += numSamples;
+}
+
+OnsetList stitchOnsets(const std::vector<OnsetList>& chunks, std::int64_t gapSamples)
+{
+    OnsetList merged;
+
+    size_t total = 0;
+    for (const auto& chunk : chunks)
+        total += chunk.size();
+    merged.reserve(total);
+
+    for (const auto& chunk : chunks)
+    {
+        for (const auto& onset : chunk)
+        {
+            if (!merged.empty() && onset.samplePosition - merged.back().samplePosition < gapSamples)
+                continue;
+
+            merged.push_back(onset);
+        }
+    }
+
+    return merged;
+}
+
+} // namespace audiotomidi
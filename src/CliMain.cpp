@@ -0,0 +1,328 @@
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <juce_audio_formats/juce_audio_formats.h>
+
+#include "OfflineConverter.h"
+
+namespace
+{
+constexpr auto kAudioWildcard = "*.wav;*.flac;*.aif;*.aiff";
+
+void printUsage()
+{
+    std::cout << "Usage: AudioToMidiBeatCli [options] <audio files or folders...>\n"
+                 "\n"
+                 "Converts WAV/FLAC/AIFF files to Standard MIDI Files faster than real time.\n"
+                 "\n"
+                 "Options:\n"
+                 "  --out-dir=<dir>          write .mid files here (default: next to each input)\n"
+                 "  --jobs=<n>               number of files converted in parallel (default: all cores)\n"
+                 "  --block-size=<n>         samples per processing block (default: 4096)\n"
+                 "  --split-file             convert files one at a time, each split into --jobs chunks\n"
+                 "                           analysed in parallel (for very long recordings)\n"
+                 "  --scaling                with --split-file, also report the speed-up for 1..jobs\n"
+                 "                           threads and compare against the sequential result\n"
+                 "  --cache-dir=<dir>        onset cache location (default: the user's application data folder)\n"
+                 "  --cache-size-mb=<n>      delete least recently used cache entries beyond this size (default: 512)\n"
+                 "  --no-cache               always decode and analyse, and leave the cache untouched\n"
+                 "  --sensitivity=<0-100>    default 60\n"
+                 "  --min-gap-ms=<ms>        default 120\n"
+                 "  --focus-low=<on|off>     default on\n"
+                 "  --lookahead-ms=<0-20>    refine onsets to the transient start, default 0 (off)\n"
+                 "  --note=<0-127>           default 36\n"
+                 "  --channel=<1-16>         default 1\n"
+                 "  --note-length-ms=<ms>    default 30\n"
+                 "  --velocity-mode=<fixed|dynamic>  default fixed\n"
+                 "  --velocity=<0-127>       fixed velocity, default 100\n"
+                 "  --retrigger=<layer|cut|extend>  default layer\n";
+}
+
+struct CommandLine
+{
+    juce::StringPairArray options;
+    juce::StringArray positional;
+
+    bool has(const juce::String& key) const { return options.getAllKeys().contains(key, true); }
+    juce::String get(const juce::String& key, const juce::String& fallback) const { return options.getValue(key, fallback); }
+};
+
+CommandLine parseCommandLine(int argc, char* argv[])
+{
+    CommandLine cl;
+    for (int i = 1; i < argc; ++i)
+    {
+        const juce::String arg(juce::CharPointer_UTF8(argv[i]));
+        if (arg.startsWith("--"))
+        {
+            const auto body = arg.substring(2);
+            const auto key = body.upToFirstOccurrenceOf("=", false, false);
+            const auto value = body.containsChar('=') ? body.fromFirstOccurrenceOf("=", false, false) : juce::String("1");
+            cl.options.set(key, value);
+        }
+        else if (arg == "-h")
+        {
+            cl.options.set("help", "1");
+        }
+        else
+        {
+            cl.positional.add(arg);
+        }
+    }
+    return cl;
+}
+
+bool parseOnOff(const juce::String& text)
+{
+    return text.equalsIgnoreCase("on") || text.equalsIgnoreCase("true") || text == "1";
+}
+
+audiotomidi::OfflineSettings settingsFromCommandLine(const CommandLine& cl)
+{
+    audiotomidi::OfflineSettings s;
+    s.blockSize = cl.get("block-size", juce::String(s.blockSize)).getIntValue();
+    s.detector.sensitivity = cl.get("sensitivity", juce::String(s.detector.sensitivity)).getFloatValue();
+    s.detector.minGapMs = cl.get("min-gap-ms", juce::String(s.detector.minGapMs)).getFloatValue();
+    s.detector.focusLow = parseOnOff(cl.get("focus-low", "on"));
+    s.detector.lookaheadMs = cl.get("lookahead-ms", juce::String(s.detector.lookaheadMs)).getFloatValue();
+    s.midi.noteNumber = cl.get("note", juce::String(s.midi.noteNumber)).getIntValue();
+    s.midi.midiChannel = cl.get("channel", juce::String(s.midi.midiChannel)).getIntValue();
+    s.midi.noteLengthMs = cl.get("note-length-ms", juce::String(s.midi.noteLengthMs)).getIntValue();
+    s.midi.velocityMode = cl.get("velocity-mode", "fixed").equalsIgnoreCase("dynamic") ? audiotomidi::VelocityMode::Dynamic
+                                                                                       : audiotomidi::VelocityMode::Fixed;
+    s.midi.fixedVelocity = cl.get("velocity", juce::String(s.midi.fixedVelocity)).getIntValue();
+
+    const auto retrigger = cl.get("retrigger", "layer");
+    s.midi.retrigger = retrigger.equalsIgnoreCase("cut")    ? audiotomidi::RetriggerPolicy::Cut
+                     : retrigger.equalsIgnoreCase("extend") ? audiotomidi::RetriggerPolicy::Extend
+                                                            : audiotomidi::RetriggerPolicy::Layer;
+    return s;
+}
+
+juce::Array<juce::File> collectInputs(const juce::StringArray& paths)
+{
+    juce::Array<juce::File> files;
+    for (const auto& path : paths)
+    {
+        const auto file = juce::File::getCurrentWorkingDirectory().getChildFile(path);
+        if (file.isDirectory())
+        {
+            auto found = file.findChildFiles(juce::File::findFiles, true, kAudioWildcard);
+            found.sort();
+            files.addArray(found);
+        }
+        else if (file.existsAsFile())
+        {
+            files.add(file);
+        }
+        else
+        {
+            std::cerr << "Skipping missing input: " << path << "\n";
+        }
+    }
+    return files;
+}
+
+// Times the analysis of one file at increasing thread counts and checks every chunked result
+// against the sequential one.
+void reportScaling(const juce::File& input, const audiotomidi::OfflineSettings& settings, int maxThreads)
+{
+    audiotomidi::OfflineConverter converter(settings);
+
+    audiotomidi::OnsetList reference;
+    audiotomidi::OfflineResult referenceResult;
+    if (!converter.analyse(input, 1, reference, referenceResult))
+        return;
+
+    std::cout << "Scaling for " << input.getFileName() << " (" << juce::String(referenceResult.getAudioSeconds(), 1) << "s, "
+              << reference.size() << " onsets)\n";
+
+    std::vector<int> threadCounts;
+    for (int threads = 1; threads < maxThreads; threads *= 2)
+        threadCounts.push_back(threads);
+    threadCounts.push_back(maxThreads);
+
+    for (const int threads : threadCounts)
+    {
+        audiotomidi::OnsetList onsets;
+        audiotomidi::OfflineResult result;
+        if (!converter.analyse(input, threads, onsets, result))
+            continue;
+
+        size_t positionMismatches = onsets.size() == reference.size() ? 0 : std::max(onsets.size(), reference.size());
+        float maxStrengthError = 0.0f;
+        for (size_t i = 0; positionMismatches == 0 && i < onsets.size(); ++i)
+        {
+            if (onsets[i].samplePosition != reference[i].samplePosition)
+                ++positionMismatches;
+            maxStrengthError = std::max(maxStrengthError, std::abs(onsets[i].strength - reference[i].strength));
+        }
+
+        std::cout << "  threads=" << threads << "  chunks=" << result.numChunks
+                  << "  time=" << juce::String(result.analysisSeconds, 3) << "s"
+                  << "  speed-up=" << juce::String(referenceResult.analysisSeconds / std::max(1.0e-9, result.analysisSeconds), 2) << "x"
+                  << "  position mismatches=" << static_cast<int>(positionMismatches)
+                  << "  max strength error=" << juce::String(maxStrengthError, 6) << "\n";
+    }
+}
+
+juce::File outputFileFor(const juce::File& input, const juce::String& outDir)
+{
+    if (outDir.isEmpty())
+        return input.withFileExtension("mid");
+
+    return juce::File::getCurrentWorkingDirectory().getChildFile(outDir).getChildFile(input.getFileNameWithoutExtension() + ".mid");
+}
+
+// Inputs that would write the same .mid file, such as a/kick.wav and b/kick.wav with --out-dir, or
+// kick.wav next to kick.flac, would overwrite each other's results. Names are compared ignoring
+// case, as the default macOS and Windows file systems do. Returns false after reporting every
+// collision.
+bool checkOutputCollisions(const juce::Array<juce::File>& inputs, const juce::String& outDir)
+{
+    std::map<juce::String, juce::File> firstInputFor;
+    bool ok = true;
+    for (const auto& input : inputs)
+    {
+        const auto output = outputFileFor(input, outDir);
+        const auto [existing, inserted] = firstInputFor.emplace(output.getFullPathName().toLowerCase(), input);
+        if (!inserted)
+        {
+            std::cerr << "Output collision: " << existing->second.getFullPathName() << " and " << input.getFullPathName()
+                      << " would both write " << output.getFullPathName() << "\n";
+            ok = false;
+        }
+    }
+
+    if (!ok)
+        std::cerr << "Rename the inputs or convert them in separate runs with different --out-dir folders.\n";
+
+    return ok;
+}
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    const auto cl = parseCommandLine(argc, argv);
+    if (cl.has("help") || cl.positional.isEmpty())
+    {
+        printUsage();
+        return cl.has("help") ? 0 : 1;
+    }
+
+    const auto settings = settingsFromCommandLine(cl);
+    const auto inputs = collectInputs(cl.positional);
+    if (inputs.isEmpty())
+    {
+        std::cerr << "No audio files found.\n";
+        return 1;
+    }
+
+    const auto outDir = cl.get("out-dir", {});
+    if (!checkOutputCollisions(inputs, outDir))
+        return 1;
+
+    const bool splitFiles = cl.has("split-file");
+    const int cpuJobs = std::max(1, cl.get("jobs", juce::String(juce::SystemStats::getNumCpus())).getIntValue());
+    const int jobs = splitFiles ? cpuJobs : std::min(cpuJobs, inputs.size());
+
+    // Onsets depend only on the audio and the detection settings, so a run that changes MIDI
+    // settings alone renders from the cache without decoding anything.
+    std::unique_ptr<audiotomidi::OnsetCache> cache;
+    if (!cl.has("no-cache"))
+    {
+        const auto cacheDir = cl.get("cache-dir", {});
+        const auto cacheMegabytes = std::max(0, cl.get("cache-size-mb", "512").getIntValue());
+        cache = std::make_unique<audiotomidi::OnsetCache>(cacheDir.isEmpty() ? audiotomidi::OnsetCache::getDefaultDirectory()
+                                                                               : juce::File::getCurrentWorkingDirectory().getChildFile(cacheDir),
+                                                          static_cast<juce::int64>(cacheMegabytes) * 1024 * 1024);
+    }
+
+    std::vector<audiotomidi::OfflineResult> results(static_cast<size_t>(inputs.size()));
+    std::atomic<int> nextIndex { 0 };
+
+    const auto startTicks = juce::Time::getHighResolutionTicks();
+
+    if (splitFiles)
+    {
+        audiotomidi::OfflineConverter converter(settings);
+        converter.setCache(cache.get());
+        for (int i = 0; i < inputs.size(); ++i)
+            results[static_cast<size_t>(i)] = converter.convert(inputs[i], outputFileFor(inputs[i], outDir), jobs);
+    }
+    else
+    {
+        std::vector<std::thread> workers;
+        workers.reserve(static_cast<size_t>(jobs));
+        for (int w = 0; w < jobs; ++w)
+        {
+            workers.emplace_back([&]
+            {
+                audiotomidi::OfflineConverter converter(settings);
+                converter.setCache(cache.get());
+                for (int i = nextIndex.fetch_add(1); i < inputs.size(); i = nextIndex.fetch_add(1))
+                    results[static_cast<size_t>(i)] = converter.convert(inputs[i], outputFileFor(inputs[i], outDir));
+            });
+        }
+
+        for (auto& worker : workers)
+            worker.join();
+    }
+
+    const double wallSeconds = juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - startTicks);
+
+    int failures = 0;
+    double audioSeconds = 0.0;
+    double cpuSeconds = 0.0;
+
+    for (const auto& r : results)
+    {
+        if (!r.ok)
+        {
+            ++failures;
+            std::cerr << "FAILED " << r.input.getFullPathName() << ": " << r.error << "\n";
+            continue;
+        }
+
+        audioSeconds += r.getAudioSeconds();
+        cpuSeconds += r.processingSeconds;
+        std::cout << r.input.getFileName() << " -> " << r.output.getFullPathName()
+                  << "  triggers=" << r.numTriggers
+                  << (r.numChunks > 1 ? "  chunks=" + juce::String(r.numChunks) : juce::String())
+                  << "  audio=" << juce::String(r.getAudioSeconds(), 2) << "s"
+                  << "  speed=" << juce::String(r.getAudioSeconds() / std::max(1.0e-9, r.processingSeconds), 1) << "x"
+                  << (r.fromCache ? "  (cached)" : "") << "\n";
+    }
+
+    const double realtimeFactor = audioSeconds / std::max(1.0e-9, wallSeconds);
+    std::cout << "\nConverted " << (results.size() - static_cast<size_t>(failures)) << "/" << results.size() << " files: "
+              << juce::String(audioSeconds, 1) << "s of audio in " << juce::String(wallSeconds, 2) << "s using " << jobs << " worker(s)\n"
+              << "Throughput: " << juce::String(realtimeFactor, 1) << "x real time, "
+              << juce::String(realtimeFactor / static_cast<double>(jobs), 1) << "x real time per core"
+              << " (" << juce::String(audioSeconds / std::max(1.0e-9, cpuSeconds), 1) << "x per busy worker)\n";
+
+    if (cache != nullptr)
+    {
+        const auto stats = cache->getStatistics();
+        std::cout << "Onset cache: " << stats.hits << " hit(s), " << stats.misses << " miss(es) ("
+                  << juce::String(stats.getHitRate() * 100.0, 0) << "% hit rate), " << stats.stores << " stored, "
+                  << stats.evictions << " evicted, " << stats.entries << " entries using "
+                  << juce::String(static_cast<double>(stats.bytes) / (1024.0 * 1024.0), 2) << " MB, "
+                  << juce::String(stats.hashSeconds, 2) << "s hashing\n";
+    }
+
+    if (splitFiles && cl.has("scaling"))
+    {
+        std::cout << "\n";
+        for (const auto& input : inputs)
+            reportScaling(input, settings, jobs);
+    }
+
+    return failures == 0 ? 0 : 1;
+}
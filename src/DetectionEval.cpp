@@ -0,0 +1,171 @@
+#include "DetectionEval.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+namespace audiotomidi {
+
+namespace
+{
+constexpr double kPi = 3.14159265358979323846;
+
+const char* getHitName(SyntheticHit hit)
+{
+    switch (hit)
+    {
+        case SyntheticHit::Click: return "click";
+        case SyntheticHit::NoiseBurst: return "noise";
+        case SyntheticHit::DecayingSine: break;
+    }
+    return "sine";
+}
+} // namespace
+
+std::string SyntheticScenario::getName() const
+{
+    return std::string(getHitName(hit)) + "/sr=" + std::to_string(static_cast<int>(sampleRate))
+         + "/bpm=" + std::to_string(static_cast<int>(tempoBpm)) + "/snr=" + std::to_string(static_cast<int>(snrDb));
+}
+
+SyntheticSignal generateSyntheticSignal(const SyntheticScenario& scenario)
+{
+    SyntheticSignal signal;
+
+    const double sr = scenario.sampleRate;
+    const auto length = static_cast<size_t>(scenario.seconds * sr);
+    signal.samples.assign(length, 0.0f);
+
+    std::mt19937 rng(scenario.seed);
+    std::normal_distribution<double> gaussian(0.0, 1.0);
+    std::uniform_real_distribution<double> peakDistribution(0.3, 0.5);
+    std::uniform_real_distribution<double> uniform(-1.0, 1.0);
+
+    const double noiseRms = 0.5 / std::pow(10.0, scenario.snrDb / 20.0);
+    for (auto& s : signal.samples)
+        s = static_cast<float>(noiseRms * gaussian(rng));
+
+    const double interval = 60.0 / scenario.tempoBpm * sr;
+    const auto hitLength = static_cast<size_t>(0.25 * sr);
+
+    // Start after half a second so the noise-floor follower has settled.
+    for (double position = 0.5 * sr; position + 1.0 < static_cast<double>(length); position += interval)
+    {
+        const auto start = static_cast<size_t>(position);
+        const double peak = peakDistribution(rng);
+        signal.onsets.push_back(static_cast<std::int64_t>(start));
+
+        for (size_t i = 0; i < hitLength && start + i < length; ++i)
+        {
+            const double t = static_cast<double>(i) / sr;
+            double value = 0.0;
+
+            switch (scenario.hit)
+            {
+                case SyntheticHit::Click:
+                    value = std::exp(-t / 0.01) * std::sin(2.0 * kPi * 3000.0 * t);
+                    break;
+                case SyntheticHit::DecayingSine:
+                    value = std::exp(-t / 0.06) * std::sin(2.0 * kPi * 60.0 * t);
+                    break;
+                case SyntheticHit::NoiseBurst:
+                    value = std::exp(-t / 0.06) * uniform(rng);
+                    break;
+            }
+
+            signal.samples[start + i] += static_cast<float>(peak * value);
+        }
+    }
+
+    return signal;
+}
+
+std::vector<std::int64_t> detectOnsets(const std::vector<float>& samples, double sampleRate, int blockSize, const BeatDetector::Params& params)
+{
+    BeatDetector detector;
+    detector.prepare(sampleRate);
+    BeatDetector::TriggerBuffer triggers;
+
+    std::vector<std::int64_t> detections;
+    const auto total = static_cast<std::int64_t>(samples.size());
+    const auto latency = detector.getLatencySamples(params);
+
+    for (std::int64_t position = 0; position < total; position += blockSize)
+    {
+        const auto numSamples = static_cast<int>(std::min<std::int64_t>(blockSize, total - position));
+        detector.processBlock(samples.data() + position, numSamples, params, triggers);
+
+        for (int i = 0; i < triggers.count; ++i)
+            detections.push_back(position + triggers.events[static_cast<size_t>(i)].sampleOffset - latency);
+    }
+
+    return detections;
+}
+
+double DetectionScore::getPrecision() const noexcept
+{
+    const int detected = truePositives + falsePositives;
+    return detected > 0 ? static_cast<double>(truePositives) / detected : 1.0;
+}
+
+double DetectionScore::getRecall() const noexcept
+{
+    const int actual = truePositives + falseNegatives;
+    return actual > 0 ? static_cast<double>(truePositives) / actual : 1.0;
+}
+
+double DetectionScore::getFMeasure() const noexcept
+{
+    const double p = getPrecision();
+    const double r = getRecall();
+    return p + r > 0.0 ? 2.0 * p * r / (p + r) : 0.0;
+}
+
+DetectionScore scoreDetections(const std::vector<std::int64_t>& truth,
+                               const std::vector<std::int64_t>& detections,
+                               std::int64_t earlyToleranceSamples,
+                               std::int64_t lateToleranceSamples)
+{
+    DetectionScore score;
+    std::vector<double> latencies;
+    latencies.reserve(truth.size());
+
+    size_t next = 0;
+    for (const auto onset : truth)
+    {
+        while (next < detections.size() && detections[next] < onset - earlyToleranceSamples)
+        {
+            ++score.falsePositives;
+            ++next;
+        }
+
+        if (next < detections.size() && detections[next] <= onset + lateToleranceSamples)
+        {
+            ++score.truePositives;
+            latencies.push_back(static_cast<double>(detections[next] - onset));
+            ++next;
+        }
+        else
+        {
+            ++score.falseNegatives;
+        }
+    }
+
+    score.falsePositives += static_cast<int>(detections.size() - next);
+
+    if (!latencies.empty())
+    {
+        double sum = 0.0;
+        for (auto l : latencies)
+            sum += l;
+        score.meanLatencySamples = sum / static_cast<double>(latencies.size());
+
+        std::sort(latencies.begin(), latencies.end());
+        const auto index = static_cast<size_t>(std::ceil(0.99 * static_cast<double>(latencies.size()))) - 1;
+        score.p99LatencySamples = latencies[std::min(index, latencies.size() - 1)];
+    }
+
+    return score;
+}
+
+} // namespace audiotomidi
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "BeatDetector.h"
+
+namespace audiotomidi {
+
+enum class SyntheticHit
+{
+    Click,
+    DecayingSine,
+    NoiseBurst
+};
+
+struct SyntheticScenario
+{
+    SyntheticHit hit = SyntheticHit::DecayingSine;
+    double sampleRate = 48000.0;
+    double tempoBpm = 120.0;
+    double snrDb = 30.0;
+    double seconds = 8.0;
+    unsigned int seed = 1;
+
+    std::string getName() const;
+};
+
+struct SyntheticSignal
+{
+    std::vector<float> samples;
+    std::vector<std::int64_t> onsets;
+};
+
+// Background noise plus one hit per beat. Hit peaks vary between 0.3 and 0.5 of full scale and
+// the noise level is set from the scenario's peak-to-noise-RMS ratio.
+SyntheticSignal generateSyntheticSignal(const SyntheticScenario& scenario);
+
+// Runs the whole signal through a fresh BeatDetector in blocks of blockSize and returns the
+// absolute sample position of every trigger, minus the detector's reported latency (as a host
+// would compensate it).
+std::vector<std::int64_t> detectOnsets(const std::vector<float>& samples, double sampleRate, int blockSize, const BeatDetector::Params& params);
+
+struct DetectionScore
+{
+    int truePositives = 0;
+    int falsePositives = 0;
+    int falseNegatives = 0;
+    double meanLatencySamples = 0.0;
+    double p99LatencySamples = 0.0;
+
+    double getPrecision() const noexcept;
+    double getRecall() const noexcept;
+    double getFMeasure() const noexcept;
+};
+
+// Matches each true onset to the first unmatched detection in [onset - early, onset + late] and
+// measures latency as detection minus true onset for every match.
+DetectionScore scoreDetections(const std::vector<std::int64_t>& truth,
+                               const std::vector<std::int64_t>& detections,
+                               std::int64_t earlyToleranceSamples,
+                               std::int64_t lateToleranceSamples);
+
+} // namespace audiotomidi
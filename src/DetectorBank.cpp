@@ -0,0 +1,151 @@
+#include "DetectorBank.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace audiotomidi {
+
+namespace
+{
+constexpr float kPi = 3.14159265358979323846f;
+}
+
+void DetectorBank::prepare(double sr) noexcept
+{
+    sampleRateHz = sr > 0.0 ? sr : 44100.0;
+
+    const auto rate = static_cast<float>(sampleRateHz);
+    envAlpha = 1.0f - std::exp(-1.0f / (0.001f * BeatDetector::envelopeTimeMs * rate));
+    noiseAlpha = 1.0f - std::exp(-1.0f / (0.001f * BeatDetector::noiseFloorTimeMs * rate));
+    lowAlpha = 1.0f - std::exp(-2.0f * kPi * BeatDetector::focusLowHz / rate);
+
+    reset();
+}
+
+void DetectorBank::reset() noexcept
+{
+    envelope.fill(0.0f);
+    noiseFloor.fill(0.0f);
+    lowPassed.fill(0.0f);
+    threshold.fill(0.0f);
+    wasAboveThreshold.fill(0);
+    samplesSinceLastTrigger.fill(static_cast<std::int32_t>(sampleRateHz));
+}
+
+template <bool focusLow>
+void DetectorBank::processTile(int tileStart, int numSamples, int numLanes, int width, int gapSamples, float thresholdLift,
+                               const std::array<int, maxLanes>& laneNotes, BeatDetector::TriggerBuffer& out) noexcept
+{
+    alignas(32) std::array<std::int32_t, maxLanes> fired {};
+
+    for (int i = 0; i < numSamples; ++i)
+    {
+        const float* x = tile.data() + i * maxLanes;
+        std::int32_t anyFired = 0;
+
+        for (size_t lane = 0; lane < static_cast<size_t>(width); ++lane)
+        {
+            float v = x[lane];
+
+            if constexpr (focusLow)
+            {
+                lowPassed[lane] += lowAlpha * (v - lowPassed[lane]);
+                v = lowPassed[lane];
+            }
+
+            const float rectified = std::abs(v);
+            const float env = envelope[lane] + envAlpha * (rectified - envelope[lane]);
+
+            const float noiseTarget = std::min(env, noiseFloor[lane] + 0.08f);
+            const float nf = noiseFloor[lane] + noiseAlpha * (noiseTarget - noiseFloor[lane]);
+
+            const float thr = std::max(BeatDetector::minThreshold, nf + thresholdLift);
+            const std::int32_t above = env >= thr ? 1 : 0;
+            const std::int32_t since = samplesSinceLastTrigger[lane] + 1;
+            const std::int32_t fire = above & (wasAboveThreshold[lane] ^ 1) & (since >= gapSamples ? 1 : 0);
+
+            envelope[lane] = env;
+            noiseFloor[lane] = nf;
+            threshold[lane] = thr;
+            samplesSinceLastTrigger[lane] = fire != 0 ? 0 : since;
+            wasAboveThreshold[lane] = above;
+            fired[lane] = fire;
+            anyFired |= fire;
+        }
+
+        if (anyFired == 0)
+            continue;
+
+        for (size_t lane = 0; lane < static_cast<size_t>(numLanes); ++lane)
+        {
+            if (fired[lane] == 0 || out.count >= static_cast<int>(out.events.size()))
+                continue;
+
+            auto& event = out.events[static_cast<size_t>(out.count++)];
+            event = {};
+            event.sampleOffset = tileStart + i;
+            event.strength = std::clamp((envelope[lane] - threshold[lane]) * 8.0f, 0.0f, 1.0f);
+            event.noteNumber = laneNotes[lane];
+        }
+    }
+}
+
+void DetectorBank::processBlock(const float* const* channels,
+                                int numLanes,
+                                int numSamples,
+                                const BeatDetector::Params& params,
+                                const std::array<int, maxLanes>& laneNotes,
+                                BeatDetector::TriggerBuffer& out) noexcept
+{
+    out.count = 0;
+    numLanes = std::clamp(numLanes, 0, maxLanes);
+
+    const auto gapSamples = std::max(1, static_cast<int>(params.minGapMs * 0.001f * static_cast<float>(sampleRateHz)));
+    const float sensitivity = std::clamp(params.sensitivity, 0.0f, 100.0f) * 0.01f;
+    const float thresholdLift = (1.0f - sensitivity) * 0.18f;
+
+    // Half the bank is enough for up to eight mics; the lane loop bound stays a multiple of the
+    // vector width either way.
+    const int width = numLanes <= maxLanes / 2 ? maxLanes / 2 : maxLanes;
+
+    for (int start = 0; start < numSamples; start += tileSamples)
+    {
+        const int length = std::min(tileSamples, numSamples - start);
+
+        for (int lane = 0; lane < width; ++lane)
+        {
+            const float* in = lane < numLanes ? channels[lane] : nullptr;
+            float* dst = tile.data() + lane;
+
+            if (in != nullptr)
+            {
+                for (int i = 0; i < length; ++i)
+                    dst[i * maxLanes] = in[start + i];
+            }
+            else
+            {
+                for (int i = 0; i < length; ++i)
+                    dst[i * maxLanes] = 0.0f;
+            }
+        }
+
+        if (params.focusLow)
+            processTile<true>(start, length, numLanes, width, gapSamples, thresholdLift, laneNotes, out);
+        else
+            processTile<false>(start, length, numLanes, width, gapSamples, thresholdLift, laneNotes, out);
+    }
+
+    // Report the loudest lane so meters show whichever mic is currently hottest.
+    out.envelope = 0.0f;
+    out.threshold = 0.0f;
+    for (size_t lane = 0; lane < static_cast<size_t>(numLanes); ++lane)
+    {
+        if (envelope[lane] >= out.envelope)
+        {
+            out.envelope = envelope[lane];
+            out.threshold = threshold[lane];
+        }
+    }
+}
+
+} // namespace audiotomidi
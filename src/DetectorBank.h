@@ -0,0 +1,55 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+#include "BeatDetector.h"
+
+namespace audiotomidi {
+
+// Runs one BeatDetector-equivalent lane per input channel. Lane state is stored
+// structure-of-arrays and each block is transposed into a sample-major scratch tile, so the
+// per-sample update is a fixed-width, branch-free loop across lanes that the compiler turns into
+// 4- or 8-wide vector instructions. A lane produces exactly the triggers a BeatDetector fed with
+// the same channel would, except where BeatDetector decimates (focusLow at 88.2 kHz and above):
+// lanes always run at the full rate.
+class DetectorBank
+{
+public:
+    static constexpr int maxLanes = 16;
+
+    void prepare(double sampleRate) noexcept;
+    void reset() noexcept;
+
+    // channels[lane] may be null for a silent lane. Events are written in time order and carry
+    // laneNotes[lane] as their note number.
+    void processBlock(const float* const* channels,
+                      int numLanes,
+                      int numSamples,
+                      const BeatDetector::Params& params,
+                      const std::array<int, maxLanes>& laneNotes,
+                      BeatDetector::TriggerBuffer& out) noexcept;
+
+private:
+    static constexpr int tileSamples = 256;
+
+    template <bool focusLow>
+    void processTile(int tileStart, int numSamples, int numLanes, int width, int gapSamples, float thresholdLift,
+                     const std::array<int, maxLanes>& laneNotes, BeatDetector::TriggerBuffer& out) noexcept;
+
+    double sampleRateHz = 44100.0;
+    float envAlpha = 0.0f;
+    float noiseAlpha = 0.0f;
+    float lowAlpha = 0.0f;
+
+    alignas(32) std::array<float, maxLanes> envelope {};
+    alignas(32) std::array<float, maxLanes> noiseFloor {};
+    alignas(32) std::array<float, maxLanes> lowPassed {};
+    alignas(32) std::array<float, maxLanes> threshold {};
+    alignas(32) std::array<std::int32_t, maxLanes> wasAboveThreshold {};
+    alignas(32) std::array<std::int32_t, maxLanes> samplesSinceLastTrigger {};
+
+    alignas(32) std::array<float, tileSamples * maxLanes> tile {};
+};
+
+} // namespace audiotomidi
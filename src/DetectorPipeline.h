@@ -0,0 +1,329 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+namespace audiotomidi {
+
+// Building blocks of BeatDetector's envelope engine. A detector is composed at compile time as
+// Detector<Prefilter, EnvelopeFollower, ThresholdPolicy, GatePolicy>; each stage is a small
+// struct that loads its state into locals when a block starts, advances it one sample at a time
+// through an inline process(), and stores it back when the block ends. Every instantiation is
+// therefore a single fused loop with the state in registers and no per-sample branches on the
+// configuration. Callers switch configurations by picking a different instantiation per block,
+// so a stage that is not selected costs nothing.
+
+// Smoothing coefficients for one sample rate, computed once in prepare().
+struct DetectorCoefficients
+{
+    float envAlpha = 0.0f;
+    float noiseAlpha = 0.0f;
+    float lowAlpha = 0.0f;
+};
+
+// Per-block settings derived from the parameters.
+struct DetectorSettings
+{
+    float thresholdLift = 0.0f;
+    float minThreshold = 0.0f;
+    int gapSamples = 1;
+    int samplesPerStep = 1; // input samples per detector sample; > 1 behind a decimator
+};
+
+// Everything a detector carries from one block to the next.
+struct DetectorState
+{
+    float lowPassed = 0.0f;
+    float envelope = 0.0f;
+    float noiseFloor = 0.0f;
+    bool wasAboveThreshold = false;
+    int samplesSinceLastTrigger = 0;
+};
+
+//==============================================================================
+// Prefilters
+
+struct PassThrough
+{
+    PassThrough(const DetectorCoefficients&, const DetectorState&) noexcept {}
+    float process(float x) noexcept { return x; }
+    void store(DetectorState&) const noexcept {}
+};
+
+// One-pole low-pass at BeatDetector::focusLowHz.
+struct OnePoleLowPass
+{
+    OnePoleLowPass(const DetectorCoefficients& coefficients, const DetectorState& state) noexcept
+        : alpha(coefficients.lowAlpha), lowPassed(state.lowPassed)
+    {
+    }
+
+    float process(float x) noexcept
+    {
+        lowPassed += alpha * (x - lowPassed);
+        return lowPassed;
+    }
+
+    void store(DetectorState& state) const noexcept { state.lowPassed = lowPassed; }
+
+    float alpha;
+    float lowPassed;
+};
+
+//==============================================================================
+// Envelope followers
+
+// Full-wave rectifier into a one-pole smoother.
+struct RectifiedOnePole
+{
+    RectifiedOnePole(const DetectorCoefficients& coefficients, const DetectorState& state) noexcept
+        : alpha(coefficients.envAlpha), envelope(state.envelope)
+    {
+    }
+
+    float process(float x) noexcept
+    {
+        envelope += alpha * (std::abs(x) - envelope);
+        return envelope;
+    }
+
+    void store(DetectorState& state) const noexcept { state.envelope = envelope; }
+
+    float alpha;
+    float envelope;
+};
+
+//==============================================================================
+// Threshold policies
+
+// A slow follower of the envelope that may rise by at most 0.08 per step, lifted by the
+// sensitivity setting.
+struct AdaptiveNoiseFloor
+{
+    AdaptiveNoiseFloor(const DetectorCoefficients& coefficients, const DetectorState& state, const DetectorSettings& settings) noexcept
+        : alpha(coefficients.noiseAlpha), noiseFloor(state.noiseFloor), lift(settings.thresholdLift), minThreshold(settings.minThreshold)
+    {
+    }
+
+    float process(float envelope) noexcept
+    {
+        const float noiseTarget = std::min(envelope, noiseFloor + 0.08f);
+        noiseFloor += alpha * (noiseTarget - noiseFloor);
+        return std::max(minThreshold, noiseFloor + lift);
+    }
+
+    void store(DetectorState& state) const noexcept { state.noiseFloor = noiseFloor; }
+
+    float alpha;
+    float noiseFloor;
+    float lift;
+    float minThreshold;
+};
+
+//==============================================================================
+// Gate policies
+
+// Fires on the rising edge through the threshold, at most once per gapSamples input samples.
+struct RefractoryGate
+{
+    RefractoryGate(const DetectorState& state, const DetectorSettings& settings) noexcept
+        : wasAbove(state.wasAboveThreshold),
+          samplesSinceLastTrigger(state.samplesSinceLastTrigger),
+          gapSamples(settings.gapSamples),
+          samplesPerStep(settings.samplesPerStep)
+    {
+    }
+
+    bool process(float envelope, float threshold) noexcept
+    {
+        const bool above = envelope >= threshold;
+        samplesSinceLastTrigger += samplesPerStep;
+
+        const bool fire = !wasAbove && above && samplesSinceLastTrigger >= gapSamples;
+        if (fire)
+            samplesSinceLastTrigger = 0;
+
+        wasAbove = above;
+        return fire;
+    }
+
+    void store(DetectorState& state) const noexcept
+    {
+        state.wasAboveThreshold = wasAbove;
+        state.samplesSinceLastTrigger = samplesSinceLastTrigger;
+    }
+
+    bool wasAbove;
+    int samplesSinceLastTrigger;
+    int gapSamples;
+    int samplesPerStep;
+};
+
+//==============================================================================
+// Polyphase FIR decimator with a CIC (B-spline) kernel: order boxcars as long as the factor,
+// convolved. The kernel has unity DC gain, a null of that order at every multiple of the
+// reduced rate, and a group delay of order * (factor - 1) / 2 input samples. It spans order
+// output samples, so each input is multiplied into that many partial outputs and never stored.
+class PolyphaseDecimator
+{
+public:
+    static constexpr int maxFactor = 4;
+    static constexpr int order = 2;
+
+    void prepare(int factorToUse) noexcept
+    {
+        factor = std::clamp(factorToUse, 1, maxFactor);
+
+        std::array<float, order * maxFactor> kernel {};
+        kernel[0] = 1.0f;
+        int length = 1;
+        for (int stage = 0; stage < order; ++stage)
+        {
+            std::array<float, order * maxFactor> widened {};
+            for (int i = 0; i < length; ++i)
+                for (int j = 0; j < factor; ++j)
+                    widened[static_cast<size_t>(i + j)] += kernel[static_cast<size_t>(i)] / static_cast<float>(factor);
+            kernel = widened;
+            length += factor - 1;
+        }
+
+        // Output m sums kernel[k] * input[m * factor + factor - 1 - k], so the input at phase p
+        // reaches output m + j through kernel[j * factor + factor - 1 - p].
+        taps.fill(0.0f);
+        for (int inputPhase = 0; inputPhase < factor; ++inputPhase)
+            for (int j = 0; j < order; ++j)
+            {
+                const int k = j * factor + factor - 1 - inputPhase;
+                if (k < length)
+                    taps[static_cast<size_t>(inputPhase * order + j)] = kernel[static_cast<size_t>(k)];
+            }
+
+        reset();
+    }
+
+    void reset() noexcept
+    {
+        sums.fill(0.0f);
+        phase = 0;
+    }
+
+    int getFactor() const noexcept { return factor; }
+
+    // Consumes numSamples inputs of silence and returns how many decimated samples they complete.
+    int skip(int numSamples) noexcept
+    {
+        const int outputs = (phase + numSamples) / factor;
+        phase = (phase + numSamples) % factor;
+        if (outputs > 0)
+            sums.fill(0.0f);
+        return outputs;
+    }
+
+    // Feeds one input sample; returns true and sets output when it completes a decimated sample.
+    bool push(float x, float& output) noexcept
+    {
+        const float* branch = taps.data() + phase * order;
+        for (int j = 0; j < order; ++j)
+            sums[static_cast<size_t>(j)] += branch[j] * x;
+
+        if (++phase < factor)
+            return false;
+
+        phase = 0;
+        output = sums[0];
+        std::move(sums.begin() + 1, sums.end(), sums.begin());
+        sums.back() = 0.0f;
+        return true;
+    }
+
+private:
+    int factor = 1;
+    std::array<float, maxFactor * order> taps {};
+    std::array<float, order> sums {};
+    int phase = 0;
+};
+
+//==============================================================================
+template <typename Prefilter, typename EnvelopeFollower, typename ThresholdPolicy, typename GatePolicy>
+struct Detector
+{
+    // Runs block[startSample, startSample + numSamples) through the stages and calls
+    // onTrigger(sampleOffset, strength) for every trigger. Returns the last envelope and
+    // threshold through the references (unchanged when numSamples is 0).
+    template <typename OnTrigger>
+    static void process(DetectorState& state, const DetectorCoefficients& coefficients, const DetectorSettings& settings,
+                        const float* block, int startSample, int numSamples, float& envelopeOut, float& thresholdOut,
+                        OnTrigger&& onTrigger) noexcept
+    {
+        Prefilter prefilter(coefficients, state);
+        EnvelopeFollower follower(coefficients, state);
+        ThresholdPolicy thresholdPolicy(coefficients, state, settings);
+        GatePolicy gate(state, settings);
+        float lastEnvelope = envelopeOut;
+        float lastThreshold = thresholdOut;
+
+        for (int i = startSample; i < startSample + numSamples; ++i)
+        {
+            const float envelope = follower.process(prefilter.process(block[i]));
+            const float threshold = thresholdPolicy.process(envelope);
+
+            if (gate.process(envelope, threshold))
+                onTrigger(i, std::clamp((envelope - threshold) * 8.0f, 0.0f, 1.0f));
+
+            lastEnvelope = envelope;
+            lastThreshold = threshold;
+        }
+
+        envelopeOut = lastEnvelope;
+        thresholdOut = lastThreshold;
+
+        prefilter.store(state);
+        follower.store(state);
+        thresholdPolicy.store(state);
+        gate.store(state);
+    }
+
+    // Same, behind a decimator: the stages run once per decimated sample, and triggers land on
+    // the input sample that completed it. settings.samplesPerStep must be the decimation factor.
+    template <typename OnTrigger>
+    static void processDecimated(DetectorState& state, PolyphaseDecimator& decimator, const DetectorCoefficients& coefficients,
+                                 const DetectorSettings& settings, const float* block, int startSample, int numSamples,
+                                 float& envelopeOut, float& thresholdOut, OnTrigger&& onTrigger) noexcept
+    {
+        Prefilter prefilter(coefficients, state);
+        EnvelopeFollower follower(coefficients, state);
+        ThresholdPolicy thresholdPolicy(coefficients, state, settings);
+        GatePolicy gate(state, settings);
+        auto localDecimator = decimator;
+        float lastEnvelope = envelopeOut;
+        float lastThreshold = thresholdOut;
+
+        for (int i = startSample; i < startSample + numSamples; ++i)
+        {
+            float x = 0.0f;
+            if (!localDecimator.push(block[i], x))
+                continue;
+
+            const float envelope = follower.process(prefilter.process(x));
+            const float threshold = thresholdPolicy.process(envelope);
+
+            if (gate.process(envelope, threshold))
+                onTrigger(i, std::clamp((envelope - threshold) * 8.0f, 0.0f, 1.0f));
+
+            lastEnvelope = envelope;
+            lastThreshold = threshold;
+        }
+
+        envelopeOut = lastEnvelope;
+        thresholdOut = lastThreshold;
+
+        decimator = localDecimator;
+        prefilter.store(state);
+        follower.store(state);
+        thresholdPolicy.store(state);
+        gate.store(state);
+    }
+};
+
+} // namespace audiotomidi
@@ -0,0 +1,253 @@
+#include "DownmixKernel.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include <juce_core/juce_core.h>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+ #define AUDIOTOMIDI_X86 1
+ #include <immintrin.h>
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(_M_ARM64)
+ #define AUDIOTOMIDI_NEON 1
+ #include <arm_neon.h>
+#endif
+
+#if AUDIOTOMIDI_X86 && (defined(__GNUC__) || defined(__clang__))
+ #define AUDIOTOMIDI_TARGET_SSE2 __attribute__((target("sse2")))
+ #define AUDIOTOMIDI_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+ #define AUDIOTOMIDI_TARGET_SSE2
+ #define AUDIOTOMIDI_TARGET_AVX2
+#endif
+
+namespace audiotomidi {
+
+namespace
+{
+// Keeps the mono block in L1 while every channel is accumulated into it.
+constexpr int kTileSamples = 1024;
+
+struct DownmixKernels
+{
+    void (*accumulate)(float* dst, const float* src, int numSamples) noexcept;
+    float (*scaleAndPeak)(float* dst, float gain, int numSamples) noexcept;
+};
+
+void accumulateScalar(float* dst, const float* src, int numSamples) noexcept
+{
+    for (int i = 0; i < numSamples; ++i)
+        dst[i] += src[i];
+}
+
+float scaleAndPeakScalar(float* dst, float gain, int numSamples) noexcept
+{
+    float peak = 0.0f;
+    for (int i = 0; i < numSamples; ++i)
+    {
+        dst[i] *= gain;
+        peak = std::max(peak, std::abs(dst[i]));
+    }
+    return peak;
+}
+
+#if AUDIOTOMIDI_X86
+AUDIOTOMIDI_TARGET_SSE2 void accumulateSse2(float* dst, const float* src, int numSamples) noexcept
+{
+    int i = 0;
+    for (; i + 4 <= numSamples; i += 4)
+        _mm_storeu_ps(dst + i, _mm_add_ps(_mm_loadu_ps(dst + i), _mm_loadu_ps(src + i)));
+
+    accumulateScalar(dst + i, src + i, numSamples - i);
+}
+
+AUDIOTOMIDI_TARGET_SSE2 float scaleAndPeakSse2(float* dst, float gain, int numSamples) noexcept
+{
+    const auto g = _mm_set1_ps(gain);
+    const auto absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+    auto peak4 = _mm_setzero_ps();
+
+    int i = 0;
+    for (; i + 4 <= numSamples; i += 4)
+    {
+        const auto v = _mm_mul_ps(_mm_loadu_ps(dst + i), g);
+        _mm_storeu_ps(dst + i, v);
+        peak4 = _mm_max_ps(peak4, _mm_and_ps(v, absMask));
+    }
+
+    alignas(16) float lanes[4];
+    _mm_store_ps(lanes, peak4);
+    const float peak = std::max(std::max(lanes[0], lanes[1]), std::max(lanes[2], lanes[3]));
+    return std::max(peak, scaleAndPeakScalar(dst + i, gain, numSamples - i));
+}
+
+AUDIOTOMIDI_TARGET_AVX2 void accumulateAvx2(float* dst, const float* src, int numSamples) noexcept
+{
+    int i = 0;
+    for (; i + 8 <= numSamples; i += 8)
+        _mm256_storeu_ps(dst + i, _mm256_add_ps(_mm256_loadu_ps(dst + i), _mm256_loadu_ps(src + i)));
+
+    accumulateScalar(dst + i, src + i, numSamples - i);
+}
+
+AUDIOTOMIDI_TARGET_AVX2 float scaleAndPeakAvx2(float* dst, float gain, int numSamples) noexcept
+{
+    const auto g = _mm256_set1_ps(gain);
+    const auto absMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+    auto peak8 = _mm256_setzero_ps();
+
+    int i = 0;
+    for (; i + 8 <= numSamples; i += 8)
+    {
+        const auto v = _mm256_mul_ps(_mm256_loadu_ps(dst + i), g);
+        _mm256_storeu_ps(dst + i, v);
+        peak8 = _mm256_max_ps(peak8, _mm256_and_ps(v, absMask));
+    }
+
+    const auto peak4 = _mm_max_ps(_mm256_castps256_ps128(peak8), _mm256_extractf128_ps(peak8, 1));
+    alignas(16) float lanes[4];
+    _mm_store_ps(lanes, peak4);
+    const float peak = std::max(std::max(lanes[0], lanes[1]), std::max(lanes[2], lanes[3]));
+    return std::max(peak, scaleAndPeakScalar(dst + i, gain, numSamples - i));
+}
+#endif
+
+#if AUDIOTOMIDI_NEON
+void accumulateNeon(float* dst, const float* src, int numSamples) noexcept
+{
+    int i = 0;
+    for (; i + 4 <= numSamples; i += 4)
+        vst1q_f32(dst + i, vaddq_f32(vld1q_f32(dst + i), vld1q_f32(src + i)));
+
+    accumulateScalar(dst + i, src + i, numSamples - i);
+}
+
+float scaleAndPeakNeon(float* dst, float gain, int numSamples) noexcept
+{
+    auto peak4 = vdupq_n_f32(0.0f);
+
+    int i = 0;
+    for (; i + 4 <= numSamples; i += 4)
+    {
+        const auto v = vmulq_n_f32(vld1q_f32(dst + i), gain);
+        vst1q_f32(dst + i, v);
+        peak4 = vmaxq_f32(peak4, vabsq_f32(v));
+    }
+
+    const auto peak2 = vmax_f32(vget_low_f32(peak4), vget_high_f32(peak4));
+    const float peak = std::max(vget_lane_f32(peak2, 0), vget_lane_f32(peak2, 1));
+    return std::max(peak, scaleAndPeakScalar(dst + i, gain, numSamples - i));
+}
+#endif
+
+DownmixKernels getKernels(SimdIsa isa) noexcept
+{
+    // An instruction set this build has no kernels for runs the scalar ones.
+    switch (isa)
+    {
+        case SimdIsa::Scalar: return { accumulateScalar, scaleAndPeakScalar };
+#if AUDIOTOMIDI_X86
+        case SimdIsa::Sse2: return { accumulateSse2, scaleAndPeakSse2 };
+        case SimdIsa::Avx2: return { accumulateAvx2, scaleAndPeakAvx2 };
+#else
+        case SimdIsa::Sse2: return { accumulateScalar, scaleAndPeakScalar };
+        case SimdIsa::Avx2: return { accumulateScalar, scaleAndPeakScalar };
+#endif
+#if AUDIOTOMIDI_NEON
+        case SimdIsa::Neon: return { accumulateNeon, scaleAndPeakNeon };
+#else
+        case SimdIsa::Neon: return { accumulateScalar, scaleAndPeakScalar };
+#endif
+    }
+
+    return { accumulateScalar, scaleAndPeakScalar }; // not an enumerator; keeps GCC's -Wreturn-type quiet
+}
+} // namespace
+
+bool isSimdIsaSupported(SimdIsa isa) noexcept
+{
+    switch (isa)
+    {
+        case SimdIsa::Scalar: return true;
+#if AUDIOTOMIDI_X86
+        case SimdIsa::Sse2: return juce::SystemStats::hasSSE2();
+        case SimdIsa::Avx2: return juce::SystemStats::hasAVX2();
+#else
+        case SimdIsa::Sse2: return false;
+        case SimdIsa::Avx2: return false;
+#endif
+#if AUDIOTOMIDI_NEON
+        case SimdIsa::Neon: return true;
+#else
+        case SimdIsa::Neon: return false;
+#endif
+    }
+
+    return false;
+}
+
+SimdIsa getBestSimdIsa() noexcept
+{
+    for (auto isa : { SimdIsa::Avx2, SimdIsa::Neon, SimdIsa::Sse2 })
+        if (isSimdIsaSupported(isa))
+            return isa;
+
+    return SimdIsa::Scalar;
+}
+
+const char* getSimdIsaName(SimdIsa isa) noexcept
+{
+    switch (isa)
+    {
+        case SimdIsa::Sse2: return "sse2";
+        case SimdIsa::Avx2: return "avx2";
+        case SimdIsa::Neon: return "neon";
+        case SimdIsa::Scalar: break;
+    }
+
+    return "scalar";
+}
+
+float downmixToMono(SimdIsa isa, const float* const* channels, int numChannels, float* mono, int numSamples) noexcept
+{
+    if (numSamples <= 0)
+        return 0.0f;
+
+    const auto kernels = getKernels(isa);
+    const float gain = numChannels > 0 ? 1.0f / static_cast<float>(numChannels) : 1.0f;
+    float peak = 0.0f;
+
+    for (int start = 0; start < numSamples; start += kTileSamples)
+    {
+        const int length = std::min(kTileSamples, numSamples - start);
+        auto* dst = mono + start;
+
+        int first = 0;
+        while (first < numChannels && channels[first] == nullptr)
+            ++first;
+
+        if (first < numChannels)
+            std::memcpy(dst, channels[first] + start, sizeof(float) * static_cast<size_t>(length));
+        else
+            std::fill(dst, dst + length, 0.0f);
+
+        for (int c = first + 1; c < numChannels; ++c)
+            if (channels[c] != nullptr)
+                kernels.accumulate(dst, channels[c] + start, length);
+
+        peak = std::max(peak, kernels.scaleAndPeak(dst, gain, length));
+    }
+
+    return peak;
+}
+
+float downmixToMono(const float* const* channels, int numChannels, float* mono, int numSamples) noexcept
+{
+    static const SimdIsa bestIsa = getBestSimdIsa();
+    return downmixToMono(bestIsa, channels, numChannels, mono, numSamples);
+}
+
+} // namespace audiotomidi
@@ -0,0 +1,26 @@
+#pragma once
+
+namespace audiotomidi {
+
+enum class SimdIsa
+{
+    Scalar = 0,
+    Sse2,
+    Avx2,
+    Neon
+};
+
+// Averages numChannels input channels into mono and returns the absolute peak of the result.
+// Channels are summed channel-major in index order, so every ISA produces output that is
+// bit-identical to the scalar sample-by-sample loop it replaces. Null channel pointers are
+// treated as silence but still count towards the channel average.
+float downmixToMono(const float* const* channels, int numChannels, float* mono, int numSamples) noexcept;
+
+// Same as above with an explicit instruction set; isa must be supported on this CPU.
+float downmixToMono(SimdIsa isa, const float* const* channels, int numChannels, float* mono, int numSamples) noexcept;
+
+bool isSimdIsaSupported(SimdIsa isa) noexcept;
+SimdIsa getBestSimdIsa() noexcept;
+const char* getSimdIsaName(SimdIsa isa) noexcept;
+
+} // namespace audiotomidi
@@ -0,0 +1,409 @@
+#include "DrumSampler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+
+#include <juce_audio_formats/juce_audio_formats.h>
+
+namespace audiotomidi {
+
+namespace
+{
+// The loader wakes this often to delete retired sets and to retry a publish the queue refused.
+constexpr int kServiceIntervalMs = 100;
+
+// Layer number from a "v<n>" token of a file name, 1 when there is none.
+int parseLayerNumber(const juce::String& fileName)
+{
+    juce::StringArray tokens;
+    tokens.addTokens(fileName.toLowerCase(), "_- .", "");
+    for (const auto& token : tokens)
+        if (token.length() > 1 && token[0] == 'v' && token.substring(1).containsOnly("0123456789"))
+            return std::max(1, token.substring(1).getIntValue());
+
+    return 1;
+}
+
+// Converts source to the given rate with a windowed-sinc interpolator, dropping its latency so
+// the sample still starts on its first output sample.
+juce::AudioBuffer<float> resample(const juce::AudioBuffer<float>& source, double sourceRate, double targetRate)
+{
+    const double ratio = sourceRate / targetRate; // input samples per output sample
+    const int latency = static_cast<int>(std::ceil(juce::WindowedSincInterpolator::getBaseLatency()));
+    const int numOutput = static_cast<int>(std::ceil(source.getNumSamples() / ratio));
+    const int numSkipped = static_cast<int>(std::lround(latency / ratio));
+
+    // Zeros after the end let the interpolator produce the decay of the last input samples.
+    juce::AudioBuffer<float> padded(source.getNumChannels(), source.getNumSamples() + 2 * latency + 8);
+    padded.clear();
+    for (int channel = 0; channel < source.getNumChannels(); ++channel)
+        padded.copyFrom(channel, 0, source, channel, 0, source.getNumSamples());
+
+    juce::AudioBuffer<float> result(source.getNumChannels(), numOutput);
+    std::vector<float> skipped(static_cast<size_t>(std::max(1, numSkipped)));
+    for (int channel = 0; channel < source.getNumChannels(); ++channel)
+    {
+        juce::WindowedSincInterpolator interpolator;
+        const int consumed = numSkipped > 0 ? interpolator.process(ratio, padded.getReadPointer(channel), skipped.data(), numSkipped) : 0;
+        interpolator.process(ratio, padded.getReadPointer(channel) + consumed, result.getWritePointer(channel), numOutput);
+    }
+
+    return result;
+}
+} // namespace
+
+DrumSampler::DrumSampler()
+    : juce::Thread("Drum sampler loader")
+{
+}
+
+DrumSampler::~DrumSampler()
+{
+    stopThread(2000);
+
+    // Every thread has stopped, so this thread owns both ends of both queues.
+    for (const SampleSet* const* set; (set = incoming.front()) != nullptr; incoming.pop())
+        delete *set;
+    for (const SampleSet* const* set; (set = retired.front()) != nullptr; retired.pop())
+        delete *set;
+    for (int i = 0; i < numRetiring; ++i)
+        delete retiring[static_cast<size_t>(i)];
+    delete current;
+}
+
+std::unique_ptr<DrumSampler::SampleSet> DrumSampler::loadSampleSet(const juce::File& folder, double sampleRate, juce::String& error)
+{
+    juce::AudioFormatManager formats;
+    formats.registerBasicFormats();
+
+    auto files = folder.findChildFiles(juce::File::findFiles, false, "*.wav;*.aif;*.aiff;*.flac");
+    files.sort();
+
+    std::map<int, std::vector<juce::AudioBuffer<float>>> layersByNumber;
+    for (const auto& file : files)
+    {
+        std::unique_ptr<juce::AudioFormatReader> reader(formats.createReaderFor(file));
+        if (reader == nullptr || reader->sampleRate <= 0.0 || reader->lengthInSamples <= 0)
+            continue;
+
+        const auto length = static_cast<int>(std::min<juce::int64>(reader->lengthInSamples, static_cast<juce::int64>(maxSampleSeconds * reader->sampleRate)));
+        juce::AudioBuffer<float> buffer(static_cast<int>(std::min<unsigned int>(reader->numChannels, 2)), length);
+        reader->read(&buffer, 0, length, 0, true, buffer.getNumChannels() > 1);
+
+        auto& layer = layersByNumber[parseLayerNumber(file.getFileNameWithoutExtension())];
+        if (static_cast<int>(layer.size()) < maxRoundRobin)
+            layer.push_back(reader->sampleRate == sampleRate ? std::move(buffer) : resample(buffer, reader->sampleRate, sampleRate));
+    }
+
+    if (layersByNumber.empty())
+    {
+        error = "No readable samples in " + folder.getFullPathName();
+        return nullptr;
+    }
+
+    auto set = std::make_unique<SampleSet>();
+    set->name = folder.getFileName();
+    set->sampleRate = sampleRate;
+    for (auto& [number, samples] : layersByNumber)
+        if (static_cast<int>(set->layers.size()) < maxLayers)
+            set->layers.push_back(std::move(samples));
+
+    return set;
+}
+
+void DrumSampler::startLoaderThread()
+{
+    if (!isThreadRunning())
+        startThread(juce::Thread::Priority::low);
+    notify();
+}
+
+void DrumSampler::loadFolder(const juce::File& folderToLoad)
+{
+    {
+        const juce::ScopedLock lock(requestLock);
+        folder = folderToLoad;
+        requestedFolder = folderToLoad;
+        requestedSet = nullptr;
+        loadRequested = true;
+    }
+
+    loading.store(true, std::memory_order_relaxed);
+    startLoaderThread();
+}
+
+void DrumSampler::publish(std::unique_ptr<SampleSet> set)
+{
+    {
+        const juce::ScopedLock lock(requestLock);
+        folder = juce::File();
+        requestedFolder = juce::File();
+        requestedSet = std::move(set);
+        loadRequested = true;
+    }
+
+    loading.store(true, std::memory_order_relaxed);
+    startLoaderThread();
+}
+
+juce::File DrumSampler::getFolder() const
+{
+    const juce::ScopedLock lock(requestLock);
+    return folder;
+}
+
+juce::String DrumSampler::getStatus() const
+{
+    const juce::ScopedLock lock(requestLock);
+    return status;
+}
+
+void DrumSampler::run()
+{
+    while (!threadShouldExit())
+    {
+        for (const SampleSet* const* set; (set = retired.front()) != nullptr; retired.pop())
+            delete *set;
+
+        juce::File folderToLoad;
+        std::unique_ptr<SampleSet> set;
+        bool requested = false;
+        {
+            const juce::ScopedLock lock(requestLock);
+            std::swap(requested, loadRequested);
+            folderToLoad = requestedFolder;
+            set = std::move(requestedSet);
+        }
+
+        if (requested)
+        {
+            juce::String error;
+            if (set == nullptr && folderToLoad != juce::File())
+                set = loadSampleSet(folderToLoad, targetSampleRate.load(std::memory_order_relaxed), error);
+
+            // A newer request supersedes this result; a failed load leaves the playing set alone.
+            const juce::ScopedLock lock(requestLock);
+            if (!loadRequested && (set != nullptr || folderToLoad == juce::File()))
+            {
+                int numSamples = 0;
+                if (set != nullptr)
+                    for (const auto& layer : set->layers)
+                        numSamples += static_cast<int>(layer.size());
+
+                status = set != nullptr ? set->name + " (" + juce::String(static_cast<int>(set->layers.size())) + " layers, "
+                                              + juce::String(numSamples) + " samples)"
+                                        : juce::String();
+                unpublished = std::move(set);
+                hasUnpublished = true;
+            }
+            else if (!loadRequested)
+            {
+                status = error;
+            }
+        }
+
+        publishUnpublished();
+        {
+            const juce::ScopedLock lock(requestLock);
+            loading.store(loadRequested || hasUnpublished, std::memory_order_relaxed);
+        }
+
+        wait(kServiceIntervalMs);
+    }
+}
+
+void DrumSampler::publishUnpublished()
+{
+    // A null set is an unload. The audio thread owns whatever it takes from the queue.
+    if (hasUnpublished && incoming.push(unpublished.get()))
+    {
+        unpublished.release();
+        hasUnpublished = false;
+    }
+}
+
+void DrumSampler::prepare(double sampleRate)
+{
+    preparedSampleRate = sampleRate > 0.0 ? sampleRate : 44100.0;
+    stealFadeSamples = std::max(1, static_cast<int>(stealFadeMs * 0.001 * preparedSampleRate));
+    reset();
+
+    const bool rateChanged = targetSampleRate.exchange(preparedSampleRate, std::memory_order_relaxed) != preparedSampleRate;
+    const auto loadedFolder = getFolder();
+    if (rateChanged && loadedFolder != juce::File())
+        loadFolder(loadedFolder);
+}
+
+void DrumSampler::reset() noexcept
+{
+    for (auto& voice : voices)
+        voice = {};
+    roundRobinPosition.fill(0);
+    activeVoices.store(0, std::memory_order_relaxed);
+}
+
+bool DrumSampler::isSetInUse(const SampleSet* set) const noexcept
+{
+    for (const auto& voice : voices)
+        if ((voice.main.sample != nullptr && voice.main.set == set) || (voice.tail.sample != nullptr && voice.tail.set == set))
+            return true;
+
+    return false;
+}
+
+void DrumSampler::updateSampleSet() noexcept
+{
+    // The outgoing set waits in retiring until no voice plays it; with retiring full, the new set
+    // stays queued for a later block.
+    const auto* next = incoming.front();
+    if (next == nullptr || numRetiring == static_cast<int>(retiring.size()))
+        return;
+
+    if (current != nullptr)
+        retiring[static_cast<size_t>(numRetiring++)] = current;
+
+    current = *next;
+    incoming.pop();
+    roundRobinPosition.fill(0);
+}
+
+void DrumSampler::retireUnusedSets() noexcept
+{
+    for (int i = 0; i < numRetiring;)
+    {
+        auto* set = retiring[static_cast<size_t>(i)];
+        if (isSetInUse(set) || !retired.push(set))
+        {
+            ++i;
+            continue;
+        }
+
+        retiring[static_cast<size_t>(i)] = retiring[static_cast<size_t>(--numRetiring)];
+    }
+}
+
+void DrumSampler::startVoice(int velocity) noexcept
+{
+    if (current == nullptr || current->layers.empty() || velocity <= 0 || std::abs(current->sampleRate - preparedSampleRate) > 0.5)
+        return;
+
+    // Velocity 1-127 splits evenly across the layers, softest first.
+    const int numLayers = static_cast<int>(current->layers.size());
+    const int layerIndex = std::min(numLayers - 1, (velocity - 1) * numLayers / 127);
+    const auto& layer = current->layers[static_cast<size_t>(layerIndex)];
+    auto& roundRobin = roundRobinPosition[static_cast<size_t>(layerIndex)];
+    const auto* sample = &layer[static_cast<size_t>(roundRobin % static_cast<int>(layer.size()))];
+    roundRobin = (roundRobin + 1) % static_cast<int>(layer.size());
+
+    // A free voice, or else the oldest one.
+    auto* voice = &voices[0];
+    for (auto& candidate : voices)
+    {
+        if (candidate.main.sample == nullptr)
+        {
+            voice = &candidate;
+            break;
+        }
+        if (candidate.startOrder < voice->startOrder)
+            voice = &candidate;
+    }
+
+    if (voice->main.sample != nullptr)
+    {
+        voice->tail = voice->main;
+        voice->tail.fadeRemaining = stealFadeSamples;
+    }
+
+    voice->main = {};
+    voice->main.sample = sample;
+    voice->main.set = current;
+    voice->main.gain = static_cast<float>(velocity) / 127.0f;
+    voice->startOrder = nextStartOrder++;
+}
+
+void DrumSampler::renderPlayback(Playback& playback, juce::AudioBuffer<float>& output, int startSample, int endSample, float gain) noexcept
+{
+    const auto& sample = *playback.sample;
+    int length = std::min(endSample - startSample, sample.getNumSamples() - playback.position);
+    if (playback.fadeRemaining >= 0)
+        length = std::min(length, playback.fadeRemaining);
+
+    for (int channel = 0; channel < output.getNumChannels(); ++channel)
+    {
+        const auto* source = sample.getReadPointer(channel % sample.getNumChannels(), playback.position);
+        if (playback.fadeRemaining < 0)
+        {
+            output.addFrom(channel, startSample, source, length, playback.gain * gain);
+            continue;
+        }
+
+        const float step = playback.gain * gain / static_cast<float>(stealFadeSamples);
+        const float startGain = step * static_cast<float>(playback.fadeRemaining);
+        output.addFromWithRamp(channel, startSample, source, length, startGain, startGain - step * static_cast<float>(length));
+    }
+
+    playback.position += length;
+    if (playback.fadeRemaining >= 0)
+        playback.fadeRemaining -= length;
+
+    if (playback.position >= sample.getNumSamples() || playback.fadeRemaining == 0)
+        playback = {};
+}
+
+void DrumSampler::renderVoices(juce::AudioBuffer<float>& output, int startSample, int endSample, float gain) noexcept
+{
+    if (endSample <= startSample)
+        return;
+
+    for (auto& voice : voices)
+    {
+        if (voice.tail.sample != nullptr)
+            renderPlayback(voice.tail, output, startSample, endSample, gain);
+        if (voice.main.sample != nullptr)
+            renderPlayback(voice.main, output, startSample, endSample, gain);
+    }
+}
+
+void DrumSampler::process(const BeatDetector::TriggerBuffer& triggers, juce::AudioBuffer<float>& output, int numSamples,
+                          const MidiEngineParams& params, float gain) noexcept
+{
+    updateSampleSet();
+
+    // Voices start on their trigger's sample: everything before it is rendered first.
+    const auto fixedVelocity = std::clamp(params.fixedVelocity, 0, 127);
+    int rendered = 0;
+    for (int i = 0; i < (numSamples > 0 ? triggers.count : 0); ++i)
+    {
+        const auto& event = triggers.events[static_cast<size_t>(i)];
+        const int offset = std::clamp(event.sampleOffset, rendered, numSamples - 1);
+        renderVoices(output, rendered, offset, gain);
+        rendered = offset;
+
+        // The velocity MidiEngine sends for this trigger.
+        int velocity = fixedVelocity;
+        if (params.velocityMode == VelocityMode::Dynamic)
+            velocity = std::clamp(static_cast<int>(juce::jmap(event.strength, 0.0f, 1.0f, 25.0f, 127.0f)), 1, 127);
+        startVoice(velocity);
+    }
+    renderVoices(output, rendered, numSamples, gain);
+
+    int numActive = 0;
+    for (const auto& voice : voices)
+        numActive += voice.main.sample != nullptr ? 1 : 0;
+    activeVoices.store(numActive, std::memory_order_relaxed);
+
+    retireUnusedSets();
+}
+
+void DrumSampler::skipBlock() noexcept
+{
+    for (auto& voice : voices)
+        voice = {};
+    activeVoices.store(0, std::memory_order_relaxed);
+
+    updateSampleSet();
+    retireUnusedSets();
+}
+
+} // namespace audiotomidi
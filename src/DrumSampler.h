@@ -0,0 +1,145 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <juce_audio_basics/juce_audio_basics.h>
+
+#include "BeatDetector.h"
+#include "MidiEngine.h"
+#include "SpscQueue.h"
+
+namespace audiotomidi {
+
+// Plays one-shot drum samples on the output bus at each trigger's sampleOffset, so no MIDI hop
+// through a separate sampler is needed. The velocity MidiEngine would send picks a velocity layer
+// and scales the sample; within a layer the samples take turns (round-robin).
+//
+// Voices come from a fixed pool of maxVoices. When every voice is busy the one that started
+// first is stolen: its sample is faded out over stealFadeMs inside the same voice while the new
+// one starts, so stealing does not click.
+//
+// Sample sets are loaded, converted to the engine's sample rate and published by a background
+// thread; the audio thread picks a new set up through an SPSC queue at the top of a block and
+// never waits for it. Voices still playing the old set finish with it, and once none do it goes
+// back through a second queue to the loader thread, which deletes it. process() never allocates,
+// locks or frees memory.
+class DrumSampler : private juce::Thread
+{
+public:
+    static constexpr int maxVoices = 32;
+    static constexpr int maxLayers = 8;
+    static constexpr int maxRoundRobin = 16;
+    static constexpr double stealFadeMs = 2.0;
+    static constexpr double maxSampleSeconds = 10.0;
+
+    // Immutable once published. layers[0] is the softest; every layer has at least one sample.
+    struct SampleSet
+    {
+        juce::String name;
+        double sampleRate = 44100.0;
+        std::vector<std::vector<juce::AudioBuffer<float>>> layers;
+    };
+
+    DrumSampler();
+    ~DrumSampler() override;
+
+    // Reads every WAV, AIFF and FLAC file in folder (not recursively) into a set at sampleRate.
+    // A name token "v<n>" (kick_v2_rr1.wav) puts the file in velocity layer n, and layers are
+    // ordered by n; files without one form layer 1. Within a layer, files play in name order.
+    // Any thread; returns nullptr and sets error when nothing could be loaded.
+    static std::unique_ptr<SampleSet> loadSampleSet(const juce::File& folder, double sampleRate, juce::String& error);
+
+    // Message thread. Loads folder in the background and swaps it in when ready; an empty File
+    // unloads. A request made while another is loading replaces it.
+    void loadFolder(const juce::File& folder);
+
+    // Message thread. Swaps in a set built elsewhere; it must be at the prepared sample rate.
+    void publish(std::unique_ptr<SampleSet> set);
+
+    juce::File getFolder() const;
+    bool isLoading() const noexcept { return loading.load(std::memory_order_relaxed); }
+
+    // Describes the last set published, or the last load error.
+    juce::String getStatus() const;
+    int getNumActiveVoices() const noexcept { return activeVoices.load(std::memory_order_relaxed); }
+
+    // While the audio thread is stopped. A loaded folder at another sample rate is reloaded;
+    // until the new set arrives the old one does not play.
+    void prepare(double sampleRate);
+
+    // Audio thread. Silences every voice.
+    void reset() noexcept;
+
+    // Audio thread. Starts a voice per trigger and adds every voice's next numSamples samples,
+    // times gain, to output's channels. A mono sample plays on every channel.
+    void process(const BeatDetector::TriggerBuffer& triggers, juce::AudioBuffer<float>& output, int numSamples,
+                 const MidiEngineParams& params, float gain) noexcept;
+
+    // Audio thread, for blocks where the player is off: silences the voices and picks up or
+    // retires sample sets like process().
+    void skipBlock() noexcept;
+
+private:
+    struct Playback
+    {
+        const juce::AudioBuffer<float>* sample = nullptr;
+        const SampleSet* set = nullptr;
+        int position = 0;
+        float gain = 0.0f;
+        int fadeRemaining = -1; // -1 while not fading
+    };
+
+    struct Voice
+    {
+        Playback main;
+        Playback tail; // a stolen sample fading out
+        std::uint64_t startOrder = 0;
+    };
+
+    void run() override;
+    void startLoaderThread();
+    void publishUnpublished();
+    void updateSampleSet() noexcept;
+    void retireUnusedSets() noexcept;
+    void startVoice(int velocity) noexcept;
+    void renderVoices(juce::AudioBuffer<float>& output, int startSample, int endSample, float gain) noexcept;
+    void renderPlayback(Playback& playback, juce::AudioBuffer<float>& output, int startSample, int endSample, float gain) noexcept;
+    bool isSetInUse(const SampleSet* set) const noexcept;
+
+    // Loader thread to audio thread, and back for deletion. A null set unloads.
+    SpscQueue<SampleSet*, 4> incoming;
+    SpscQueue<SampleSet*, 8> retired;
+
+    // Audio thread state.
+    double preparedSampleRate = 44100.0;
+    SampleSet* current = nullptr;
+    std::array<SampleSet*, 4> retiring {};
+    int numRetiring = 0;
+    std::array<Voice, maxVoices> voices {};
+    std::array<int, maxLayers> roundRobinPosition {};
+    std::uint64_t nextStartOrder = 0;
+    int stealFadeSamples = 1;
+    std::atomic<int> activeVoices { 0 };
+
+    // Shared between the message and loader threads.
+    mutable juce::CriticalSection requestLock;
+    juce::File folder;
+    juce::File requestedFolder;
+    bool loadRequested = false;
+    std::unique_ptr<SampleSet> requestedSet;
+    juce::String status;
+    std::atomic<double> targetSampleRate { 44100.0 };
+    std::atomic<bool> loading { false };
+
+    // Loader thread: a set (or, when null, an unload) the full incoming queue did not take yet.
+    std::unique_ptr<SampleSet> unpublished;
+    bool hasUnpublished = false;
+
+    JUCE_DECLARE_NON_COPYABLE(DrumSampler)
+};
+
+} // namespace audiotomidi
@@ -0,0 +1,328 @@
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <utility>
+#include <vector>
+
+#include <juce_audio_basics/juce_audio_basics.h>
+
+#include "BeatDetector.h"
+#include "DetectionEval.h"
+#include "EvalPasses.h"
+#include "MidiEngine.h"
+
+namespace
+{
+constexpr std::array<double, 2> kTempos { 100.0, 180.0 };
+
+struct EvalOptions
+{
+    juce::String filter;
+    juce::File goldenFile;
+    juce::File writeGoldenFile;
+    double latencyTolerance = 0.1;
+    double fMeasureTolerance = 0.02;
+    bool quick = false;
+};
+
+struct ScenarioResult
+{
+    juce::String name;
+    audiotomidi::DetectionScore score;
+    double sampleRate = 0.0;
+    int blockSizeMismatches = 0;
+    bool midiMatches = true;
+};
+
+struct PipelineOutput
+{
+    std::vector<std::int64_t> noteOns;
+    int noteOffs = 0;
+};
+
+// Runs BeatDetector and MidiEngine together the way the processor does and collects the absolute
+// position of every note-on, compensated for the detector's latency. A tail of silence lets the
+// last note-off through.
+PipelineOutput runPipeline(const std::vector<float>& samples, double sampleRate, int blockSize, const audiotomidi::BeatDetector::Params& params)
+{
+    audiotomidi::BeatDetector detector;
+    audiotomidi::MidiEngine midiEngine;
+    detector.prepare(sampleRate);
+    midiEngine.prepare(sampleRate);
+
+    audiotomidi::MidiEngineParams midiParams;
+    audiotomidi::BeatDetector::TriggerBuffer triggers;
+    juce::MidiBuffer midi;
+    midi.ensureSize(2048);
+
+    const std::vector<float> silence(static_cast<size_t>(blockSize), 0.0f);
+    const auto total = static_cast<juce::int64>(samples.size());
+    const auto latency = detector.getLatencySamples(params);
+    const auto tail = latency + static_cast<juce::int64>(sampleRate * 0.001 * (midiParams.noteLengthMs + 10));
+
+    PipelineOutput output;
+    for (juce::int64 position = 0; position < total + tail; position += blockSize)
+    {
+        const auto numSamples = position < total ? static_cast<int>(std::min<juce::int64>(blockSize, total - position)) : blockSize;
+        const float* input = position < total ? samples.data() + position : silence.data();
+
+        midi.clear();
+        detector.processBlock(input, numSamples, params, triggers);
+        midiEngine.process(triggers, midi, numSamples, midiParams);
+
+        for (const auto metadata : midi)
+        {
+            const auto message = metadata.getMessage();
+            if (message.isNoteOn())
+                output.noteOns.push_back(static_cast<std::int64_t>(position + metadata.samplePosition - latency));
+            else if (message.isNoteOff())
+                ++output.noteOffs;
+        }
+    }
+
+    return output;
+}
+
+ScenarioResult evaluateScenario(const audiotomidi::SyntheticScenario& scenario, float lookaheadMs, const EvalOptions& options)
+{
+    const auto signal = audiotomidi::generateSyntheticSignal(scenario);
+
+    audiotomidi::BeatDetector::Params params;
+    params.focusLow = scenario.hit == audiotomidi::SyntheticHit::DecayingSine;
+    params.lookaheadMs = lookaheadMs;
+
+    const auto reference = audiotomidi::detectOnsets(signal.samples, scenario.sampleRate, audiotomidi::kEvalReferenceBlockSize, params);
+
+    ScenarioResult result;
+    result.name = scenario.getName();
+    if (lookaheadMs > 0.0f)
+        result.name << "/lookahead=" << juce::String(lookaheadMs, 0) << "ms";
+    result.sampleRate = scenario.sampleRate;
+    result.score = audiotomidi::scoreEvalDetections(signal.onsets, reference, scenario.sampleRate);
+
+    for (const auto blockSize : audiotomidi::kEvalBlockSizes)
+    {
+        if (options.quick && blockSize < 64)
+            continue;
+
+        const auto pipeline = runPipeline(signal.samples, scenario.sampleRate, blockSize, params);
+        const auto& detections = pipeline.noteOns;
+
+        if (detections != reference)
+        {
+            ++result.blockSizeMismatches;
+            std::cerr << "BLOCK SIZE " << result.name << ": " << juce::String(static_cast<int>(detections.size()))
+                      << " note-ons at block " << blockSize << " vs " << juce::String(static_cast<int>(reference.size()))
+                      << " triggers at block " << audiotomidi::kEvalReferenceBlockSize << "\n";
+        }
+
+        if (pipeline.noteOffs != static_cast<int>(pipeline.noteOns.size()))
+        {
+            result.midiMatches = false;
+            std::cerr << "MIDI " << result.name << ": " << pipeline.noteOffs << " note-offs for "
+                      << static_cast<int>(pipeline.noteOns.size()) << " note-ons at block " << blockSize << "\n";
+        }
+    }
+
+    return result;
+}
+
+std::vector<audiotomidi::SyntheticScenario> makeScenarios(const EvalOptions& options)
+{
+    std::vector<audiotomidi::SyntheticScenario> scenarios;
+    unsigned int seed = 1;
+
+    for (const auto hit : audiotomidi::kEvalHits)
+        for (const auto sampleRate : audiotomidi::kEvalSampleRates)
+            for (const auto tempo : kTempos)
+                for (const auto snr : audiotomidi::kEvalSnrDb)
+                {
+                    audiotomidi::SyntheticScenario scenario;
+                    scenario.hit = hit;
+                    scenario.sampleRate = sampleRate;
+                    scenario.tempoBpm = tempo;
+                    scenario.snrDb = snr;
+                    scenario.seconds = options.quick ? 4.0 : 8.0;
+                    scenario.seed = seed++;
+
+                    if (options.filter.isEmpty() || juce::String(scenario.getName()).contains(options.filter))
+                        scenarios.push_back(scenario);
+                }
+
+    return scenarios;
+}
+
+double roundTo(double value, double step)
+{
+    return std::round(value / step) * step;
+}
+
+juce::var resultsToJson(const std::vector<ScenarioResult>& results)
+{
+    auto root = std::make_unique<juce::DynamicObject>();
+    root->setProperty("version", 1);
+
+    juce::Array<juce::var> entries;
+    for (const auto& r : results)
+    {
+        auto entry = std::make_unique<juce::DynamicObject>();
+        entry->setProperty("name", r.name);
+        entry->setProperty("meanLatencySamples", roundTo(r.score.meanLatencySamples, 0.01));
+        entry->setProperty("p99LatencySamples", r.score.p99LatencySamples);
+        entry->setProperty("fMeasure", roundTo(r.score.getFMeasure(), 0.0001));
+        entries.add(juce::var(entry.release()));
+    }
+    root->setProperty("scenarios", entries);
+
+    return juce::var(root.release());
+}
+
+// Latency may grow by the relative tolerance or one millisecond, whichever is larger; F-measure
+// may drop by the absolute tolerance. Returns the number of scenarios outside those bounds.
+int compareWithGolden(const std::vector<ScenarioResult>& results, const juce::File& goldenFile, const EvalOptions& options)
+{
+    const auto golden = juce::JSON::parse(goldenFile);
+    const auto* entries = golden["scenarios"].getArray();
+    if (entries == nullptr)
+    {
+        std::cerr << "Golden file " << goldenFile.getFullPathName() << " has no scenarios array\n";
+        return 1;
+    }
+
+    int regressions = 0;
+    for (const auto& r : results)
+    {
+        for (const auto& entry : *entries)
+        {
+            if (entry["name"].toString() != r.name)
+                continue;
+
+            const double slack = 0.001 * r.sampleRate;
+            const double goldenMean = static_cast<double>(entry["meanLatencySamples"]);
+            const double goldenP99 = static_cast<double>(entry["p99LatencySamples"]);
+            const double goldenF = static_cast<double>(entry["fMeasure"]);
+
+            juce::StringArray problems;
+            if (r.score.meanLatencySamples > goldenMean + std::max(slack, goldenMean * options.latencyTolerance))
+                problems.add("mean latency " + juce::String(r.score.meanLatencySamples, 1) + " vs " + juce::String(goldenMean, 1));
+            if (r.score.p99LatencySamples > goldenP99 + std::max(slack, goldenP99 * options.latencyTolerance))
+                problems.add("p99 latency " + juce::String(r.score.p99LatencySamples, 0) + " vs " + juce::String(goldenP99, 0));
+            if (r.score.getFMeasure() < goldenF - options.fMeasureTolerance)
+                problems.add("F " + juce::String(r.score.getFMeasure(), 3) + " vs " + juce::String(goldenF, 3));
+
+            if (!problems.isEmpty())
+            {
+                ++regressions;
+                std::cerr << "REGRESSION " << r.name << ": " << problems.joinIntoString(", ") << "\n";
+            }
+            break;
+        }
+    }
+
+    std::cerr << (regressions == 0 ? "No regressions" : juce::String(regressions) + " regression(s)") << " against "
+              << goldenFile.getFileName() << "\n";
+    return regressions;
+}
+
+void printUsage()
+{
+    std::cout << "Usage: AudioToMidiBeatEval [options]\n"
+                 "\n"
+                 "Runs synthetic clicks, decaying sines and noise bursts through BeatDetector and MidiEngine\n"
+                 "at every supported sample rate and block size, with and without lookahead, and reports\n"
+                 "detection latency, precision/recall/F-measure and block-size invariance. Then runs the\n"
+                 "check passes:";
+
+    for (const auto& pass : audiotomidi::getEvalPasses())
+        std::cout << " " << pass.name;
+
+    std::cout << "\n"
+                 "\n"
+                 "Options:\n"
+                 "  --filter=<text>              only run scenarios and passes whose name contains text\n"
+                 "  --golden=<file>              fail if latency or accuracy regressed against this file\n"
+                 "  --write-golden=<file>        write the current results as a new golden file\n"
+                 "  --latency-tolerance=<ratio>  allowed latency growth (default: 0.1)\n"
+                 "  --f-tolerance=<value>        allowed F-measure drop (default: 0.02)\n"
+                 "  --quick                      shorter signals and fewer block sizes\n";
+}
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    EvalOptions options;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const juce::String arg(juce::CharPointer_UTF8(argv[i]));
+        const auto value = arg.fromFirstOccurrenceOf("=", false, false);
+        const auto cwd = juce::File::getCurrentWorkingDirectory();
+
+        if (arg.startsWith("--filter="))
+            options.filter = value;
+        else if (arg.startsWith("--golden="))
+            options.goldenFile = cwd.getChildFile(value);
+        else if (arg.startsWith("--write-golden="))
+            options.writeGoldenFile = cwd.getChildFile(value);
+        else if (arg.startsWith("--latency-tolerance="))
+            options.latencyTolerance = value.getDoubleValue();
+        else if (arg.startsWith("--f-tolerance="))
+            options.fMeasureTolerance = value.getDoubleValue();
+        else if (arg == "--quick")
+            options.quick = true;
+        else
+        {
+            printUsage();
+            return arg == "--help" || arg == "-h" ? 0 : 1;
+        }
+    }
+
+    std::vector<ScenarioResult> results;
+    int invarianceFailures = 0;
+
+    std::vector<std::pair<audiotomidi::SyntheticScenario, float>> runs;
+    for (const auto lookaheadMs : { 0.0f, audiotomidi::kEvalLookaheadMs })
+        for (const auto& scenario : makeScenarios(options))
+            runs.emplace_back(scenario, lookaheadMs);
+
+    for (const auto& [scenario, lookaheadMs] : runs)
+    {
+        const auto r = evaluateScenario(scenario, lookaheadMs, options);
+        const double msPerSample = 1000.0 / r.sampleRate;
+
+        std::cout << r.name.paddedRight(' ', 52)
+                  << "  mean " << juce::String(r.score.meanLatencySamples, 1) << " smp (" << juce::String(r.score.meanLatencySamples * msPerSample, 2) << " ms)"
+                  << "  p99 " << juce::String(r.score.p99LatencySamples, 0) << " smp"
+                  << "  P " << juce::String(r.score.getPrecision(), 3)
+                  << "  R " << juce::String(r.score.getRecall(), 3)
+                  << "  F " << juce::String(r.score.getFMeasure(), 3)
+                  << (r.blockSizeMismatches == 0 && r.midiMatches ? "" : "  BLOCK-SIZE/MIDI MISMATCH") << "\n";
+
+        if (r.blockSizeMismatches > 0 || !r.midiMatches)
+            ++invarianceFailures;
+
+        results.push_back(r);
+    }
+
+    if (options.writeGoldenFile != juce::File())
+    {
+        options.writeGoldenFile.replaceWithText(juce::JSON::toString(resultsToJson(results)));
+        std::cerr << "Wrote " << options.writeGoldenFile.getFullPathName() << "\n";
+    }
+
+    int regressions = 0;
+    if (options.goldenFile != juce::File())
+        regressions = compareWithGolden(results, options.goldenFile, options);
+
+    if (invarianceFailures > 0)
+        std::cerr << invarianceFailures << " scenario(s) depend on the block size or lost note-offs\n";
+
+    int passFailures = 0;
+    for (const auto& pass : audiotomidi::getEvalPasses())
+        if (options.filter.isEmpty() || juce::String(pass.name).contains(options.filter))
+            passFailures += audiotomidi::runEvalPass(pass);
+
+    return regressions == 0 && invarianceFailures == 0 && passFailures == 0 ? 0 : 2;
+}
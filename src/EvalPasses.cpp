@@ -0,0 +1,1422 @@
+#include "EvalPasses.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <thread>
+#include <utility>
+
+#include <juce_audio_basics/juce_audio_basics.h>
+#include <juce_audio_formats/juce_audio_formats.h>
+
+#include "BeatDetector.h"
+#include "CaptureReplay.h"
+#include "ChunkedAnalysis.h"
+#include "DetectorBank.h"
+#include "DownmixKernel.h"
+#include "DrumSampler.h"
+#include "FixedPointDetector.h"
+#include "InputCapture.h"
+#include "MidiEngine.h"
+#include "NeuralOnsetDetector.h"
+#include "OnsetCache.h"
+#include "ParameterSnapshot.h"
+#include "ParameterSweep.h"
+#include "TempoTracker.h"
+#include "TriggerEngine.h"
+
+namespace audiotomidi {
+
+namespace
+{
+SyntheticScenario makeScenario(SyntheticHit hit, double sampleRate, double tempoBpm, double snrDb, double seconds, unsigned int seed)
+{
+    SyntheticScenario scenario;
+    scenario.hit = hit;
+    scenario.sampleRate = sampleRate;
+    scenario.tempoBpm = tempoBpm;
+    scenario.snrDb = snrDb;
+    scenario.seconds = seconds;
+    scenario.seed = seed;
+    return scenario;
+}
+
+// Runs samples through any detector with BeatDetector's processBlock() and collects its triggers.
+template <typename DetectorType>
+OnsetList collectOnsets(DetectorType& detector, const std::vector<float>& samples, int blockSize, const BeatDetector::Params& params)
+{
+    BeatDetector::TriggerBuffer triggers;
+    OnsetList onsets;
+    for (size_t position = 0; position < samples.size(); position += static_cast<size_t>(blockSize))
+    {
+        detector.processBlock(samples.data() + position, static_cast<int>(std::min<size_t>(static_cast<size_t>(blockSize), samples.size() - position)),
+                              params, triggers);
+        for (int i = 0; i < triggers.count; ++i)
+            onsets.push_back({ static_cast<std::int64_t>(position) + triggers.events[static_cast<size_t>(i)].sampleOffset,
+                               triggers.events[static_cast<size_t>(i)].strength });
+    }
+    return onsets;
+}
+
+bool sameOnsets(const OnsetList& a, const OnsetList& b)
+{
+    bool same = a.size() == b.size();
+    for (size_t i = 0; same && i < a.size(); ++i)
+        same = a[i].samplePosition == b[i].samplePosition && a[i].strength == b[i].strength;
+    return same;
+}
+
+std::vector<std::int64_t> getPositions(const OnsetList& onsets)
+{
+    std::vector<std::int64_t> positions;
+    for (const auto& onset : onsets)
+        positions.push_back(onset.samplePosition);
+    return positions;
+}
+
+//==============================================================================
+// Drives MidiEngine with thousands of overlapping notes under each retrigger policy, with far
+// more notes held at once than the engine has note-off slots. Every note-on must get exactly one
+// note-off, and Cut and Extend must never strike a note that is already held.
+void runMidiStressPass(EvalPass& pass)
+{
+    constexpr double sampleRate = 48000.0;
+    constexpr int blockSize = 64;
+    constexpr int numBlocks = 6000;
+
+    for (const auto policy : { RetriggerPolicy::Layer, RetriggerPolicy::Cut, RetriggerPolicy::Extend })
+    {
+        MidiEngine engine;
+        engine.prepare(sampleRate);
+
+        MidiEngineParams params;
+        params.noteLengthMs = 120;
+        params.retrigger = policy;
+
+        std::mt19937 rng(7);
+        std::uniform_int_distribution<int> triggersPerBlock(0, 64);
+        std::uniform_int_distribution<int> noteDistribution(30, 45);
+
+        BeatDetector::TriggerBuffer triggers;
+        juce::MidiBuffer midi;
+        midi.ensureSize(8192);
+
+        std::array<int, 128> heldNotes {};
+        int noteOns = 0;
+        int noteOffs = 0;
+        int maxPending = 0;
+        bool stacked = false;
+
+        auto collect = [&]
+        {
+            for (const auto metadata : midi)
+            {
+                const auto message = metadata.getMessage();
+                auto& held = heldNotes[static_cast<size_t>(message.getNoteNumber())];
+                if (message.isNoteOn())
+                {
+                    ++noteOns;
+                    stacked = stacked || (policy != RetriggerPolicy::Layer && held > 0);
+                    ++held;
+                }
+                else if (message.isNoteOff())
+                {
+                    ++noteOffs;
+                    --held;
+                }
+            }
+            midi.clear();
+        };
+
+        for (int block = 0; block < numBlocks; ++block)
+        {
+            triggers.count = triggersPerBlock(rng);
+            for (int i = 0; i < triggers.count; ++i)
+            {
+                auto& event = triggers.events[static_cast<size_t>(i)];
+                event.sampleOffset = i;
+                event.strength = 1.0f;
+                event.noteNumber = noteDistribution(rng);
+            }
+
+            engine.process(triggers, midi, blockSize, params);
+            maxPending = std::max(maxPending, engine.getNumPendingNoteOffs());
+            collect();
+        }
+
+        triggers.count = 0;
+        engine.process(triggers, midi, static_cast<int>(sampleRate), params);
+        collect();
+
+        const char* names[] = { "layer", "cut", "extend" };
+        pass.expect(noteOns == noteOffs && !stacked && engine.getNumPendingNoteOffs() == 0, names[static_cast<int>(policy)],
+                    juce::String(noteOns) + " note-ons, " + juce::String(noteOffs) + " note-offs, peak " + juce::String(maxPending) + " pending");
+    }
+}
+
+// Ramps Sensitivity from 20 to 80 across one 2048-sample block through TriggerEngine. Two equal
+// bursts sit in the block, one early and one late, loud enough to cross the threshold at the new
+// value but not at the old one. The threshold must move per 32-sample slice: only the late burst
+// triggers, exactly as when BeatDetector runs the block's slices with the interpolated values.
+// The silent blocks that follow have no automation and must take processBlock()'s unsliced path,
+// whose silence skip leaves the detector in a state the sliced path does not reproduce.
+void runAutomationPass(EvalPass& pass)
+{
+    constexpr double sampleRate = 48000.0;
+    constexpr int blockSize = 2048;
+    constexpr int sliceSize = 32;
+    constexpr int burstLength = 192;
+    constexpr float burstLevel = 0.25f;
+    constexpr std::array<int, 2> burstStarts { 200, 1700 };
+    constexpr int warmupBlocks = 4;
+    constexpr int silentBlocks = 12;
+
+    ParameterSnapshot from;
+    from.detector.sensitivity = 20.0f;
+    from.detector.focusLow = false;
+    auto to = from;
+    to.detector.sensitivity = 80.0f;
+
+    std::vector<float> rampBlock(static_cast<size_t>(blockSize), 0.0f);
+    for (const auto start : burstStarts)
+        std::fill_n(rampBlock.begin() + start, burstLength, burstLevel);
+    const std::vector<float> silence(static_cast<size_t>(blockSize), 0.0f);
+
+    TriggerEngine engine;
+    engine.prepare(sampleRate);
+    BeatDetector::TriggerBuffer triggers;
+    const auto runEngine = [&](const std::vector<float>& block, const ParameterSnapshot& params)
+    {
+        const float* channels[] = { block.data() };
+        float peak = 0.0f;
+        for (const auto x : block)
+            peak = std::max(peak, std::abs(x));
+        engine.detect(block.data(), channels, 1, blockSize, peak, params, triggers);
+    };
+
+    // Warm-up in silence at the old value, then the ramp block in slices, stepped to the new value
+    // for the whole block, or held at the old one.
+    const auto runReference = [&](BeatDetector& detector, BeatDetector::TriggerBuffer& out, const char* mode)
+    {
+        detector.prepare(sampleRate);
+        for (int block = 0; block < warmupBlocks; ++block)
+            detector.processBlock(silence.data(), blockSize, from.detector, out, 0.0f);
+
+        out.count = 0;
+        if (std::strcmp(mode, "sliced") == 0)
+        {
+            for (int start = 0; start < blockSize; start += sliceSize)
+            {
+                auto params = to.detector;
+                params.sensitivity = juce::jmap(static_cast<float>(start + sliceSize) / static_cast<float>(blockSize), from.detector.sensitivity,
+                                                to.detector.sensitivity);
+                detector.processRange(rampBlock.data(), start, sliceSize, params, out);
+            }
+        }
+        else
+        {
+            detector.processRange(rampBlock.data(), 0, blockSize, std::strcmp(mode, "stepped") == 0 ? to.detector : from.detector, out);
+        }
+    };
+
+    for (int block = 0; block < warmupBlocks; ++block)
+        runEngine(silence, from);
+    runEngine(rampBlock, to);
+
+    BeatDetector sliced, stepped, held;
+    BeatDetector::TriggerBuffer slicedTriggers, steppedTriggers, heldTriggers;
+    runReference(sliced, slicedTriggers, "sliced");
+    runReference(stepped, steppedTriggers, "stepped");
+    runReference(held, heldTriggers, "held");
+
+    bool matchesSliced = triggers.count == slicedTriggers.count && triggers.threshold == slicedTriggers.threshold;
+    for (int i = 0; matchesSliced && i < triggers.count; ++i)
+        matchesSliced = triggers.events[static_cast<size_t>(i)].sampleOffset == slicedTriggers.events[static_cast<size_t>(i)].sampleOffset
+                        && triggers.events[static_cast<size_t>(i)].strength == slicedTriggers.events[static_cast<size_t>(i)].strength;
+
+    // Stepping would fire on the early burst and holding on neither.
+    const auto firstTrigger = [](const BeatDetector::TriggerBuffer& buffer) { return buffer.count > 0 ? buffer.events[0].sampleOffset : -1; };
+    const bool onlyLateBurst = triggers.count == 1 && firstTrigger(triggers) >= burstStarts[1];
+    const bool steppedEarly = firstTrigger(steppedTriggers) >= burstStarts[0] && firstTrigger(steppedTriggers) < burstStarts[1];
+    pass.expect(matchesSliced && onlyLateBurst && steppedEarly && heldTriggers.count == 0, "ramp",
+                juce::String(triggers.count) + " trigger(s), first at " + juce::String(firstTrigger(triggers))
+                    + (matchesSliced ? ", as sliced" : ", unlike sliced") + "; stepped fires at " + juce::String(firstTrigger(steppedTriggers))
+                    + ", held " + juce::String(heldTriggers.count) + " time(s)");
+
+    // The detector's state after each silent block, from the engine, from processBlock() given the
+    // block's peak, and from the same block in slices.
+    BeatDetector unsliced;
+    BeatDetector::TriggerBuffer unslicedTriggers;
+    runReference(unsliced, unslicedTriggers, "sliced");
+
+    int unslicedMismatches = 0;
+    int slicedDifferences = 0;
+    for (int block = 0; block < silentBlocks; ++block)
+    {
+        runEngine(silence, to);
+        unsliced.processBlock(silence.data(), blockSize, to.detector, unslicedTriggers, 0.0f);
+        slicedTriggers.count = 0;
+        for (int start = 0; start < blockSize; start += sliceSize)
+            sliced.processRange(silence.data(), start, sliceSize, to.detector, slicedTriggers);
+
+        unslicedMismatches += engine.getDetector().getNoiseFloor() == unsliced.getNoiseFloor() && triggers.envelope == unslicedTriggers.envelope ? 0 : 1;
+        slicedDifferences += unsliced.getNoiseFloor() == sliced.getNoiseFloor() && unslicedTriggers.envelope == slicedTriggers.envelope ? 0 : 1;
+    }
+
+    pass.expect(unslicedMismatches == 0 && slicedDifferences > 0, "steady",
+                juce::String(unslicedMismatches) + " of " + juce::String(silentBlocks) + " blocks differ from processBlock(), "
+                    + juce::String(slicedDifferences) + " from the sliced path");
+}
+
+// Appends a block's MIDI from event firstEvent on as block, offset, size and data bytes.
+void appendEvents(std::vector<int>& events, int block, const juce::MidiBuffer& midi, int firstEvent)
+{
+    int index = 0;
+    for (const auto metadata : midi)
+    {
+        if (index++ < firstEvent)
+            continue;
+
+        events.insert(events.end(), { block, metadata.samplePosition, metadata.numBytes });
+        for (int i = 0; i < 3; ++i)
+            events.push_back(i < metadata.numBytes ? metadata.data[i] : 0);
+    }
+}
+
+// Runs a noise-burst groove through TriggerEngine the way the plugin does, with varying block
+// sizes, automated Sensitivity, MinGapMs and note length, and MIDI clock on, and starts a
+// capture part way through, while notes are held and the clock runs. The capture must hold
+// exactly the MIDI the engine produced and AudioToMidiBeatReplay's replay must reproduce every
+// block of it byte for byte. Without the restart the capture's first block asks for, the replay
+// starts from a different state and must diverge.
+void runCaptureReplayPass(EvalPass& pass)
+{
+    constexpr double sampleRate = 48000.0;
+    constexpr std::array<int, 5> blockSizes { 512, 64, 1000, 256, 333 };
+    constexpr int blocksBeforeCapture = 500;
+    constexpr int numCapturedBlocks = 700;
+
+    const auto groove = generateSyntheticSignal(makeScenario(SyntheticHit::NoiseBurst, sampleRate, 128.0, 24.0, 12.0, 5)).samples;
+    const auto folder = juce::File::getSpecialLocation(juce::File::tempDirectory).getNonexistentChildFile("AudioToMidiBeatEvalCapture", "", false);
+
+    for (const bool restart : { true, false })
+    {
+        TriggerEngine engine;
+        InputCapture capture;
+        engine.prepare(sampleRate);
+        capture.prepare(sampleRate);
+
+        BeatDetector::TriggerBuffer triggers;
+        juce::MidiBuffer midi;
+        midi.ensureSize(2048);
+        std::vector<int> liveEvents;
+        int clockTicks = 0;
+
+        size_t position = 0;
+        for (int block = 0; block < blocksBeforeCapture + numCapturedBlocks; ++block)
+        {
+            const int numSamples = blockSizes[static_cast<size_t>(block) % blockSizes.size()];
+            const float* samples = groove.data() + position;
+            position += static_cast<size_t>(numSamples);
+
+            ParameterSnapshot params;
+            params.detector.sensitivity = 55.0f + 15.0f * std::sin(0.05f * static_cast<float>(block));
+            params.detector.minGapMs = 100.0f + 40.0f * std::sin(0.031f * static_cast<float>(block));
+            params.detector.focusLow = false;
+            params.midi.noteLengthMs = 20 + 10 * (block / 50 % 4);
+            params.midiClock = true;
+
+            if (block == blocksBeforeCapture && !capture.start(folder))
+                break;
+
+            midi.clear();
+            int firstEvent = 0;
+            if (capture.beginBlock() && restart)
+            {
+                engine.restart(midi, 0);
+                firstEvent = midi.getNumEvents();
+            }
+
+            float peak = 0.0f;
+            for (int i = 0; i < numSamples; ++i)
+                peak = std::max(peak, std::abs(samples[i]));
+
+            engine.detect(samples, &samples, 1, numSamples, peak, params, triggers);
+            engine.generateMidi(triggers, midi, numSamples, params);
+            capture.captureBlock(&samples, 1, numSamples, peak, params, midi, firstEvent);
+
+            if (block >= blocksBeforeCapture)
+            {
+                appendEvents(liveEvents, block - blocksBeforeCapture, midi, firstEvent);
+                for (const auto metadata : midi)
+                    clockTicks += metadata.getMessage().isMidiClock() ? 1 : 0;
+            }
+        }
+        capture.stop();
+
+        // The MIDI the capture holds, in the same layout as liveEvents.
+        std::vector<int> capturedEvents;
+        InputCapture::Reader reader(capture.getCaptureFile());
+        InputCapture::Reader::Record record;
+        for (int block = 0; reader.next(record);)
+        {
+            if (record.kind != InputCapture::Reader::Record::Kind::Block)
+                continue;
+
+            for (int i = 0; i < record.numEvents; ++i)
+            {
+                const auto event = record.getEvent(i);
+                capturedEvents.insert(capturedEvents.end(), { block, event.sampleOffset, event.size, event.data[0], event.data[1], event.data[2] });
+            }
+            ++block;
+        }
+
+        const auto result = replayCapture(capture.getCaptureFile());
+        const auto detail = juce::String(result.numBlocks) + " blocks, " + juce::String(result.numEvents) + " events (" + juce::String(clockTicks)
+                          + " clock ticks), " + juce::String(capture.getNumDroppedBlocks()) + " dropped, "
+                          + (capturedEvents == liveEvents ? "capture holds the live MIDI" : "capture differs from the live MIDI") + "; "
+                          + (result.firstMismatchBlock < 0 ? "replay matches"
+                                                           : "replay differs at block " + juce::String(result.firstMismatchBlock) + ": " + result.mismatch);
+
+        if (restart)
+            pass.expect(result.numBlocks == numCapturedBlocks && capture.getNumDroppedBlocks() == 0 && clockTicks > 0 && capturedEvents == liveEvents
+                            && result.firstMismatchBlock < 0,
+                        "restart", detail);
+        else
+            pass.expect(result.numBlocks == numCapturedBlocks && result.firstMismatchBlock >= 0, "no-restart", detail);
+    }
+
+    folder.deleteRecursively();
+}
+
+// Runs 16 different channels, every hit type at several tempos and noise levels, through one
+// DetectorBank and through 16 BeatDetectors at 44.1 and 48 kHz, where neither decimates. Each
+// lane must report exactly the trigger positions and strengths of the BeatDetector fed its
+// channel, with FocusLow on and off, with 5 and 16 lanes, and at block sizes that do and do not
+// fill the bank's 256-sample tiles.
+void runDetectorBankPass(EvalPass& pass)
+{
+    constexpr int numChannels = DetectorBank::maxLanes;
+    constexpr double seconds = 6.0;
+
+    for (const auto sampleRate : { 44100.0, 48000.0 })
+    {
+        std::vector<std::vector<float>> channels;
+        for (int channel = 0; channel < numChannels; ++channel)
+        {
+            const auto hit = kEvalHits[static_cast<size_t>(channel) % kEvalHits.size()];
+            const auto snrDb = kEvalSnrDb[static_cast<size_t>(channel / 3) % kEvalSnrDb.size()];
+            channels.push_back(generateSyntheticSignal(makeScenario(hit, sampleRate, 90.0 + 10.0 * channel, snrDb, seconds,
+                                                                    static_cast<unsigned int>(channel + 1)))
+                                   .samples);
+        }
+        const auto numSamples = static_cast<int>(channels.front().size());
+
+        for (const bool focusLow : { true, false })
+            for (const int numLanes : { 5, numChannels })
+                for (const int blockSize : { 64, 256, 1000, 4096 })
+                {
+                    BeatDetector::Params params;
+                    params.focusLow = focusLow;
+
+                    DetectorBank bank;
+                    bank.prepare(sampleRate);
+                    std::array<int, DetectorBank::maxLanes> laneNotes {};
+                    for (size_t lane = 0; lane < laneNotes.size(); ++lane)
+                        laneNotes[lane] = static_cast<int>(lane);
+
+                    std::vector<OnsetList> laneOnsets(static_cast<size_t>(numLanes));
+                    BeatDetector::TriggerBuffer triggers;
+                    std::array<const float*, DetectorBank::maxLanes> blockChannels {};
+                    for (int position = 0; position < numSamples; position += blockSize)
+                    {
+                        const int length = std::min(blockSize, numSamples - position);
+                        for (size_t lane = 0; lane < static_cast<size_t>(numLanes); ++lane)
+                            blockChannels[lane] = channels[lane].data() + position;
+
+                        bank.processBlock(blockChannels.data(), numLanes, length, params, laneNotes, triggers);
+                        for (int i = 0; i < triggers.count; ++i)
+                        {
+                            const auto& event = triggers.events[static_cast<size_t>(i)];
+                            laneOnsets[static_cast<size_t>(event.noteNumber)].push_back({ position + event.sampleOffset, event.strength });
+                        }
+                    }
+
+                    int mismatchedLanes = 0;
+                    size_t numOnsets = 0;
+                    for (size_t lane = 0; lane < static_cast<size_t>(numLanes); ++lane)
+                    {
+                        BeatDetector detector;
+                        detector.prepare(sampleRate);
+                        const auto expected = collectOnsets(detector, channels[lane], blockSize, params);
+                        mismatchedLanes += sameOnsets(laneOnsets[lane], expected) ? 0 : 1;
+                        numOnsets += expected.size();
+                    }
+
+                    pass.expect(mismatchedLanes == 0,
+                                "sr=" + juce::String(static_cast<int>(sampleRate)) + "/focusLow=" + (focusLow ? "on" : "off") + "/lanes="
+                                    + juce::String(numLanes) + "/block=" + juce::String(blockSize),
+                                juce::String(mismatchedLanes) + " of " + juce::String(numLanes) + " lanes differ from BeatDetector, "
+                                    + juce::String(static_cast<int>(numOnsets)) + " onsets");
+                }
+    }
+}
+
+// Streams one chunk of samples through an OnsetAnalyser as OfflineConverter does, with silence
+// past the end of the signal to flush the lookahead.
+OnsetList analyseChunk(const std::vector<float>& samples, const AnalysisChunk& chunk, double sampleRate, const BeatDetector::Params& params)
+{
+    OnsetAnalyser analyser;
+    analyser.prepare(sampleRate, params);
+    analyser.begin(chunk);
+
+    std::vector<float> block(kEvalReferenceBlockSize);
+    const auto streamEnd = chunk.end + analyser.getLatencySamples();
+    for (auto position = chunk.warmupStart; position < streamEnd; position += kEvalReferenceBlockSize)
+    {
+        const auto numSamples = static_cast<int>(std::min<std::int64_t>(kEvalReferenceBlockSize, streamEnd - position));
+        for (int i = 0; i < numSamples; ++i)
+        {
+            const auto index = static_cast<size_t>(position + i);
+            block[static_cast<size_t>(i)] = index < samples.size() ? samples[index] : 0.0f;
+        }
+        analyser.process(block.data(), numSamples);
+    }
+
+    return analyser.takeOnsets();
+}
+
+// Splits every hit type into chunks as --split-file does and stitches their onsets. Positions
+// must match the single-pass analysis exactly and strengths within 1e-4, as OfflineConverter.h
+// documents.
+void runChunkedPass(EvalPass& pass)
+{
+    constexpr float kChunkStrengthTolerance = 1.0e-4f;
+
+    for (const auto sampleRate : kEvalSampleRates)
+        for (const bool focusLow : { true, false })
+            for (const auto lookaheadMs : { 0.0f, 5.0f })
+                for (const auto hit : kEvalHits)
+                {
+                    const auto scenario = makeScenario(hit, sampleRate, 150.0, 18.0, 16.0, 3);
+                    const auto samples = generateSyntheticSignal(scenario).samples;
+                    const auto totalSamples = static_cast<std::int64_t>(samples.size());
+
+                    BeatDetector::Params params;
+                    params.focusLow = focusLow;
+                    params.lookaheadMs = lookaheadMs;
+
+                    BeatDetector gapReference;
+                    gapReference.prepare(sampleRate);
+                    const auto single = analyseChunk(samples, { 0, 0, totalSamples }, sampleRate, params);
+
+                    for (const int numChunks : { 2, 8 })
+                    {
+                        std::vector<OnsetList> chunkOnsets;
+                        for (const auto& chunk : planAnalysisChunks(totalSamples, numChunks, getChunkWarmupSamples(sampleRate, params)))
+                            chunkOnsets.push_back(analyseChunk(samples, chunk, sampleRate, params));
+                        const auto stitched = stitchOnsets(chunkOnsets, gapReference.getGapSamples(params));
+
+                        bool samePositions = stitched.size() == single.size();
+                        float worstError = 0.0f;
+                        for (size_t i = 0; samePositions && i < single.size(); ++i)
+                        {
+                            samePositions = stitched[i].samplePosition == single[i].samplePosition;
+                            worstError = std::max(worstError, std::abs(stitched[i].strength - single[i].strength));
+                        }
+
+                        pass.expect(samePositions && worstError <= kChunkStrengthTolerance,
+                                    juce::String(scenario.getName()) + "/focusLow=" + (focusLow ? "on" : "off") + "/lookahead="
+                                        + juce::String(lookaheadMs, 0) + "ms/chunks=" + juce::String(static_cast<int>(chunkOnsets.size())),
+                                    juce::String(static_cast<int>(stitched.size())) + " stitched vs " + juce::String(static_cast<int>(single.size()))
+                                        + " single-pass onsets" + (samePositions ? "" : ", positions differ") + ", worst strength error "
+                                        + juce::String(worstError));
+                    }
+                }
+}
+
+// Checks OnsetCache: its hash against MurmurHash3 x64_128 reference digests and against itself
+// fed in pieces, keys that change with the file's bytes and every detection setting, truncated
+// and foreign entries read as misses and replaced by the next store, least-recently-used
+// eviction in which a hit counts as a use, and concurrent stores of one key.
+void runOnsetCachePass(EvalPass& pass)
+{
+    const auto hashOf = [](const void* data, size_t size)
+    {
+        ContentHash hash;
+        hash.add(data, size);
+        return hash.finish();
+    };
+
+    // Digests from the reference implementation, seed 0; the second input has both tail lengths.
+    const char* hello = "hello";
+    const char* fox = "The quick brown fox jumps over the lazy dog";
+    const bool referenceOk = hashOf("", 0) == std::array<std::uint64_t, 2> { 0, 0 }
+                             && hashOf(hello, std::strlen(hello)) == std::array<std::uint64_t, 2> { 0xcbd8a7b341bd9b02ull, 0x5b1e906a48ae1d19ull }
+                             && hashOf(fox, std::strlen(fox)) == std::array<std::uint64_t, 2> { 0xe34bbc7bbc071b6cull, 0x7a433ca9c49a9347ull };
+    pass.expect(referenceOk, "hash/reference", "digests differ from MurmurHash3 x64_128");
+
+    std::mt19937 rng(3);
+    std::vector<std::uint8_t> bytes(1000);
+    for (auto& byte : bytes)
+        byte = static_cast<std::uint8_t>(rng());
+
+    int splitMismatches = 0;
+    const auto whole = hashOf(bytes.data(), bytes.size());
+    for (int split = 0; split < 50; ++split)
+    {
+        ContentHash hash;
+        std::uniform_int_distribution<size_t> pieceSize(0, static_cast<size_t>(split % 40 + 1));
+        for (size_t position = 0; position < bytes.size();)
+        {
+            const auto size = std::min(pieceSize(rng), bytes.size() - position);
+            hash.add(bytes.data() + position, size);
+            position += size;
+        }
+        splitMismatches += hash.finish() == whole ? 0 : 1;
+    }
+    pass.expect(splitMismatches == 0, "hash/incremental", juce::String(splitMismatches) + " of 50 splits changed the digest");
+
+    const auto folder = juce::File::getSpecialLocation(juce::File::tempDirectory).getNonexistentChildFile("AudioToMidiBeatEvalCache", "", false);
+    folder.createDirectory();
+    const auto audioFile = folder.getChildFile("audio.wav");
+    audioFile.replaceWithData(bytes.data(), bytes.size());
+
+    OnsetCache cache(folder.getChildFile("cache"), 1 << 20);
+    const BeatDetector::Params params;
+    const auto key = cache.makeKey(audioFile, params, 512, 1);
+
+    // Every variation must move the key, and repeating the original must not.
+    std::vector<std::pair<const char*, juce::String>> variants;
+    auto changed = params;
+    changed.sensitivity += 0.5f;
+    variants.emplace_back("sensitivity", cache.makeKey(audioFile, changed, 512, 1));
+    changed = params;
+    changed.minGapMs += 1.0f;
+    variants.emplace_back("minGapMs", cache.makeKey(audioFile, changed, 512, 1));
+    changed = params;
+    changed.focusLow = !changed.focusLow;
+    variants.emplace_back("focusLow", cache.makeKey(audioFile, changed, 512, 1));
+    changed = params;
+    changed.lookaheadMs = kEvalLookaheadMs;
+    variants.emplace_back("lookaheadMs", cache.makeKey(audioFile, changed, 512, 1));
+    variants.emplace_back("blockSize", cache.makeKey(audioFile, params, 256, 1));
+    variants.emplace_back("jobs", cache.makeKey(audioFile, params, 512, 4));
+    bytes[500] ^= 1;
+    audioFile.replaceWithData(bytes.data(), bytes.size());
+    variants.emplace_back("content", cache.makeKey(audioFile, params, 512, 1));
+    bytes[500] ^= 1;
+    audioFile.replaceWithData(bytes.data(), bytes.size());
+
+    juce::String unchangedKeys;
+    for (const auto& [name, variant] : variants)
+        if (variant == key)
+            unchangedKeys << " " << name;
+    pass.expect(key.length() == 32 && cache.makeKey(audioFile, params, 512, 1) == key && unchangedKeys.isEmpty(), "key",
+                unchangedKeys.isEmpty() ? "key " + key : "the key ignores" + unchangedKeys);
+
+    // Corrupt entries: a truncated copy, a foreign file and an entry claiming more onsets than it
+    // holds must all miss, and a store must then replace them.
+    OnsetCache::Entry entry;
+    entry.sampleRate = 48000.0;
+    entry.numSamples = 480000;
+    for (int i = 0; i < 10; ++i)
+        entry.onsets.push_back({ 24000 * i + i, 0.1f * static_cast<float>(i) });
+
+    const auto entryFile = folder.getChildFile("cache").getChildFile(key + ".onsets");
+    const auto sameEntry = [&entry](const OnsetCache::Entry& other)
+    {
+        bool same = other.sampleRate == entry.sampleRate && other.numSamples == entry.numSamples && other.onsets.size() == entry.onsets.size();
+        for (size_t i = 0; same && i < other.onsets.size(); ++i)
+            same = other.onsets[i].samplePosition == entry.onsets[i].samplePosition && other.onsets[i].strength == entry.onsets[i].strength;
+        return same;
+    };
+
+    cache.store(key, entry);
+    juce::MemoryBlock stored;
+    entryFile.loadFileAsData(stored);
+    OnsetCache::Entry read;
+    const bool roundTrip = cache.lookup(key, read) && sameEntry(read);
+
+    std::vector<char> overlong(static_cast<const char*>(stored.getData()), static_cast<const char*>(stored.getData()) + stored.getSize());
+    std::memset(overlong.data() + 24, 0x7f, 4);
+    const std::array<std::pair<const char*, std::vector<char>>, 3> corruptions { {
+        { "truncated", std::vector<char>(static_cast<const char*>(stored.getData()), static_cast<const char*>(stored.getData()) + stored.getSize() - 5) },
+        { "foreign", std::vector<char>(stored.getSize(), 'x') },
+        { "overlong", overlong },
+    } };
+
+    juce::String corruptFailures;
+    for (const auto& [name, contents] : corruptions)
+    {
+        entryFile.replaceWithData(contents.data(), contents.size());
+        OnsetCache::Entry corrupt;
+        const bool missed = !cache.lookup(key, corrupt);
+        cache.store(key, entry);
+        OnsetCache::Entry restored;
+        if (!missed || !cache.lookup(key, restored) || !sameEntry(restored))
+            corruptFailures << " " << name;
+    }
+    pass.expect(roundTrip && corruptFailures.isEmpty(), "corrupt",
+                !roundTrip ? "a stored entry does not read back" : corruptFailures.isEmpty() ? "" : "not replaced:" + corruptFailures);
+
+    // LRU: room for three entries; the oldest is refreshed by a hit, so the next store must evict
+    // the second oldest.
+    {
+        const auto entryBytes = static_cast<juce::int64>(entryFile.getSize());
+        const auto lruFolder = folder.getChildFile("lru");
+        OnsetCache lru(lruFolder, 3 * entryBytes);
+        const std::array<juce::String, 4> keys { "a", "b", "c", "d" };
+        const auto now = juce::Time::getCurrentTime().toMilliseconds();
+        for (size_t i = 0; i < 3; ++i)
+        {
+            lru.store(keys[i], entry);
+            lruFolder.getChildFile(keys[i] + ".onsets").setLastModificationTime(juce::Time(now - 3600000 * static_cast<juce::int64>(4 - i)));
+        }
+
+        OnsetCache::Entry hit;
+        lru.lookup(keys[0], hit);
+        lru.store(keys[3], entry);
+
+        juce::String present;
+        for (const auto& name : keys)
+            if (lruFolder.getChildFile(name + ".onsets").existsAsFile())
+                present << name;
+        pass.expect(present == "acd" && lru.getStatistics().evictions == 1, "lru",
+                    "left " + present + " after " + juce::String(lru.getStatistics().evictions) + " eviction(s), expected acd");
+    }
+
+    // Writers storing different entries under one key while a reader looks it up: every lookup
+    // must find one whole entry, and no temporary file may be left behind.
+    {
+        const auto sharedFolder = folder.getChildFile("shared");
+        OnsetCache shared(sharedFolder, 1 << 20);
+        constexpr int numWriters = 8;
+        std::array<OnsetCache::Entry, numWriters> entries;
+        for (size_t writer = 0; writer < entries.size(); ++writer)
+        {
+            entries[writer] = entry;
+            entries[writer].onsets.resize(entry.onsets.size() * (writer + 1), { static_cast<std::int64_t>(writer), 0.5f });
+        }
+        shared.store(key, entries[0]);
+
+        std::atomic<int> writersLeft { numWriters };
+        std::vector<std::thread> writers;
+        for (size_t writer = 0; writer < entries.size(); ++writer)
+            writers.emplace_back([&, writer]
+            {
+                for (int i = 0; i < 50; ++i)
+                    shared.store(key, entries[writer]);
+                --writersLeft;
+            });
+
+        int lookups = 0;
+        int damaged = 0;
+        while (writersLeft.load() > 0 || lookups == 0)
+        {
+            OnsetCache::Entry result;
+            const bool found = shared.lookup(key, result);
+            damaged += found && std::any_of(entries.begin(), entries.end(), [&result](const OnsetCache::Entry& written)
+                                            { return result.onsets.size() == written.onsets.size()
+                                                     && result.onsets.back().samplePosition == written.onsets.back().samplePosition; })
+                           ? 0
+                           : 1;
+            ++lookups;
+        }
+        for (auto& writer : writers)
+            writer.join();
+
+        const auto numFiles = sharedFolder.findChildFiles(juce::File::findFiles, false, "*").size();
+        pass.expect(damaged == 0 && numFiles == 1, "concurrent",
+                    juce::String(damaged) + " of " + juce::String(lookups) + " lookups missed or read a mixed entry, "
+                        + juce::String(static_cast<int>(numFiles)) + " file(s) left");
+    }
+
+    folder.deleteRecursively();
+}
+
+// Plays steady noise-burst grooves, one of them changing tempo halfway, through BeatDetector and
+// TempoTracker, followed by silence. The tracked tempo must end within 1% of the true one, the
+// clock must start, keep 24 ticks per beat and put its beat ticks near the true onsets, and it
+// must stop once the hits do.
+void runTempoPass(EvalPass& pass)
+{
+    constexpr double sampleRate = 48000.0;
+    constexpr int blockSize = 256;
+    constexpr double silenceSeconds = 10.0;
+
+    struct TempoCase
+    {
+        double firstBpm;
+        double secondBpm;
+    };
+
+    for (const auto& tempoCase : { TempoCase { 95.0, 95.0 }, TempoCase { 128.0, 128.0 }, TempoCase { 170.0, 170.0 }, TempoCase { 100.0, 125.0 } })
+    {
+        std::vector<float> samples;
+        std::vector<std::int64_t> onsets;
+        unsigned int seed = 11;
+        for (const auto bpm : { tempoCase.firstBpm, tempoCase.secondBpm })
+        {
+            // Every part's hits start half a second in, so the previous part is cut one beat
+            // after its last hit minus that, keeping the groove continuous across the change.
+            const auto part = generateSyntheticSignal(makeScenario(SyntheticHit::NoiseBurst, sampleRate, bpm, 24.0, 20.0, seed++));
+            if (!onsets.empty())
+                samples.resize(static_cast<size_t>(onsets.back() + static_cast<std::int64_t>(60.0 / tempoCase.firstBpm * sampleRate)
+                                                   - part.onsets.front()));
+
+            for (const auto onset : part.onsets)
+                onsets.push_back(onset + static_cast<std::int64_t>(samples.size()));
+            samples.insert(samples.end(), part.samples.begin(), part.samples.end());
+        }
+        const auto signalLength = static_cast<std::int64_t>(samples.size());
+        samples.resize(samples.size() + static_cast<size_t>(silenceSeconds * sampleRate), 0.0f);
+
+        BeatDetector detector;
+        TempoTracker tracker;
+        detector.prepare(sampleRate);
+        tracker.prepare(sampleRate);
+
+        BeatDetector::Params params;
+        params.focusLow = false;
+        BeatDetector::TriggerBuffer triggers;
+        juce::MidiBuffer midi;
+        midi.ensureSize(2048);
+
+        std::vector<std::int64_t> ticks;
+        std::int64_t startSample = -1;
+        std::int64_t stopSample = -1;
+        double bpmAtEnd = 0.0;
+
+        const auto total = static_cast<std::int64_t>(samples.size());
+        for (std::int64_t position = 0; position < total; position += blockSize)
+        {
+            const auto numSamples = static_cast<int>(std::min<std::int64_t>(blockSize, total - position));
+            midi.clear();
+            detector.processBlock(samples.data() + position, numSamples, params, triggers);
+            tracker.process(triggers, midi, numSamples, true);
+
+            for (const auto metadata : midi)
+            {
+                const auto message = metadata.getMessage();
+                const auto at = position + metadata.samplePosition;
+                if (message.isMidiClock())
+                    ticks.push_back(at);
+                else if (message.isMidiStart())
+                {
+                    // Beats are counted from the latest start.
+                    startSample = at;
+                    ticks.clear();
+                }
+                else if (message.isMidiStop())
+                    stopSample = at;
+            }
+
+            if (position < signalLength)
+                bpmAtEnd = tracker.getBpm();
+        }
+
+        const double bpmError = std::abs(bpmAtEnd / tempoCase.secondBpm - 1.0);
+
+        // Tick spacing and beat alignment over the last quarter of the groove.
+        double beatLength = 0.0;
+        double worstBeatOffsetMs = 0.0;
+        const auto judgedFrom = signalLength - signalLength / 4;
+        std::vector<std::int64_t> beatTicks;
+        for (size_t i = 0; i < ticks.size(); i += TempoTracker::ticksPerBeat)
+            if (ticks[i] >= judgedFrom && ticks[i] < signalLength)
+                beatTicks.push_back(ticks[i]);
+
+        if (beatTicks.size() > 1)
+            beatLength = static_cast<double>(beatTicks.back() - beatTicks.front()) / static_cast<double>(beatTicks.size() - 1);
+
+        for (const auto tick : beatTicks)
+        {
+            std::int64_t nearest = signalLength;
+            for (const auto onset : onsets)
+                if (std::abs(onset - tick) < std::abs(nearest))
+                    nearest = onset - tick;
+            worstBeatOffsetMs = std::max(worstBeatOffsetMs, std::abs(static_cast<double>(nearest)) * 1000.0 / sampleRate);
+        }
+
+        const double trueBeatLength = 60.0 * sampleRate / tempoCase.secondBpm;
+        pass.expect(bpmError < 0.01 && startSample >= 0 && startSample < judgedFrom && std::abs(beatLength / trueBeatLength - 1.0) < 0.01
+                        && worstBeatOffsetMs < 15.0 && stopSample >= signalLength && !tracker.isClockRunning(),
+                    juce::String(tempoCase.firstBpm, 0) + "->" + juce::String(tempoCase.secondBpm, 0),
+                    "tracked " + juce::String(bpmAtEnd, 2) + " BPM, clock start " + juce::String(static_cast<double>(startSample) / sampleRate, 2)
+                        + " s, beat " + juce::String(beatLength / trueBeatLength * 100.0, 2) + "% of true, worst beat offset "
+                        + juce::String(worstBeatOffsetMs, 1) + " ms, stop " + juce::String(static_cast<double>(stopSample - signalLength) / sampleRate, 2)
+                        + " s after the last hit");
+    }
+}
+
+// Runs hits, near-silence (noise at -120 dBFS), more hits and digital silence through two
+// detectors, one of them given each block's peak so it can skip silent blocks. Triggers must be
+// identical and the envelope and threshold must agree within kSilenceTolerance after every block.
+void runSilencePass(EvalPass& pass)
+{
+    constexpr float kSilenceTolerance = 1.0e-5f;
+
+    for (const auto sampleRate : kEvalSampleRates)
+        for (const bool focusLow : { true, false })
+            for (const auto lookaheadMs : { 0.0f, kEvalLookaheadMs })
+                for (const int blockSize : { 64, 512 })
+                {
+                    const auto hit = focusLow ? SyntheticHit::DecayingSine : SyntheticHit::NoiseBurst;
+                    const auto hits = generateSyntheticSignal(makeScenario(hit, sampleRate, 120.0, 30.0, 2.0, 1)).samples;
+
+                    std::vector<float> samples(hits);
+                    std::mt19937 rng(7);
+                    std::normal_distribution<float> noise(0.0f, 1.0e-6f);
+                    for (int i = 0; i < static_cast<int>(3.0 * sampleRate); ++i)
+                        samples.push_back(noise(rng));
+                    samples.insert(samples.end(), hits.begin(), hits.end());
+                    samples.resize(samples.size() + static_cast<size_t>(2.0 * sampleRate), 0.0f);
+
+                    BeatDetector reference;
+                    BeatDetector skipping;
+                    reference.prepare(sampleRate);
+                    skipping.prepare(sampleRate);
+
+                    BeatDetector::Params params;
+                    params.focusLow = focusLow;
+                    params.lookaheadMs = lookaheadMs;
+                    BeatDetector::TriggerBuffer referenceTriggers;
+                    BeatDetector::TriggerBuffer skippingTriggers;
+
+                    int mismatchedTriggers = 0;
+                    float worstError = 0.0f;
+                    for (size_t position = 0; position + static_cast<size_t>(blockSize) <= samples.size(); position += static_cast<size_t>(blockSize))
+                    {
+                        const float* block = samples.data() + position;
+                        float peak = 0.0f;
+                        for (int i = 0; i < blockSize; ++i)
+                            peak = std::max(peak, std::abs(block[i]));
+
+                        reference.processBlock(block, blockSize, params, referenceTriggers);
+                        skipping.processBlock(block, blockSize, params, skippingTriggers, peak);
+
+                        if (referenceTriggers.count != skippingTriggers.count)
+                            ++mismatchedTriggers;
+                        else
+                            for (int i = 0; i < referenceTriggers.count; ++i)
+                                if (referenceTriggers.events[static_cast<size_t>(i)].sampleOffset != skippingTriggers.events[static_cast<size_t>(i)].sampleOffset)
+                                    ++mismatchedTriggers;
+
+                        worstError = std::max({ worstError, std::abs(referenceTriggers.envelope - skippingTriggers.envelope),
+                                                std::abs(referenceTriggers.threshold - skippingTriggers.threshold) });
+                    }
+
+                    pass.expect(mismatchedTriggers == 0 && worstError < kSilenceTolerance,
+                                "sr=" + juce::String(static_cast<int>(sampleRate)) + "/focusLow=" + (focusLow ? "on" : "off") + "/lookahead="
+                                    + juce::String(lookaheadMs, 0) + "ms/block=" + juce::String(blockSize),
+                                juce::String(mismatchedTriggers) + " mismatched trigger block(s), worst state error " + juce::String(worstError));
+                }
+}
+
+// Runs every hit type through a ThresholdSweep and, for a grid of sensitivities and minimum
+// gaps, through BeatDetector itself. Onset positions and strengths must be identical.
+void runSweepPass(EvalPass& pass)
+{
+    std::vector<float> sensitivities;
+    for (float sensitivity = 0.0f; sensitivity <= 100.0f; sensitivity += 10.0f)
+        sensitivities.push_back(sensitivity);
+
+    for (const auto sampleRate : kEvalSampleRates)
+        for (const bool focusLow : { true, false })
+            for (const auto hit : kEvalHits)
+            {
+                const auto scenario = makeScenario(hit, sampleRate, 180.0, 12.0, 4.0, 1);
+                const auto samples = generateSyntheticSignal(scenario).samples;
+
+                ThresholdSweep sweep;
+                sweep.prepare(sampleRate, focusLow, sensitivities);
+                for (size_t position = 0; position < samples.size(); position += kEvalReferenceBlockSize)
+                    sweep.process(samples.data() + position, static_cast<int>(std::min<size_t>(kEvalReferenceBlockSize, samples.size() - position)));
+
+                int mismatches = 0;
+                for (size_t s = 0; s < sensitivities.size(); ++s)
+                    for (const auto minGapMs : { 50.0f, 120.0f, 300.0f })
+                    {
+                        BeatDetector::Params params;
+                        params.sensitivity = sensitivities[s];
+                        params.minGapMs = minGapMs;
+                        params.focusLow = focusLow;
+
+                        BeatDetector detector;
+                        detector.prepare(sampleRate);
+                        if (!sameOnsets(sweep.getOnsets(s, minGapMs), collectOnsets(detector, samples, kEvalReferenceBlockSize, params)))
+                            ++mismatches;
+                    }
+
+                pass.expect(mismatches == 0, juce::String(scenario.getName()) + "/focusLow=" + (focusLow ? "on" : "off"),
+                            juce::String(mismatches) + " grid point(s) differ from BeatDetector");
+            }
+}
+
+// Same as detectOnsets() for the neural engine, with its layers on the given ISA.
+std::vector<std::int64_t> detectNeuralOnsets(const std::vector<float>& samples, double sampleRate, int blockSize,
+                                             const BeatDetector::Params& params, SimdIsa isa)
+{
+    NeuralOnsetDetector detector;
+    detector.prepare(sampleRate, isa);
+
+    auto detections = getPositions(collectOnsets(detector, samples, blockSize, params));
+    for (auto& position : detections)
+        position -= detector.getLatencySamples();
+    return detections;
+}
+
+// Runs dense material, one hit every 83 ms (16th notes at 180 BPM) so each hit starts over the
+// previous one's decay, through the neural engine and, for comparison, the envelope detector.
+// The neural engine's triggers must not depend on the block size or on the instruction set its
+// layers run on, and its F-measure must reach kMinFMeasure.
+void runNeuralPass(EvalPass& pass)
+{
+    constexpr double kDenseTempoBpm = 720.0;
+    constexpr double kMinFMeasure = 0.9;
+
+    unsigned int seed = 500;
+    for (const auto sampleRate : kEvalSampleRates)
+        for (const auto hit : kEvalHits)
+        {
+            const auto scenario = makeScenario(hit, sampleRate, kDenseTempoBpm, 24.0, 4.0, seed++);
+            const auto signal = generateSyntheticSignal(scenario);
+
+            BeatDetector::Params params;
+            params.focusLow = hit == SyntheticHit::DecayingSine;
+            params.minGapMs = 50.0f;
+
+            const auto neural = detectNeuralOnsets(signal.samples, sampleRate, 64, params, SimdIsa::Scalar);
+            int mismatches = 0;
+            for (const auto isa : { SimdIsa::Sse2, SimdIsa::Avx2, SimdIsa::Neon })
+                if (isSimdIsaSupported(isa) && detectNeuralOnsets(signal.samples, sampleRate, kEvalReferenceBlockSize, params, isa) != neural)
+                    ++mismatches;
+
+            const auto neuralScore = scoreEvalDetections(signal.onsets, neural, sampleRate);
+            const auto envelopeScore = scoreEvalDetections(signal.onsets, detectOnsets(signal.samples, sampleRate, 64, params), sampleRate);
+
+            pass.expect(mismatches == 0 && neuralScore.getFMeasure() >= kMinFMeasure, scenario.getName(),
+                        "neural F " + juce::String(neuralScore.getFMeasure(), 3) + ", mean "
+                            + juce::String(neuralScore.meanLatencySamples * 1000.0 / sampleRate, 2) + " ms | envelope F "
+                            + juce::String(envelopeScore.getFMeasure(), 3) + (mismatches > 0 ? ", ISA/BLOCK-SIZE MISMATCH" : ""));
+        }
+}
+
+// Runs every hit type at every sample rate and noise level through FixedPointBeatDetector and
+// BeatDetector. At 44.1/48 kHz, where neither decimates, every trigger must land within a sample
+// of the float one with a strength within kStrengthTolerance. At every rate the F-measures must
+// agree within kFMeasureTolerance, and the fixed-point triggers must not depend on the block size.
+void runFixedPointPass(EvalPass& pass)
+{
+    constexpr float kStrengthTolerance = 0.01f;
+    constexpr double kFMeasureTolerance = 0.02;
+
+    int comparedTriggers = 0;
+    int samePositionTriggers = 0;
+    float worstStrengthError = 0.0f;
+    unsigned int seed = 700;
+
+    for (const auto hit : kEvalHits)
+        for (const auto sampleRate : kEvalSampleRates)
+            for (const auto snr : kEvalSnrDb)
+            {
+                const auto scenario = makeScenario(hit, sampleRate, 120.0, snr, 4.0, seed++);
+                const auto signal = generateSyntheticSignal(scenario);
+
+                BeatDetector::Params params;
+                params.focusLow = hit == SyntheticHit::DecayingSine;
+
+                BeatDetector floatDetector;
+                FixedPointBeatDetector fixedDetector;
+                floatDetector.prepare(sampleRate);
+                fixedDetector.prepare(sampleRate);
+                const auto expected = collectOnsets(floatDetector, signal.samples, kEvalReferenceBlockSize, params);
+                const auto fixed = collectOnsets(fixedDetector, signal.samples, kEvalReferenceBlockSize, params);
+
+                fixedDetector.reset();
+                const bool blockSizeMatches = sameOnsets(collectOnsets(fixedDetector, signal.samples, 64, params), fixed);
+
+                const bool fullRate = floatDetector.getDecimationFactor() == 1;
+                bool triggersMatch = !fullRate || expected.size() == fixed.size();
+                for (size_t i = 0; fullRate && i < std::min(expected.size(), fixed.size()); ++i)
+                {
+                    const auto strengthError = std::abs(expected[i].strength - fixed[i].strength);
+                    ++comparedTriggers;
+                    samePositionTriggers += expected[i].samplePosition == fixed[i].samplePosition ? 1 : 0;
+                    worstStrengthError = std::max(worstStrengthError, strengthError);
+                    triggersMatch = triggersMatch && std::abs(expected[i].samplePosition - fixed[i].samplePosition) <= 1
+                                    && strengthError <= kStrengthTolerance;
+                }
+
+                const auto floatF = scoreEvalDetections(signal.onsets, getPositions(expected), sampleRate).getFMeasure();
+                const auto fixedF = scoreEvalDetections(signal.onsets, getPositions(fixed), sampleRate).getFMeasure();
+
+                pass.expect(blockSizeMatches && triggersMatch && std::abs(floatF - fixedF) <= kFMeasureTolerance, scenario.getName(),
+                            "F " + juce::String(fixedF, 3) + " vs float " + juce::String(floatF, 3) + (triggersMatch ? "" : ", TRIGGER MISMATCH")
+                                + (blockSizeMatches ? "" : ", BLOCK-SIZE MISMATCH"));
+            }
+
+    pass.summary(juce::String(samePositionTriggers) + "/" + juce::String(comparedTriggers) + " triggers at the float position, worst strength error "
+                 + juce::String(worstStrengthError, 4));
+}
+
+// Runs downmixToMono() on every instruction set this CPU supports and on the scalar kernel, for
+// odd channel counts (one of them null), odd block sizes and blocks that cross the kernel's tile,
+// with input channels and the mono buffer offset so the vector loops start unaligned and end in
+// a scalar tail. Mono output and peak must be bit-identical to the scalar kernel's.
+void runDownmixIsaPass(EvalPass& pass)
+{
+    constexpr int kMaxChannels = 9;
+    constexpr int kMaxBlockSize = 2049;
+    constexpr int kMaxOffset = 3;
+
+    std::mt19937 rng(31);
+    std::uniform_real_distribution<float> sampleDistribution(-1.0f, 1.0f);
+    std::vector<std::vector<float>> storage(kMaxChannels, std::vector<float>(kMaxBlockSize + kMaxOffset));
+    for (auto& channel : storage)
+        for (auto& sample : channel)
+            sample = sampleDistribution(rng);
+
+    std::vector<float> expected(kMaxBlockSize + kMaxOffset);
+    std::vector<float> actual(kMaxBlockSize + kMaxOffset);
+    juce::String isaNames;
+
+    for (const auto isa : { SimdIsa::Sse2, SimdIsa::Avx2, SimdIsa::Neon })
+    {
+        if (!isSimdIsaSupported(isa))
+            continue;
+
+        isaNames << (isaNames.isEmpty() ? "" : ", ") << getSimdIsaName(isa);
+        for (const int numChannels : { 1, 2, 3, 5, 7, kMaxChannels })
+            for (const int blockSize : { 1, 3, 7, 15, 33, 257, 1023, 1025, kMaxBlockSize })
+            {
+                int mismatches = 0;
+                for (int offset = 0; offset <= kMaxOffset; ++offset)
+                {
+                    std::array<const float*, kMaxChannels> channels {};
+                    for (size_t c = 0; c < static_cast<size_t>(numChannels); ++c)
+                        channels[c] = storage[c].data() + offset;
+                    if (numChannels > 2)
+                        channels[1] = nullptr;
+
+                    auto* expectedMono = expected.data() + offset;
+                    auto* actualMono = actual.data() + offset;
+                    const float expectedPeak = downmixToMono(SimdIsa::Scalar, channels.data(), numChannels, expectedMono, blockSize);
+                    const float actualPeak = downmixToMono(isa, channels.data(), numChannels, actualMono, blockSize);
+
+                    if (std::memcmp(&expectedPeak, &actualPeak, sizeof(float)) != 0
+                        || std::memcmp(expectedMono, actualMono, sizeof(float) * static_cast<size_t>(blockSize)) != 0)
+                        ++mismatches;
+                }
+
+                pass.expect(mismatches == 0,
+                            juce::String(getSimdIsaName(isa)) + "/channels=" + juce::String(numChannels) + "/block=" + juce::String(blockSize),
+                            juce::String(mismatches) + " of " + juce::String(kMaxOffset + 1) + " offsets differ from scalar");
+            }
+    }
+
+    pass.summary("compared with scalar: " + (isaNames.isEmpty() ? juce::String("no SIMD instruction set on this CPU") : isaNames));
+}
+
+// A snapshot whose every field is derived from generation, so a reader can tell a torn one.
+ParameterSnapshot makeSnapshot(int generation)
+{
+    const auto level = static_cast<float>(generation % 4096);
+
+    ParameterSnapshot snapshot;
+    snapshot.detector.sensitivity = level;
+    snapshot.detector.minGapMs = level + 1.0f;
+    snapshot.detector.focusLow = generation % 2 == 0;
+    snapshot.detector.lookaheadMs = level + 2.0f;
+    snapshot.midi.noteNumber = generation;
+    snapshot.midi.midiChannel = generation + 1;
+    snapshot.midi.noteLengthMs = generation + 2;
+    snapshot.midi.fixedVelocity = generation + 3;
+    snapshot.multiInput = generation % 2 != 0;
+    for (size_t lane = 0; lane < snapshot.laneNotes.size(); ++lane)
+        snapshot.laneNotes[lane] = generation + static_cast<int>(lane);
+    snapshot.midiClock = generation % 3 == 0;
+    return snapshot;
+}
+
+bool isWholeSnapshot(const ParameterSnapshot& snapshot)
+{
+    const auto expected = makeSnapshot(snapshot.midi.noteNumber);
+    return snapshot.detector.sensitivity == expected.detector.sensitivity && snapshot.detector.minGapMs == expected.detector.minGapMs
+           && snapshot.detector.focusLow == expected.detector.focusLow && snapshot.detector.lookaheadMs == expected.detector.lookaheadMs
+           && snapshot.midi.midiChannel == expected.midi.midiChannel && snapshot.midi.noteLengthMs == expected.midi.noteLengthMs
+           && snapshot.midi.fixedVelocity == expected.midi.fixedVelocity && snapshot.multiInput == expected.multiInput
+           && snapshot.laneNotes == expected.laneNotes && snapshot.midiClock == expected.midiClock;
+}
+
+// A writer thread publishes numbered ParameterSnapshots through a ParameterStore as fast as it
+// can while a reader thread, standing in for the audio thread, reads it in a loop. Every read
+// must be one whole snapshot, generations must never go backwards, and the reader must end on
+// the last one. Build with AUDIOTOMIDI_SANITIZE_THREAD to have ThreadSanitizer check the
+// store's memory ordering as well.
+void runTripleBufferPass(EvalPass& pass)
+{
+    constexpr int kNumWrites = 2000000;
+
+    ParameterStore store(makeSnapshot(0));
+    std::atomic<bool> writerDone { false };
+
+    std::thread writer([&]
+    {
+        for (int generation = 1; generation <= kNumWrites; ++generation)
+            store.write(makeSnapshot(generation));
+        writerDone.store(true, std::memory_order_release);
+    });
+
+    int numReads = 0;
+    int tornReads = 0;
+    int backwardReads = 0;
+    int distinctGenerations = 0;
+    int lastGeneration = 0;
+    for (bool done = false; !done;)
+    {
+        // Once the writer has finished, one more read must see its last snapshot.
+        done = writerDone.load(std::memory_order_acquire);
+
+        const auto& snapshot = store.read();
+        const int generation = snapshot.midi.noteNumber;
+        ++numReads;
+        tornReads += isWholeSnapshot(snapshot) ? 0 : 1;
+        backwardReads += generation < lastGeneration ? 1 : 0;
+        distinctGenerations += generation != lastGeneration ? 1 : 0;
+        lastGeneration = generation;
+    }
+    writer.join();
+
+    pass.expect(tornReads == 0, "whole", juce::String(tornReads) + " of " + juce::String(numReads) + " reads mixed two snapshots");
+    pass.expect(backwardReads == 0, "ordered", juce::String(backwardReads) + " reads went back to an older snapshot");
+    pass.expect(lastGeneration == kNumWrites, "latest", "last read generation " + juce::String(lastGeneration) + " of " + juce::String(kNumWrites));
+    pass.summary(juce::String(numReads) + " reads saw " + juce::String(distinctGenerations) + " of " + juce::String(kNumWrites) + " snapshots");
+}
+
+// A set whose samples each hold one constant level, so the output shows which sample plays.
+std::unique_ptr<DrumSampler::SampleSet> makeLevelSampleSet(const std::vector<std::vector<float>>& levels, int length, double sampleRate)
+{
+    auto set = std::make_unique<DrumSampler::SampleSet>();
+    set->name = "levels";
+    set->sampleRate = sampleRate;
+    for (const auto& layerLevels : levels)
+    {
+        auto& layer = set->layers.emplace_back();
+        for (const auto level : layerLevels)
+        {
+            auto& sample = layer.emplace_back(1, length);
+            juce::FloatVectorOperations::fill(sample.getWritePointer(0), level, length);
+        }
+    }
+    return set;
+}
+
+// Publishes set and runs empty blocks, which keeps the voices playing, until the player has it.
+void publishAndWait(DrumSampler& sampler, std::unique_ptr<DrumSampler::SampleSet> set)
+{
+    BeatDetector::TriggerBuffer none;
+    juce::AudioBuffer<float> scratch(2, 64);
+    sampler.publish(std::move(set));
+    for (int i = 0; i < 500 && sampler.isLoading(); ++i)
+        juce::Thread::sleep(10);
+
+    scratch.clear();
+    sampler.process(none, scratch, 64, {}, 1.0f);
+}
+
+// Plays onsets through sampler in blocks of blockSize and returns the left channel, or an empty
+// vector when the right channel differs from it.
+std::vector<float> renderSampler(DrumSampler& sampler, const OnsetList& onsets, int numSamples, int blockSize, const MidiEngineParams& params)
+{
+    std::vector<float> rendered;
+    juce::AudioBuffer<float> block(2, blockSize);
+    BeatDetector::TriggerBuffer triggers;
+    size_t next = 0;
+    for (int position = 0; position < numSamples; position += blockSize)
+    {
+        const int length = std::min(blockSize, numSamples - position);
+        triggers.count = 0;
+        for (; next < onsets.size() && onsets[next].samplePosition < position + length; ++next)
+            triggers.events[static_cast<size_t>(triggers.count++)] = { static_cast<int>(onsets[next].samplePosition - position), onsets[next].strength };
+
+        block.clear();
+        sampler.process(triggers, block, length, params, 1.0f);
+        for (int i = 0; i < length; ++i)
+        {
+            if (block.getSample(1, i) != block.getSample(0, i))
+                return {};
+            rendered.push_back(block.getSample(0, i));
+        }
+    }
+    return rendered;
+}
+
+// Checks DrumSampler: a folder load that sorts files into velocity layers and resamples them
+// without shifting them, sample-accurate starts at every block size, the velocity layer and
+// round-robin choice, voice stealing, and a set swap while voices play.
+void runSamplerPass(EvalPass& pass)
+{
+    constexpr double kSourceRate = 44100.0;
+    constexpr double kSampleRate = 48000.0;
+    constexpr int kImpulsePosition = 1000;
+    constexpr int kSourceLength = 4000;
+    constexpr int kLevelLength = 300;
+    constexpr float kTolerance = 1.0e-5f;
+
+    // Three impulses at 44.1 kHz: two round-robin samples in layer 1 and one in layer 3.
+    const auto folder = juce::File::getSpecialLocation(juce::File::tempDirectory).getNonexistentChildFile("AudioToMidiBeatEvalSamples", "", false);
+    folder.createDirectory();
+    for (const auto* name : { "snare_v1_a.wav", "snare_v1_b.wav", "snare_v3.wav" })
+    {
+        juce::AudioBuffer<float> impulse(1, kSourceLength);
+        impulse.clear();
+        impulse.setSample(0, kImpulsePosition, 0.5f);
+
+        juce::WavAudioFormat wav;
+        auto stream = std::make_unique<juce::FileOutputStream>(folder.getChildFile(name));
+        std::unique_ptr<juce::AudioFormatWriter> writer(wav.createWriterFor(stream.get(), kSourceRate, 1, 24, {}, 0));
+        if (writer != nullptr)
+        {
+            stream.release();
+            writer->writeFromAudioSampleBuffer(impulse, 0, kSourceLength);
+        }
+    }
+
+    juce::String error;
+    auto loaded = DrumSampler::loadSampleSet(folder, kSampleRate, error);
+    folder.deleteRecursively();
+
+    const bool layered = loaded != nullptr && loaded->layers.size() == 2 && loaded->layers[0].size() == 2 && loaded->layers[1].size() == 1;
+    if (pass.expect(layered, "load", error.isEmpty() ? "folder sorted into layers" : error))
+    {
+        const auto expectedPeak = static_cast<int>(std::lround(kImpulsePosition * kSampleRate / kSourceRate));
+        for (const auto& layer : loaded->layers)
+            for (const auto& sample : layer)
+            {
+                const auto* data = sample.getReadPointer(0);
+                const auto peak = static_cast<int>(std::max_element(data, data + sample.getNumSamples(), [](float a, float b) { return std::abs(a) < std::abs(b); }) - data);
+                pass.expect(std::abs(peak - expectedPeak) <= 1, "load", "resampled impulse at " + juce::String(peak) + ", expected " + juce::String(expectedPeak));
+            }
+    }
+
+    DrumSampler sampler;
+    sampler.prepare(kSampleRate);
+    publishAndWait(sampler, makeLevelSampleSet({ { 0.1f, 0.2f }, { 0.3f } }, kLevelLength, kSampleRate));
+
+    // Dynamic velocity: strength 0 plays velocity 25 (the soft layer), strength 1 velocity 127.
+    MidiEngineParams params;
+    params.velocityMode = VelocityMode::Dynamic;
+    const std::array<std::pair<std::int64_t, float>, 4> spaced { { { 101, 0.0f }, { 1000, 0.0f }, { 2000, 1.0f }, { 3000, 0.0f } } };
+    const std::array<float, 4> expectedLevels { 0.1f * 25.0f / 127.0f, 0.2f * 25.0f / 127.0f, 0.3f, 0.1f * 25.0f / 127.0f };
+
+    // Past the spaced hits, a burst of 40 hits one sample apart outnumbers the voices.
+    OnsetList onsets;
+    for (const auto& [position, strength] : spaced)
+        onsets.push_back({ position, strength });
+    for (int i = 0; i < 40; ++i)
+        onsets.push_back({ 4000 + i, 1.0f });
+
+    constexpr int kRenderLength = 4200;
+    sampler.reset();
+    const auto reference = renderSampler(sampler, onsets, kRenderLength, kEvalReferenceBlockSize, params);
+    pass.expect(!reference.empty(), "mono", "sample on both channels");
+    pass.expect(sampler.getNumActiveVoices() == DrumSampler::maxVoices, "voice stealing", juce::String(sampler.getNumActiveVoices()) + " voices playing");
+
+    if (!reference.empty())
+        for (size_t i = 0; i < spaced.size(); ++i)
+        {
+            const auto position = static_cast<size_t>(spaced[i].first);
+            pass.expect(reference[position - 1] == 0.0f && std::abs(reference[position] - expectedLevels[i]) <= kTolerance,
+                        "hit@" + juce::String(spaced[i].first), "sample-accurate start, velocity layer and round-robin");
+        }
+
+    for (const auto blockSize : kEvalBlockSizes)
+    {
+        sampler.reset();
+        const auto rendered = renderSampler(sampler, onsets, kRenderLength, blockSize, params);
+        bool matches = rendered.size() == reference.size();
+        for (size_t i = 0; matches && i < rendered.size(); ++i)
+            matches = std::abs(rendered[i] - reference[i]) <= kTolerance;
+        pass.expect(matches, "block=" + juce::String(blockSize), "same output as at block " + juce::String(kEvalReferenceBlockSize));
+    }
+
+    // A new set while a voice of the old one plays: the voice plays to its end, new hits use the new set.
+    sampler.reset();
+    const auto beforeSwap = renderSampler(sampler, { { 10, 1.0f } }, 64, 64, params);
+    publishAndWait(sampler, makeLevelSampleSet({ { 0.7f } }, kLevelLength, kSampleRate));
+    const auto afterSwap = renderSampler(sampler, { { 100, 1.0f } }, kLevelLength, 64, params);
+    pass.expect(!beforeSwap.empty() && !afterSwap.empty() && std::abs(afterSwap[0] - 0.3f) <= kTolerance
+                    && std::abs(afterSwap[100] - 1.0f) <= kTolerance && std::abs(afterSwap[kLevelLength - 1] - 0.7f) <= kTolerance,
+                "swap", "set swap while playing");
+}
+} // namespace
+
+//==============================================================================
+DetectionScore scoreEvalDetections(const std::vector<std::int64_t>& truth, const std::vector<std::int64_t>& detections, double sampleRate)
+{
+    const auto toSamples = [sampleRate](double ms) { return static_cast<std::int64_t>(ms * 0.001 * sampleRate); };
+    return scoreDetections(truth, detections, toSamples(kEvalEarlyToleranceMs), toSamples(kEvalLateToleranceMs));
+}
+
+EvalPass::EvalPass(const char* passName, bool printPassing) noexcept
+    : name(passName), printPassingCases(printPassing)
+{
+}
+
+bool EvalPass::expect(bool passed, const juce::String& caseName, const juce::String& detail)
+{
+    ++numChecks;
+    if (!passed)
+        ++numFailures;
+
+    if (!passed || printPassingCases)
+        std::cout << name << "/" << caseName << (detail.isEmpty() ? "" : ": ") << detail << (passed ? "" : "  FAILED") << "\n";
+
+    return passed;
+}
+
+void EvalPass::summary(const juce::String& text) const
+{
+    std::cout << name << ": " << text << "\n";
+}
+
+const std::vector<EvalPassInfo>& getEvalPasses()
+{
+    static const std::vector<EvalPassInfo> passes {
+        { "downmix-isa", false, runDownmixIsaPass },
+        { "detector-bank", false, runDetectorBankPass },
+        { "midi-stress", true, runMidiStressPass },
+        { "automation", true, runAutomationPass },
+        { "tempo", true, runTempoPass },
+        { "silence", false, runSilencePass },
+        { "capture-replay", true, runCaptureReplayPass },
+        { "chunked", false, runChunkedPass },
+        { "onset-cache", false, runOnsetCachePass },
+        { "sweep", false, runSweepPass },
+        { "neural", true, runNeuralPass },
+        { "fixed-point", false, runFixedPointPass },
+        { "sampler", false, runSamplerPass },
+        { "triple-buffer", false, runTripleBufferPass },
+    };
+    return passes;
+}
+
+int runEvalPass(const EvalPassInfo& info)
+{
+    EvalPass pass(info.name, info.printPassingCases);
+    info.run(pass);
+
+    std::cout << info.name << ": "
+              << (pass.getNumFailures() == 0 ? juce::String(pass.getNumChecks()) + " checks pass"
+                                             : juce::String(pass.getNumFailures()) + " of " + juce::String(pass.getNumChecks()) + " checks FAILED")
+              << "\n";
+    return pass.getNumFailures();
+}
+
+} // namespace audiotomidi
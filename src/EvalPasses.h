@@ -0,0 +1,65 @@
+#pragma once
+
+#include <juce_core/juce_core.h>
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include "DetectionEval.h"
+
+namespace audiotomidi {
+
+// The grid and hit window the evaluation's scenarios and passes share. A detection is a hit when
+// it lands between kEvalEarlyToleranceMs before and kEvalLateToleranceMs after a true onset.
+// Every scenario also runs in lookahead mode with kEvalLookaheadMs.
+constexpr std::array<double, 6> kEvalSampleRates { 44100.0, 48000.0, 88200.0, 96000.0, 176400.0, 192000.0 };
+constexpr std::array<int, 8> kEvalBlockSizes { 1, 16, 64, 256, 512, 1024, 4096, 8192 };
+constexpr std::array<double, 3> kEvalSnrDb { 40.0, 24.0, 12.0 };
+constexpr std::array<SyntheticHit, 3> kEvalHits { SyntheticHit::Click, SyntheticHit::DecayingSine, SyntheticHit::NoiseBurst };
+constexpr int kEvalReferenceBlockSize = 512;
+constexpr double kEvalEarlyToleranceMs = 10.0;
+constexpr double kEvalLateToleranceMs = 50.0;
+constexpr float kEvalLookaheadMs = 10.0f;
+
+// scoreDetections() with the evaluation's hit window.
+DetectionScore scoreEvalDetections(const std::vector<std::int64_t>& truth, const std::vector<std::int64_t>& detections, double sampleRate);
+
+// The assertions and report of one AudioToMidiBeatEval pass. Case lines read "pass/case: detail";
+// a failed case is always printed and marked FAILED.
+class EvalPass
+{
+public:
+    EvalPass(const char* name, bool printPassingCases) noexcept;
+
+    // Records one check on caseName. Returns passed.
+    bool expect(bool passed, const juce::String& caseName, const juce::String& detail = {});
+
+    // Prints a line about the pass as a whole, such as an aggregate over its cases.
+    void summary(const juce::String& text) const;
+
+    const char* getName() const noexcept { return name; }
+    int getNumChecks() const noexcept { return numChecks; }
+    int getNumFailures() const noexcept { return numFailures; }
+
+private:
+    const char* name;
+    bool printPassingCases;
+    int numChecks = 0;
+    int numFailures = 0;
+};
+
+struct EvalPassInfo
+{
+    const char* name;
+    bool printPassingCases;
+    void (*run)(EvalPass&);
+};
+
+// Every pass, in the order AudioToMidiBeatEval runs them.
+const std::vector<EvalPassInfo>& getEvalPasses();
+
+// Runs one pass, prints its result line and returns its number of failed checks.
+int runEvalPass(const EvalPassInfo& info);
+
+} // namespace audiotomidi
@@ -0,0 +1,191 @@
+#include "FixedPointDetector.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace audiotomidi {
+
+namespace
+{
+using Q15 = FixedPointBeatDetector::Q15;
+using Q31 = FixedPointBeatDetector::Q31;
+
+constexpr double kPi = 3.14159265358979323846;
+constexpr std::int64_t kQ31One = std::int64_t { 1 } << 31;
+
+// The noise floor's largest rise per sample and BeatDetector::minThreshold, in Q31.
+constexpr Q31 kNoiseRise = static_cast<Q31>(0.08 * static_cast<double>(kQ31One) + 0.5);
+constexpr Q31 kMinThreshold = static_cast<Q31>(static_cast<double>(BeatDetector::minThreshold) * static_cast<double>(kQ31One) + 0.5);
+
+Q31 saturate(std::int64_t x) noexcept
+{
+    return static_cast<Q31>(std::clamp<std::int64_t>(x, std::numeric_limits<Q31>::min(), std::numeric_limits<Q31>::max()));
+}
+
+// y += alpha * (x - y), rounded. alpha is in [0, 1), so y stays between its old value and x.
+Q31 smooth(Q31 y, Q31 alpha, Q31 x) noexcept
+{
+    const auto step = static_cast<std::int64_t>(alpha) * (static_cast<std::int64_t>(x) - y);
+    return static_cast<Q31>(y + ((step + (kQ31One >> 1)) >> 31));
+}
+
+struct Q31PassThrough
+{
+    Q31PassThrough(const FixedPointBeatDetector::Coefficients&, const FixedPointBeatDetector::State&) noexcept {}
+    Q31 process(Q31 x) noexcept { return x; }
+    void store(FixedPointBeatDetector::State&) const noexcept {}
+};
+
+struct Q31OnePoleLowPass
+{
+    Q31OnePoleLowPass(const FixedPointBeatDetector::Coefficients& coefficients, const FixedPointBeatDetector::State& state) noexcept
+        : alpha(coefficients.lowAlpha), lowPassed(state.lowPassed)
+    {
+    }
+
+    Q31 process(Q31 x) noexcept
+    {
+        lowPassed = smooth(lowPassed, alpha, x);
+        return lowPassed;
+    }
+
+    void store(FixedPointBeatDetector::State& state) const noexcept { state.lowPassed = lowPassed; }
+
+    Q31 alpha;
+    Q31 lowPassed;
+};
+} // namespace
+
+FixedPointBeatDetector::Q15 FixedPointBeatDetector::toQ15(float x) noexcept
+{
+    // -32768 is left out so the rectified input always fits in Q31.
+    // Rounds half away from zero; written without a branch or lrint() so the conversion loop vectorizes.
+    const float scaled = std::clamp(x * 32768.0f, -32767.0f, 32767.0f);
+    return static_cast<Q15>(scaled + std::copysign(0.5f, scaled));
+}
+
+FixedPointBeatDetector::Q31 FixedPointBeatDetector::toQ31(double x) noexcept
+{
+    return saturate(std::llround(x * static_cast<double>(kQ31One)));
+}
+
+void FixedPointBeatDetector::prepare(double sr) noexcept
+{
+    sampleRateHz = sr > 0.0 ? sr : 44100.0;
+
+    coefficients.envAlpha = toQ31(1.0 - std::exp(-1.0 / (0.001 * BeatDetector::envelopeTimeMs * sampleRateHz)));
+    coefficients.noiseAlpha = toQ31(1.0 - std::exp(-1.0 / (0.001 * BeatDetector::noiseFloorTimeMs * sampleRateHz)));
+    coefficients.lowAlpha = toQ31(1.0 - std::exp(-2.0 * kPi * BeatDetector::focusLowHz / sampleRateHz));
+    reset();
+}
+
+void FixedPointBeatDetector::reset() noexcept
+{
+    state = {};
+    state.samplesSinceLastTrigger = static_cast<int>(sampleRateHz);
+    lastEnvelope = 0;
+    lastThreshold = 0;
+}
+
+void FixedPointBeatDetector::processBlock(const Q15* monoSamples, int numSamples, const BeatDetector::Params& params,
+                                          BeatDetector::TriggerBuffer& out) noexcept
+{
+    out.count = 0;
+    const Q31 lift = toQ31(BeatDetector::getThresholdLift(params.sensitivity));
+    const int gapSamples = std::max(1, static_cast<int>(params.minGapMs * 0.001f * static_cast<float>(sampleRateHz)));
+
+    if (params.focusLow)
+        processQ15<Q31OnePoleLowPass>(monoSamples, numSamples, 0, lift, gapSamples, out);
+    else
+        processQ15<Q31PassThrough>(monoSamples, numSamples, 0, lift, gapSamples, out);
+
+    if (numSamples > 0)
+    {
+        out.envelope = static_cast<float>(lastEnvelope) / static_cast<float>(kQ31One);
+        out.threshold = static_cast<float>(lastThreshold) / static_cast<float>(kQ31One);
+    }
+}
+
+void FixedPointBeatDetector::processBlock(const float* monoSamples, int numSamples, const BeatDetector::Params& params,
+                                          BeatDetector::TriggerBuffer& out) noexcept
+{
+    out.count = 0;
+    const Q31 lift = toQ31(BeatDetector::getThresholdLift(params.sensitivity));
+    const int gapSamples = std::max(1, static_cast<int>(params.minGapMs * 0.001f * static_cast<float>(sampleRateHz)));
+
+    for (int offset = 0; offset < numSamples; offset += static_cast<int>(conversionBuffer.size()))
+    {
+        const int length = std::min(numSamples - offset, static_cast<int>(conversionBuffer.size()));
+        for (int i = 0; i < length; ++i)
+            conversionBuffer[static_cast<size_t>(i)] = toQ15(monoSamples[offset + i]);
+
+        if (params.focusLow)
+            processQ15<Q31OnePoleLowPass>(conversionBuffer.data(), length, offset, lift, gapSamples, out);
+        else
+            processQ15<Q31PassThrough>(conversionBuffer.data(), length, offset, lift, gapSamples, out);
+    }
+
+    if (numSamples > 0)
+    {
+        out.envelope = static_cast<float>(lastEnvelope) / static_cast<float>(kQ31One);
+        out.threshold = static_cast<float>(lastThreshold) / static_cast<float>(kQ31One);
+    }
+}
+
+// The stages of BeatDetector's EnvelopeDetector, fused the same way: the state lives in locals
+// for the whole block. Triggers are appended to out at offset + their index.
+template <typename Prefilter>
+void FixedPointBeatDetector::processQ15(const Q15* monoSamples, int numSamples, int offset, Q31 lift, int gapSamples,
+                                        BeatDetector::TriggerBuffer& out) noexcept
+{
+    Prefilter prefilter(coefficients, state);
+    const Q31 envAlpha = coefficients.envAlpha;
+    const Q31 noiseAlpha = coefficients.noiseAlpha;
+    Q31 envelope = state.envelope;
+    Q31 noiseFloor = state.noiseFloor;
+    bool wasAbove = state.wasAboveThreshold;
+    int samplesSinceLastTrigger = state.samplesSinceLastTrigger;
+    Q31 threshold = lastThreshold;
+
+    for (int i = 0; i < numSamples; ++i)
+    {
+        const Q31 x = prefilter.process(static_cast<Q31>(monoSamples[i]) * (1 << 16));
+        envelope = smooth(envelope, envAlpha, x < 0 ? -x : x);
+
+        const Q31 noiseTarget = std::min(envelope, saturate(static_cast<std::int64_t>(noiseFloor) + kNoiseRise));
+        noiseFloor = smooth(noiseFloor, noiseAlpha, noiseTarget);
+        threshold = std::max(kMinThreshold, saturate(static_cast<std::int64_t>(noiseFloor) + lift));
+
+        const bool above = envelope >= threshold;
+        samplesSinceLastTrigger = std::min(samplesSinceLastTrigger + 1, 1 << 30);
+        if (!wasAbove && above && samplesSinceLastTrigger >= gapSamples)
+        {
+            samplesSinceLastTrigger = 0;
+            if (out.count < static_cast<int>(out.events.size()))
+            {
+                // (envelope - threshold) * 8, clamped to [0, 1], as Q15.
+                const auto strength = std::clamp<std::int64_t>((static_cast<std::int64_t>(envelope) - threshold) >> 13, 0, 32768);
+                auto& event = out.events[static_cast<size_t>(out.count++)];
+                event = {};
+                event.sampleOffset = offset + i;
+                event.strength = static_cast<float>(strength) / 32768.0f;
+            }
+        }
+        wasAbove = above;
+    }
+
+    if (numSamples > 0)
+    {
+        lastEnvelope = envelope;
+        lastThreshold = threshold;
+    }
+
+    prefilter.store(state);
+    state.envelope = envelope;
+    state.noiseFloor = noiseFloor;
+    state.wasAboveThreshold = wasAbove;
+    state.samplesSinceLastTrigger = samplesSinceLastTrigger;
+}
+
+} // namespace audiotomidi
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+#include "BeatDetector.h"
+
+namespace audiotomidi {
+
+// BeatDetector's envelope engine in integer arithmetic, for targets without a fast FPU. Input is
+// Q15; the low-pass, envelope and noise floor are Q31 one-pole filters whose coefficients are
+// computed once in prepare(). The rectifier, threshold and gap gate use integer compares only,
+// so the per-sample loop runs no floating-point instructions; the parameters are converted once
+// per block, and strengths and the reported envelope and threshold once per trigger or block.
+//
+// Given the same Q15 input, triggers match BeatDetector's to within a sample at 44.1/48 kHz
+// (AudioToMidiBeatEval checks this). The lookahead mode and the decimated high-rate path are not
+// implemented: lookaheadMs is ignored, and at 88.2 kHz and above every stage runs at the full rate.
+class FixedPointBeatDetector
+{
+public:
+    using Q15 = std::int16_t;
+    using Q31 = std::int32_t;
+
+    void prepare(double sampleRate) noexcept;
+    void reset() noexcept;
+
+    // The integer path.
+    void processBlock(const Q15* monoSamples, int numSamples, const BeatDetector::Params& params, BeatDetector::TriggerBuffer& out) noexcept;
+
+    // Converts to Q15 (saturating) in short chunks and runs the integer path.
+    void processBlock(const float* monoSamples, int numSamples, const BeatDetector::Params& params, BeatDetector::TriggerBuffer& out) noexcept;
+
+    static Q15 toQ15(float x) noexcept;
+    static Q31 toQ31(double x) noexcept;
+
+    struct Coefficients
+    {
+        Q31 envAlpha = 0;
+        Q31 noiseAlpha = 0;
+        Q31 lowAlpha = 0;
+    };
+
+    struct State
+    {
+        Q31 lowPassed = 0;
+        Q31 envelope = 0;
+        Q31 noiseFloor = 0;
+        bool wasAboveThreshold = false;
+        int samplesSinceLastTrigger = 0;
+    };
+
+private:
+    template <typename Prefilter>
+    void processQ15(const Q15* monoSamples, int numSamples, int offset, Q31 lift, int gapSamples, BeatDetector::TriggerBuffer& out) noexcept;
+
+    double sampleRateHz = 44100.0;
+    Coefficients coefficients;
+    State state;
+    Q31 lastEnvelope = 0;
+    Q31 lastThreshold = 0;
+
+    std::array<Q15, 256> conversionBuffer {};
+};
+
+} // namespace audiotomidi
@@ -0,0 +1,251 @@
+#include "FlightRecorder.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace audiotomidi {
+
+namespace
+{
+constexpr int kTraceMagic = 0x544d3241; // "A2MT" in file order
+constexpr int kRecordBytes = 32;
+
+// The writer wakes this often; everything older is on disk.
+constexpr int kDrainIntervalMs = 250;
+
+void writeRecord(juce::OutputStream& out, const FlightRecorder::Record& record)
+{
+    out.writeInt64(record.samplePosition);
+    out.writeByte(static_cast<char>(record.kind));
+    out.writeByte(static_cast<char>(record.note));
+    out.writeShort(static_cast<short>(record.reserved));
+    out.writeInt(record.numSamples);
+    out.writeFloat(record.envelope);
+    out.writeFloat(record.noiseFloor);
+    out.writeFloat(record.threshold);
+    out.writeFloat(record.value);
+}
+} // namespace
+
+FlightRecorder::FlightRecorder()
+    : juce::Thread("Flight recorder")
+{
+}
+
+FlightRecorder::~FlightRecorder()
+{
+    stop();
+}
+
+bool FlightRecorder::start(const juce::File& directory, int retainMinutes)
+{
+    if (isRecording())
+        return true;
+
+    if (directory.createDirectory().failed())
+        return false;
+
+    traceFile = directory.getChildFile("trace-" + juce::Time::getCurrentTime().formatted("%Y%m%d-%H%M%S") + ".bin");
+    segmentSeconds = 30.0 * std::max(1, retainMinutes);
+
+    // Left over from a previous recording, or pushed while it was being stopped.
+    discardQueued();
+
+    if (!openSegment())
+        return false;
+
+    recording.store(true, std::memory_order_release);
+    startThread(juce::Thread::Priority::low);
+    return true;
+}
+
+void FlightRecorder::stop()
+{
+    recording.store(false, std::memory_order_release);
+    stopThread(2000);
+    stream = nullptr;
+}
+
+bool FlightRecorder::openSegment()
+{
+    stream = std::make_unique<juce::FileOutputStream>(traceFile);
+    if (!stream->openedOk() || !stream->setPosition(0) || stream->truncate().failed())
+    {
+        stream = nullptr;
+        return false;
+    }
+
+    stream->writeInt(kTraceMagic);
+    stream->writeInt(formatVersion);
+    segmentSamples = 0;
+    return true;
+}
+
+void FlightRecorder::prepare(double sampleRate) noexcept
+{
+    sampleRateHz = sampleRate > 0.0 ? sampleRate : 44100.0;
+    recordIntervalSamples = std::max(1, static_cast<int>(std::lround(sampleRateHz * recordIntervalMs * 0.001)));
+    samplePosition = 0;
+    spanSamples = 0;
+    sessionPending = true;
+}
+
+void FlightRecorder::push(const Record& record) noexcept
+{
+    if (!queue.push(record))
+        dropped.fetch_add(1, std::memory_order_relaxed);
+}
+
+void FlightRecorder::recordBlock(int numSamples, float inputPeak, float noiseFloor, const BeatDetector::TriggerBuffer& triggers) noexcept
+{
+    const auto blockStart = samplePosition;
+    samplePosition += numSamples;
+
+    if (!recording.load(std::memory_order_acquire))
+    {
+        sessionPending = true;
+        return;
+    }
+
+    if (sessionPending)
+    {
+        Record session;
+        session.kind = Record::Kind::Session;
+        session.samplePosition = blockStart;
+        session.value = static_cast<float>(sampleRateHz);
+        push(session);
+
+        sessionPending = false;
+        spanSamples = 0;
+    }
+
+    for (int i = 0; i < triggers.count; ++i)
+    {
+        const auto& event = triggers.events[static_cast<size_t>(i)];
+        Record trigger;
+        trigger.kind = Record::Kind::Trigger;
+        trigger.samplePosition = blockStart + event.sampleOffset;
+        trigger.note = static_cast<std::int8_t>(event.noteNumber);
+        trigger.value = event.strength;
+        push(trigger);
+    }
+
+    if (spanSamples == 0)
+    {
+        spanStart = blockStart;
+        spanPeak = 0.0f;
+    }
+
+    spanSamples += numSamples;
+    spanPeak = std::max(spanPeak, inputPeak);
+    if (spanSamples < recordIntervalSamples)
+        return;
+
+    Record block;
+    block.kind = Record::Kind::Block;
+    block.samplePosition = spanStart;
+    block.numSamples = spanSamples;
+    block.envelope = triggers.envelope;
+    block.noiseFloor = noiseFloor;
+    block.threshold = triggers.threshold;
+    block.value = spanPeak;
+    push(block);
+
+    spanSamples = 0;
+}
+
+void FlightRecorder::discardQueued() noexcept
+{
+    while (queue.front() != nullptr)
+        queue.pop();
+}
+
+void FlightRecorder::drain()
+{
+    if (stream == nullptr)
+    {
+        discardQueued();
+        return;
+    }
+
+    bool wrote = false;
+    while (const auto* next = queue.front())
+    {
+        const auto record = *next;
+        queue.pop();
+
+        if (record.kind == Record::Kind::Session)
+        {
+            segmentSampleRate = static_cast<double>(record.value);
+            nextPosition = record.samplePosition;
+        }
+        else if (record.kind == Record::Kind::Block)
+        {
+            segmentSamples += record.numSamples;
+            nextPosition = record.samplePosition + record.numSamples;
+        }
+
+        writeRecord(*stream, record);
+        wrote = true;
+
+        if (static_cast<double>(segmentSamples) < segmentSeconds * segmentSampleRate)
+            continue;
+
+        // This segment is full: it becomes the previous one, and the new one starts with a
+        // session record so it can be read on its own.
+        stream = nullptr;
+        traceFile.moveFileTo(traceFile.getSiblingFile(traceFile.getFileNameWithoutExtension() + ".prev.bin"));
+        if (!openSegment())
+        {
+            recording.store(false, std::memory_order_release);
+            discardQueued();
+            return;
+        }
+
+        Record session;
+        session.kind = Record::Kind::Session;
+        session.samplePosition = nextPosition;
+        session.value = static_cast<float>(segmentSampleRate);
+        writeRecord(*stream, session);
+    }
+
+    if (wrote)
+        stream->flush();
+}
+
+void FlightRecorder::run()
+{
+    while (!threadShouldExit())
+    {
+        wait(kDrainIntervalMs);
+        drain();
+    }
+
+    drain();
+}
+
+bool FlightRecorder::readTrace(const juce::File& file, std::vector<Record>& records)
+{
+    juce::FileInputStream in(file);
+    if (!in.openedOk() || in.readInt() != kTraceMagic || in.readInt() != formatVersion)
+        return false;
+
+    while (in.getNumBytesRemaining() >= kRecordBytes)
+    {
+        Record record;
+        record.samplePosition = in.readInt64();
+        record.kind = static_cast<Record::Kind>(static_cast<std::uint8_t>(in.readByte()));
+        record.note = static_cast<std::int8_t>(in.readByte());
+        record.reserved = static_cast<std::uint16_t>(in.readShort());
+        record.numSamples = in.readInt();
+        record.envelope = in.readFloat();
+        record.noiseFloor = in.readFloat();
+        record.threshold = in.readFloat();
+        record.value = in.readFloat();
+        records.push_back(record);
+    }
+
+    return true;
+}
+
+} // namespace audiotomidi
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <juce_core/juce_core.h>
+
+#include "BeatDetector.h"
+#include "SpscQueue.h"
+
+namespace audiotomidi {
+
+// Optional recorder of the detector's internals, for analysing false or missed triggers after
+// the fact. The audio thread summarises its blocks every recordIntervalMs (envelope, noise floor
+// and threshold at the end of the span, and the input peak across it) and records every trigger
+// into a preallocated SPSC queue; it never allocates, locks or touches a file, and records that
+// do not fit are counted and dropped. A background thread drains the queue every few hundred
+// milliseconds into a binary trace and flushes it, so everything up to the last drain is on disk
+// if the process dies.
+//
+// To bound the disk use the trace is written in two files: <name>.bin holds the newest audio, and
+// once it covers half of retainMinutes it replaces <name>.prev.bin and a new one is started. The
+// two together always hold at least the last retainMinutes / 2 and at most retainMinutes.
+// AudioToMidiBeatTraceDump converts them to CSV.
+//
+// File format, little-endian: the int32 magic "A2MT" and the int32 format version, then one
+// 32-byte record after another, each field of Record in order. A trace cut off mid-record by a
+// crash reads up to its last complete record.
+class FlightRecorder : private juce::Thread
+{
+public:
+    struct Record
+    {
+        enum class Kind : std::uint8_t
+        {
+            Session = 0, // starts a recording or segment at samplePosition; value is the sample rate
+            Block = 1,
+            Trigger = 2
+        };
+
+        std::int64_t samplePosition = 0;
+        Kind kind = Kind::Block;
+        std::int8_t note = -1;       // Trigger: the note override, -1 for the default note
+        std::uint16_t reserved = 0;
+        std::int32_t numSamples = 0; // Block: samples summarised
+        float envelope = 0.0f;
+        float noiseFloor = 0.0f;     // 0 when the active engine has none
+        float threshold = 0.0f;
+        float value = 0.0f;          // Block: input peak; Trigger: strength; Session: sample rate
+    };
+
+    static constexpr int formatVersion = 1;
+    static constexpr double recordIntervalMs = 5.0;
+
+    FlightRecorder();
+    ~FlightRecorder() override;
+
+    // Message thread. Starts a trace named after the current time in directory; returns false
+    // when the file cannot be created.
+    bool start(const juce::File& directory, int retainMinutes = 10);
+    void stop();
+    bool isRecording() const noexcept { return recording.load(std::memory_order_relaxed); }
+    juce::File getTraceFile() const { return traceFile; }
+
+    // Audio thread, or before the first recordBlock(): sample positions restart at 0.
+    void prepare(double sampleRate) noexcept;
+
+    // Audio thread, once per block after detection. Does nothing while not recording.
+    void recordBlock(int numSamples, float inputPeak, float noiseFloor, const BeatDetector::TriggerBuffer& triggers) noexcept;
+
+    std::uint32_t getNumDropped() const noexcept { return dropped.load(std::memory_order_relaxed); }
+
+    // Appends every record of a trace file; returns false when it is not a readable trace.
+    static bool readTrace(const juce::File& file, std::vector<Record>& records);
+
+private:
+    void run() override;
+    void drain();
+    bool openSegment();
+    void push(const Record& record) noexcept;
+    void discardQueued() noexcept;
+
+    SpscQueue<Record, 4096> queue;
+    std::atomic<bool> recording { false };
+    std::atomic<std::uint32_t> dropped { 0 };
+
+    // Audio thread state.
+    double sampleRateHz = 44100.0;
+    std::int64_t samplePosition = 0;
+    int recordIntervalSamples = 1;
+    std::int64_t spanStart = 0;
+    int spanSamples = 0;
+    float spanPeak = 0.0f;
+    bool sessionPending = true;
+
+    // Writer state: the message thread owns it while the writer thread is stopped.
+    juce::File traceFile;
+    std::unique_ptr<juce::FileOutputStream> stream;
+    double segmentSeconds = 0.0;
+    double segmentSampleRate = 44100.0;
+    std::int64_t segmentSamples = 0;
+    std::int64_t nextPosition = 0;
+
+    JUCE_DECLARE_NON_COPYABLE(FlightRecorder)
+};
+
+} // namespace audiotomidi
@@ -0,0 +1,408 @@
+#include "InputCapture.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace audiotomidi {
+
+namespace
+{
+constexpr std::int32_t kCaptureMagic = 0x434d3241; // "A2MC" in file order
+constexpr std::int32_t kSessionRecord = 1;
+constexpr std::int32_t kBlockRecord = 2;
+constexpr std::int32_t kParametersFlag = 1;
+constexpr std::int32_t kGapFlag = 2;
+
+// Every record is a multiple of 4 bytes long, so samples in a mapped capture stay aligned.
+constexpr size_t kHeaderBytes = 8;
+constexpr size_t kSessionBytes = 4 + 8;
+constexpr size_t kBlockHeaderBytes = 6 * 4;
+constexpr size_t kEventBytes = 8;
+constexpr int kMaxChannels = 64;
+
+constexpr double kHandoverSeconds = 0.25;
+constexpr int kWriteIntervalMs = 20;
+
+template <typename T>
+void put(char*& destination, T value) noexcept
+{
+    std::memcpy(destination, &value, sizeof(T));
+    destination += sizeof(T);
+}
+
+template <typename T>
+T get(const char*& source) noexcept
+{
+    T value;
+    std::memcpy(&value, source, sizeof(T));
+    source += sizeof(T);
+    return value;
+}
+
+std::uint32_t floatBits(float value) noexcept
+{
+    std::uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+float floatFromBits(std::uint32_t bits) noexcept
+{
+    float value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+} // namespace
+
+void InputCapture::packParameters(const ParameterSnapshot& params, std::array<std::uint32_t, numParamValues>& packed) noexcept
+{
+    static_assert(14 + DetectorBank::maxLanes == numParamValues, "one value per snapshot field");
+
+    const auto asWord = [](int value) { return static_cast<std::uint32_t>(value); };
+
+    packed = { floatBits(params.detector.sensitivity),
+               floatBits(params.detector.minGapMs),
+               asWord(params.detector.focusLow ? 1 : 0),
+               floatBits(params.detector.lookaheadMs),
+               asWord(params.midi.noteNumber),
+               asWord(params.midi.midiChannel),
+               asWord(params.midi.noteLengthMs),
+               asWord(static_cast<int>(params.midi.velocityMode)),
+               asWord(params.midi.fixedVelocity),
+               asWord(static_cast<int>(params.midi.retrigger)),
+               asWord(static_cast<int>(params.engine)),
+               asWord(params.multiInput ? 1 : 0),
+               asWord(params.midiClock ? 1 : 0),
+               asWord(params.running ? 1 : 0) };
+
+    for (size_t lane = 0; lane < params.laneNotes.size(); ++lane)
+        packed[14 + lane] = asWord(params.laneNotes[lane]);
+}
+
+ParameterSnapshot InputCapture::unpackParameters(const std::array<std::uint32_t, numParamValues>& packed) noexcept
+{
+    const auto asInt = [&packed](size_t index) { return static_cast<int>(packed[index]); };
+
+    ParameterSnapshot params;
+    params.detector.sensitivity = floatFromBits(packed[0]);
+    params.detector.minGapMs = floatFromBits(packed[1]);
+    params.detector.focusLow = asInt(2) != 0;
+    params.detector.lookaheadMs = floatFromBits(packed[3]);
+    params.midi.noteNumber = asInt(4);
+    params.midi.midiChannel = asInt(5);
+    params.midi.noteLengthMs = asInt(6);
+    params.midi.velocityMode = static_cast<VelocityMode>(asInt(7));
+    params.midi.fixedVelocity = asInt(8);
+    params.midi.retrigger = static_cast<RetriggerPolicy>(asInt(9));
+    params.engine = static_cast<DetectorEngine>(asInt(10));
+    params.multiInput = asInt(11) != 0;
+    params.midiClock = asInt(12) != 0;
+    params.running = asInt(13) != 0;
+
+    for (size_t lane = 0; lane < params.laneNotes.size(); ++lane)
+        params.laneNotes[lane] = asInt(14 + lane);
+
+    return params;
+}
+
+InputCapture::InputCapture()
+    : juce::Thread("Input capture")
+{
+}
+
+InputCapture::~InputCapture()
+{
+    stop();
+}
+
+bool InputCapture::start(const juce::File& directory)
+{
+    if (isCapturing())
+        return true;
+
+    if (directory.createDirectory().failed())
+        return false;
+
+    captureFile = directory.getChildFile("capture-" + juce::Time::getCurrentTime().formatted("%Y%m%d-%H%M%S") + ".bin");
+    stream = std::make_unique<juce::FileOutputStream>(captureFile);
+    if (!stream->openedOk() || !stream->setPosition(0) || stream->truncate().failed())
+    {
+        stream = nullptr;
+        return false;
+    }
+
+    stream->writeInt(kCaptureMagic);
+    stream->writeInt(formatVersion);
+
+    // Allocated on first use and kept, so a stopped capture never frees memory the audio thread
+    // might still be reading.
+    for (auto& buffer : buffers)
+    {
+        if (buffer.data == nullptr)
+            buffer.data.allocate(bufferBytes, false);
+
+        buffer.used = 0;
+        buffer.full.store(false, std::memory_order_relaxed);
+    }
+    nextToWrite = 0;
+
+    capturing.store(true, std::memory_order_release);
+    startThread(juce::Thread::Priority::low);
+    return true;
+}
+
+void InputCapture::stop()
+{
+    // Once the audio thread is seen outside captureBlock() with capturing cleared, it will not
+    // write again, and its last, partly filled buffer can be handed to the writer from here.
+    capturing.store(false);
+    while (audioThreadBusy.load())
+        juce::Thread::yield();
+
+    auto& last = buffers[static_cast<size_t>(active)];
+    if (last.used > 0 && !last.full.load(std::memory_order_acquire))
+        last.full.store(true, std::memory_order_release);
+
+    stopThread(10000);
+    stream = nullptr;
+}
+
+void InputCapture::prepare(double sampleRate) noexcept
+{
+    sampleRateHz = sampleRate > 0.0 ? sampleRate : 44100.0;
+    handoverSamples = std::max(1, static_cast<int>(sampleRateHz * kHandoverSeconds));
+    sessionPending = true;
+}
+
+bool InputCapture::beginBlock() noexcept
+{
+    const bool on = capturing.load(std::memory_order_acquire);
+    const bool starting = on && !inSession;
+    inSession = on;
+
+    if (starting)
+    {
+        active = 0;
+        samplesInActive = 0;
+        sessionPending = true;
+        paramsPending = true;
+        gapPending = false;
+    }
+
+    return starting;
+}
+
+void InputCapture::captureBlock(const float* const* channels, int numChannels, int numSamples, float inputPeak,
+                                const ParameterSnapshot& params, const juce::MidiBuffer& midi, int firstEvent) noexcept
+{
+    if (!inSession)
+        return;
+
+    audioThreadBusy.store(true);
+    if (!capturing.load())
+    {
+        inSession = false;
+        audioThreadBusy.store(false);
+        return;
+    }
+
+    std::array<std::uint32_t, numParamValues> packed;
+    packParameters(params, packed);
+    const bool writeParameters = paramsPending || packed != lastParams;
+    const int numEvents = std::max(0, midi.getNumEvents() - firstEvent);
+
+    const size_t needed = (sessionPending ? kSessionBytes : 0) + kBlockHeaderBytes + (writeParameters ? sizeof(packed) : 0)
+                        + static_cast<size_t>(numChannels) * static_cast<size_t>(numSamples) * sizeof(float)
+                        + static_cast<size_t>(numEvents) * kEventBytes;
+
+    auto* buffer = &buffers[static_cast<size_t>(active)];
+    if (buffer->used > 0 && (buffer->used + needed > bufferBytes || samplesInActive >= handoverSamples))
+    {
+        auto& other = buffers[static_cast<size_t>(1 - active)];
+        if (!other.full.load(std::memory_order_acquire))
+        {
+            buffer->full.store(true, std::memory_order_release);
+            active = 1 - active;
+            other.used = 0;
+            samplesInActive = 0;
+            buffer = &other;
+        }
+    }
+
+    if (buffer->used + needed > bufferBytes)
+    {
+        dropped.fetch_add(1, std::memory_order_relaxed);
+        gapPending = true;
+        audioThreadBusy.store(false);
+        return;
+    }
+
+    char* out = buffer->data + buffer->used;
+    if (sessionPending)
+    {
+        put(out, kSessionRecord);
+        put(out, sampleRateHz);
+        sessionPending = false;
+    }
+
+    put(out, kBlockRecord);
+    put(out, static_cast<std::int32_t>(numSamples));
+    put(out, static_cast<std::int32_t>(numChannels));
+    put(out, inputPeak);
+    put(out, (writeParameters ? kParametersFlag : 0) | (gapPending ? kGapFlag : 0));
+    put(out, static_cast<std::int32_t>(numEvents));
+
+    if (writeParameters)
+    {
+        std::memcpy(out, packed.data(), sizeof(packed));
+        out += sizeof(packed);
+        lastParams = packed;
+        paramsPending = false;
+    }
+
+    const auto channelBytes = static_cast<size_t>(numSamples) * sizeof(float);
+    for (int channel = 0; channel < numChannels; ++channel)
+    {
+        if (channels[channel] != nullptr)
+            std::memcpy(out, channels[channel], channelBytes);
+        else
+            std::memset(out, 0, channelBytes);
+        out += channelBytes;
+    }
+
+    int index = 0;
+    for (const auto metadata : midi)
+    {
+        if (index++ < firstEvent)
+            continue;
+
+        put(out, static_cast<std::int32_t>(metadata.samplePosition));
+        put(out, static_cast<std::uint8_t>(std::min(metadata.numBytes, 255)));
+        for (int i = 0; i < 3; ++i)
+            put(out, i < metadata.numBytes ? metadata.data[i] : std::uint8_t { 0 });
+    }
+
+    buffer->used = static_cast<size_t>(out - buffer->data.get());
+    samplesInActive += numSamples;
+    gapPending = false;
+    audioThreadBusy.store(false);
+}
+
+void InputCapture::writeFullBuffers()
+{
+    bool wrote = false;
+    for (;;)
+    {
+        auto& buffer = buffers[static_cast<size_t>(nextToWrite)];
+        if (!buffer.full.load(std::memory_order_acquire))
+            break;
+
+        if (stream != nullptr)
+            stream->write(buffer.data, buffer.used);
+
+        buffer.full.store(false, std::memory_order_release);
+        nextToWrite = 1 - nextToWrite;
+        wrote = true;
+    }
+
+    if (wrote && stream != nullptr)
+        stream->flush();
+}
+
+void InputCapture::run()
+{
+    while (!threadShouldExit())
+    {
+        wait(kWriteIntervalMs);
+        writeFullBuffers();
+    }
+
+    writeFullBuffers();
+}
+
+//==============================================================================
+InputCapture::Reader::Reader(const juce::File& file)
+    : mapped(std::make_unique<juce::MemoryMappedFile>(file, juce::MemoryMappedFile::readOnly))
+{
+    data = static_cast<const char*>(mapped->getData());
+    size = mapped->getSize();
+    if (data == nullptr || size < kHeaderBytes)
+        return;
+
+    const char* header = data;
+    valid = get<std::int32_t>(header) == kCaptureMagic && get<std::int32_t>(header) == formatVersion;
+    position = kHeaderBytes;
+}
+
+bool InputCapture::Reader::next(Record& record)
+{
+    if (!valid || size - position < 4)
+        return false;
+
+    const size_t remaining = size - position;
+    const char* in = data + position;
+    const auto kind = get<std::int32_t>(in);
+
+    if (kind == kSessionRecord)
+    {
+        if (remaining < kSessionBytes)
+            return false;
+
+        record.kind = Record::Kind::Session;
+        record.sampleRate = get<double>(in);
+        position += kSessionBytes;
+        return true;
+    }
+
+    if (kind != kBlockRecord || remaining < kBlockHeaderBytes)
+        return false;
+
+    const auto numSamples = get<std::int32_t>(in);
+    const auto numChannels = get<std::int32_t>(in);
+    const auto inputPeak = get<float>(in);
+    const auto flags = get<std::int32_t>(in);
+    const auto numEvents = get<std::int32_t>(in);
+    if (numSamples < 0 || numChannels < 1 || numChannels > kMaxChannels || numEvents < 0)
+        return false;
+
+    const size_t parameterBytes = (flags & kParametersFlag) != 0 ? numParamValues * sizeof(std::uint32_t) : 0;
+    const size_t sampleBytes = static_cast<size_t>(numChannels) * static_cast<size_t>(numSamples) * sizeof(float);
+    const size_t recordBytes = kBlockHeaderBytes + parameterBytes + sampleBytes + static_cast<size_t>(numEvents) * kEventBytes;
+    if (remaining < recordBytes)
+        return false;
+
+    if (parameterBytes > 0)
+    {
+        std::array<std::uint32_t, numParamValues> packed;
+        std::memcpy(packed.data(), in, parameterBytes);
+        currentParams = unpackParameters(packed);
+        in += parameterBytes;
+    }
+
+    record.kind = Record::Kind::Block;
+    record.numSamples = numSamples;
+    record.numChannels = numChannels;
+    record.inputPeak = inputPeak;
+    record.gapBefore = (flags & kGapFlag) != 0;
+    record.params = currentParams;
+    record.samples = reinterpret_cast<const float*>(in);
+    record.numEvents = numEvents;
+    record.events = in + sampleBytes;
+
+    position += recordBytes;
+    return true;
+}
+
+InputCapture::Reader::Event InputCapture::Reader::Record::getEvent(int index) const noexcept
+{
+    const char* in = events + static_cast<size_t>(index) * kEventBytes;
+
+    Event event;
+    event.sampleOffset = get<std::int32_t>(in);
+    event.size = get<std::uint8_t>(in);
+    for (auto& byte : event.data)
+        byte = get<std::uint8_t>(in);
+    return event;
+}
+
+} // namespace audiotomidi
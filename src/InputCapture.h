@@ -0,0 +1,154 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+#include <juce_audio_basics/juce_audio_basics.h>
+
+#include "ParameterSnapshot.h"
+
+namespace audiotomidi {
+
+// Streams exactly what the plugin's engine saw to disk: every block's input (the mono downmix,
+// or the raw input channels in multi-input mode), its input peak, the parameter snapshot
+// whenever it changed, and the MIDI the block produced. AudioToMidiBeatReplay feeds a capture
+// back through TriggerEngine with the original block sizes and checks that the MIDI matches.
+//
+// The audio thread appends each block to one of two preallocated buffers and hands it to a
+// writer thread when it is full or holds a quarter of a second of audio; it never allocates,
+// locks or touches a file. A block that finds both buffers in use is dropped and the next one
+// is marked as following a gap.
+//
+// A capture has to start from a state the replay can recreate, so beginBlock() asks the caller
+// to restart its engine on the first captured block (held notes are released first).
+//
+// File format, in native byte order (little-endian on every supported platform): the int32
+// magic "A2MC" and the int32 format version, then records that each start with an int32 kind.
+// A session record (kind 1) holds the float64 sample rate and marks an engine prepare. A block
+// record (kind 2) holds int32 numSamples, int32 numChannels, float32 inputPeak, int32 flags
+// (1: a parameter snapshot follows, 2: blocks were dropped before this one), int32 numEvents,
+// the snapshot as 30 int32/float32 values when flagged, the samples channel after channel, and
+// numEvents MIDI events of int32 sampleOffset, uint8 size and 3 data bytes.
+class InputCapture : private juce::Thread
+{
+public:
+    static constexpr int formatVersion = 1;
+    static constexpr size_t bufferBytes = 4 << 20;
+
+    InputCapture();
+    ~InputCapture() override;
+
+    // Message thread. Starts a capture named after the current time in directory; returns false
+    // when the file cannot be created.
+    bool start(const juce::File& directory);
+    void stop();
+    bool isCapturing() const noexcept { return capturing.load(std::memory_order_relaxed); }
+    juce::File getCaptureFile() const { return captureFile; }
+    std::uint32_t getNumDroppedBlocks() const noexcept { return dropped.load(std::memory_order_relaxed); }
+
+    // Before the first block and whenever the engine is prepared again.
+    void prepare(double sampleRate) noexcept;
+
+    // Audio thread, at the top of every block. Returns true on the first block of a capture, when
+    // the caller must restart its engine before processing the block.
+    bool beginBlock() noexcept;
+
+    // Audio thread, once the block's MIDI is complete. channels are the input the engine read;
+    // midi events before firstEvent (the restart's note-offs) are not part of the block.
+    void captureBlock(const float* const* channels, int numChannels, int numSamples, float inputPeak,
+                      const ParameterSnapshot& params, const juce::MidiBuffer& midi, int firstEvent) noexcept;
+
+    // Memory-maps a capture and walks its records.
+    class Reader
+    {
+    public:
+        explicit Reader(const juce::File& file);
+
+        // False when the file is missing or not a capture.
+        bool openedOk() const noexcept { return valid; }
+
+        struct Event
+        {
+            int sampleOffset = 0;
+            int size = 0;
+            std::array<std::uint8_t, 3> data {};
+        };
+
+        struct Record
+        {
+            enum class Kind
+            {
+                Session,
+                Block
+            };
+
+            Kind kind = Kind::Block;
+            double sampleRate = 0.0;   // Session
+            int numSamples = 0;        // Block fields from here on
+            int numChannels = 0;
+            float inputPeak = 0.0f;
+            bool gapBefore = false;
+            ParameterSnapshot params;  // the latest snapshot, whether or not this block carried one
+            const float* samples = nullptr;
+            int numEvents = 0;
+            const char* events = nullptr;
+
+            const float* getChannel(int channel) const noexcept { return samples + static_cast<size_t>(channel) * static_cast<size_t>(numSamples); }
+            Event getEvent(int index) const noexcept;
+        };
+
+        // Reads the next record; false at the end of the file or of its last complete record.
+        bool next(Record& record);
+
+    private:
+        std::unique_ptr<juce::MemoryMappedFile> mapped;
+        const char* data = nullptr;
+        size_t size = 0;
+        size_t position = 0;
+        bool valid = false;
+        ParameterSnapshot currentParams;
+    };
+
+private:
+    static constexpr int numParamValues = 30;
+
+    struct Buffer
+    {
+        juce::HeapBlock<char> data;
+        size_t used = 0;
+        std::atomic<bool> full { false };
+    };
+
+    static void packParameters(const ParameterSnapshot& params, std::array<std::uint32_t, numParamValues>& packed) noexcept;
+    static ParameterSnapshot unpackParameters(const std::array<std::uint32_t, numParamValues>& packed) noexcept;
+
+    void run() override;
+    void writeFullBuffers();
+
+    std::array<Buffer, 2> buffers;
+    std::atomic<bool> capturing { false };
+    std::atomic<bool> audioThreadBusy { false };
+    std::atomic<std::uint32_t> dropped { 0 };
+
+    // Audio thread state.
+    double sampleRateHz = 44100.0;
+    int handoverSamples = 11025;
+    bool inSession = false;
+    bool sessionPending = true;
+    bool gapPending = false;
+    bool paramsPending = true;
+    std::array<std::uint32_t, numParamValues> lastParams {};
+    int active = 0;
+    int samplesInActive = 0;
+
+    // Writer state: the message thread owns it while the writer thread is stopped.
+    juce::File captureFile;
+    std::unique_ptr<juce::FileOutputStream> stream;
+    int nextToWrite = 0;
+
+    JUCE_DECLARE_NON_COPYABLE(InputCapture)
+};
+
+} // namespace audiotomidi
@@ -0,0 +1,129 @@
+#include "Int8Kernel.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+ #define AUDIOTOMIDI_X86 1
+ #include <immintrin.h>
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(_M_ARM64)
+ #define AUDIOTOMIDI_NEON 1
+ #include <arm_neon.h>
+#endif
+
+#if AUDIOTOMIDI_X86 && (defined(__GNUC__) || defined(__clang__))
+ #define AUDIOTOMIDI_TARGET_SSE2 __attribute__((target("sse2")))
+ #define AUDIOTOMIDI_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+ #define AUDIOTOMIDI_TARGET_SSE2
+ #define AUDIOTOMIDI_TARGET_AVX2
+#endif
+
+namespace audiotomidi {
+
+namespace
+{
+using DotKernel = std::int32_t (*)(const std::int8_t* a, const std::int8_t* b, int n) noexcept;
+
+std::int32_t dotScalar(const std::int8_t* a, const std::int8_t* b, int n) noexcept
+{
+    std::int32_t sum = 0;
+    for (int i = 0; i < n; ++i)
+        sum += static_cast<std::int32_t>(a[i]) * static_cast<std::int32_t>(b[i]);
+    return sum;
+}
+
+#if AUDIOTOMIDI_X86
+// SSE2 has no sign-extending byte load: interleaving a vector with itself and shifting each
+// 16-bit lane right by 8 leaves the sign-extended bytes.
+AUDIOTOMIDI_TARGET_SSE2 std::int32_t dotSse2(const std::int8_t* a, const std::int8_t* b, int n) noexcept
+{
+    auto sum4 = _mm_setzero_si128();
+    for (int i = 0; i < n; i += 16)
+    {
+        const auto va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+        const auto vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+        const auto aLow = _mm_srai_epi16(_mm_unpacklo_epi8(va, va), 8);
+        const auto aHigh = _mm_srai_epi16(_mm_unpackhi_epi8(va, va), 8);
+        const auto bLow = _mm_srai_epi16(_mm_unpacklo_epi8(vb, vb), 8);
+        const auto bHigh = _mm_srai_epi16(_mm_unpackhi_epi8(vb, vb), 8);
+        sum4 = _mm_add_epi32(sum4, _mm_add_epi32(_mm_madd_epi16(aLow, bLow), _mm_madd_epi16(aHigh, bHigh)));
+    }
+
+    sum4 = _mm_add_epi32(sum4, _mm_shuffle_epi32(sum4, _MM_SHUFFLE(1, 0, 3, 2)));
+    sum4 = _mm_add_epi32(sum4, _mm_shuffle_epi32(sum4, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtsi128_si32(sum4);
+}
+
+AUDIOTOMIDI_TARGET_AVX2 std::int32_t dotAvx2(const std::int8_t* a, const std::int8_t* b, int n) noexcept
+{
+    auto sum8 = _mm256_setzero_si256();
+    for (int i = 0; i < n; i += 16)
+    {
+        const auto va = _mm256_cvtepi8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i)));
+        const auto vb = _mm256_cvtepi8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i)));
+        sum8 = _mm256_add_epi32(sum8, _mm256_madd_epi16(va, vb));
+    }
+
+    auto sum4 = _mm_add_epi32(_mm256_castsi256_si128(sum8), _mm256_extracti128_si256(sum8, 1));
+    sum4 = _mm_add_epi32(sum4, _mm_shuffle_epi32(sum4, _MM_SHUFFLE(1, 0, 3, 2)));
+    sum4 = _mm_add_epi32(sum4, _mm_shuffle_epi32(sum4, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtsi128_si32(sum4);
+}
+#endif
+
+#if AUDIOTOMIDI_NEON
+// A product of two values in [-127, 127] fits in int16, so vmull_s8 cannot overflow.
+std::int32_t dotNeon(const std::int8_t* a, const std::int8_t* b, int n) noexcept
+{
+    auto sum4 = vdupq_n_s32(0);
+    for (int i = 0; i < n; i += 16)
+    {
+        const auto va = vld1q_s8(a + i);
+        const auto vb = vld1q_s8(b + i);
+        sum4 = vpadalq_s16(sum4, vmull_s8(vget_low_s8(va), vget_low_s8(vb)));
+        sum4 = vpadalq_s16(sum4, vmull_s8(vget_high_s8(va), vget_high_s8(vb)));
+    }
+
+    const auto sum2 = vadd_s32(vget_low_s32(sum4), vget_high_s32(sum4));
+    return vget_lane_s32(vpadd_s32(sum2, sum2), 0);
+}
+#endif
+
+DotKernel getKernel(SimdIsa isa) noexcept
+{
+    // An instruction set this build has no kernel for runs the scalar one.
+    switch (isa)
+    {
+        case SimdIsa::Scalar: return dotScalar;
+#if AUDIOTOMIDI_X86
+        case SimdIsa::Sse2: return dotSse2;
+        case SimdIsa::Avx2: return dotAvx2;
+#else
+        case SimdIsa::Sse2: return dotScalar;
+        case SimdIsa::Avx2: return dotScalar;
+#endif
+#if AUDIOTOMIDI_NEON
+        case SimdIsa::Neon: return dotNeon;
+#else
+        case SimdIsa::Neon: return dotScalar;
+#endif
+    }
+
+    return dotScalar; // not an enumerator; keeps GCC's -Wreturn-type quiet
+}
+} // namespace
+
+void int8MatVec(SimdIsa isa, const std::int8_t* weights, const std::int8_t* input, int numInputs, int numOutputs, std::int32_t* out) noexcept
+{
+    const auto dot = getKernel(isa);
+    for (int o = 0; o < numOutputs; ++o)
+        out[o] = dot(weights + static_cast<std::ptrdiff_t>(o) * numInputs, input, numInputs);
+}
+
+void int8MatVec(const std::int8_t* weights, const std::int8_t* input, int numInputs, int numOutputs, std::int32_t* out) noexcept
+{
+    static const SimdIsa bestIsa = getBestSimdIsa();
+    int8MatVec(bestIsa, weights, input, numInputs, numOutputs, out);
+}
+
+} // namespace audiotomidi
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstdint>
+
+#include "DownmixKernel.h"
+
+namespace audiotomidi {
+
+// Integer matrix-vector product for int8-quantized network layers:
+//     out[o] = sum over i of weights[o * numInputs + i] * input[i]
+// accumulated exactly in int32, so every ISA returns identical results. numInputs must be a
+// multiple of 16 and values must lie in [-127, 127]; the products of one output then fit in
+// int32 for any numInputs below 2^17.
+void int8MatVec(const std::int8_t* weights, const std::int8_t* input, int numInputs, int numOutputs, std::int32_t* out) noexcept;
+
+// Same as above with an explicit instruction set; isa must be supported on this CPU.
+void int8MatVec(SimdIsa isa, const std::int8_t* weights, const std::int8_t* input, int numInputs, int numOutputs, std::int32_t* out) noexcept;
+
+} // namespace audiotomidi
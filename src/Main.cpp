@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <array>
 #include <memory>
 
@@ -5,7 +6,14 @@
 #include <juce_gui_extra/juce_gui_extra.h>
 
 #include "BeatDetector.h"
+#include "CallbackTelemetry.h"
+#include "DownmixKernel.h"
+#include "FlightRecorder.h"
+#include "MidiDispatcher.h"
 #include "MidiEngine.h"
+#include "ParameterSnapshot.h"
+#include "TelemetryView.h"
+#include "TempoTracker.h"
 
 namespace
 {
@@ -56,6 +64,76 @@ private:
     int frames = 0;
 };
 
+// Shows the dispatcher's send and callback-period jitter histograms, with reset and CSV export.
+class TimingView : public juce::Component
+{
+public:
+    explicit TimingView(audiotomidi::MidiDispatcher& dispatcherToShow)
+        : dispatcher(dispatcherToShow)
+    {
+        resetButton.setButtonText("Reset");
+        resetButton.onClick = [this]
+        {
+            dispatcher.getSendJitter().reset();
+            dispatcher.getCallbackJitter().reset();
+            repaint();
+        };
+        addAndMakeVisible(resetButton);
+
+        exportButton.setButtonText("Export CSV");
+        exportButton.onClick = [this] { exportCsv(); };
+        addAndMakeVisible(exportButton);
+    }
+
+    void resized() override
+    {
+        auto buttons = getLocalBounds().removeFromRight(110).removeFromTop(60);
+        resetButton.setBounds(buttons.removeFromTop(30).reduced(2));
+        exportButton.setBounds(buttons.reduced(2));
+    }
+
+    void paint(juce::Graphics& g) override
+    {
+        auto area = getLocalBounds().withTrimmedRight(110);
+        const auto clockText = juce::String("Clock: ") + (dispatcher.isUsingHostTime() ? "device host time" : "callback entry time")
+                             + "   Send delay: " + juce::String(audiotomidi::MidiDispatcher::getSendDelayMs(), 1) + " ms"
+                             + "   Dropped: " + juce::String(static_cast<int>(dispatcher.getNumDropped()));
+        g.setColour(juce::Colours::white);
+        g.setFont(13.0f);
+        g.drawText(clockText, area.removeFromTop(18), juce::Justification::centredLeft);
+
+        auto left = area.removeFromLeft(area.getWidth() / 2).reduced(4, 2);
+        audiotomidi::drawTimingHistogram(g, left, "Send jitter", dispatcher.getSendJitter(), true);
+        audiotomidi::drawTimingHistogram(g, area.reduced(4, 2), "Callback period jitter", dispatcher.getCallbackJitter(), true);
+    }
+
+private:
+    void exportCsv()
+    {
+        chooser = std::make_unique<juce::FileChooser>("Export timing histograms",
+                                                      juce::File::getSpecialLocation(juce::File::userDocumentsDirectory).getChildFile("AudioToMidiBeatTiming.csv"),
+                                                      "*.csv");
+        chooser->launchAsync(juce::FileBrowserComponent::saveMode | juce::FileBrowserComponent::canSelectFiles
+                                 | juce::FileBrowserComponent::warnAboutOverwriting,
+                             [this](const juce::FileChooser& fc)
+                             {
+                                 const auto file = fc.getResult();
+                                 if (file == juce::File())
+                                     return;
+
+                                 const auto csv = "histogram,bin_start_ms,bin_end_ms,count\n"
+                                                + dispatcher.getSendJitter().toCsvRows("send_jitter")
+                                                + dispatcher.getCallbackJitter().toCsvRows("callback_period_jitter");
+                                 file.replaceWithText(csv);
+                             });
+    }
+
+    audiotomidi::MidiDispatcher& dispatcher;
+    juce::TextButton resetButton;
+    juce::TextButton exportButton;
+    std::unique_ptr<juce::FileChooser> chooser;
+};
+
 class StandaloneMainComponent : public juce::Component,
                                 private juce::AudioIODeviceCallback,
                                 private juce::ComboBox::Listener,
@@ -73,7 +151,7 @@ public:
                         false,
                         false)
     {
-        setSize(900, 640);
+        setSize(900, 960);
 
         juce::PropertiesFile::Options options;
         options.applicationName = "AudioToMidiBeat";
@@ -92,7 +170,6 @@ public:
             if (stateXml != nullptr)
                 deviceManager.initialise(2, 0, stateXml.get(), true);
         }
-        deviceManager.addAudioCallback(this);
 
         addAndMakeVisible(audioSelector);
 
@@ -107,6 +184,7 @@ public:
         {
             running = !running;
             startStopButton.setButtonText(running ? "Stop" : "Start");
+            publishParameters();
         };
         addAndMakeVisible(startStopButton);
 
@@ -121,6 +199,14 @@ public:
         addAndMakeVisible(triggerLabel);
         triggerLabel.setText("Trigger", juce::dontSendNotification);
         addAndMakeVisible(triggerLed);
+        addAndMakeVisible(timingView);
+
+        telemetryView.getDeviceXRuns = [this]
+        {
+            auto* device = deviceManager.getCurrentAudioDevice();
+            return device != nullptr ? device->getXRunCount() : -1;
+        };
+        addAndMakeVisible(telemetryView);
 
         auto addSlider = [this](juce::Slider& slider, juce::Label& label, const juce::String& text, double min, double max, double step, double val)
         {
@@ -128,6 +214,7 @@ public:
             slider.setValue(val);
             slider.setSliderStyle(juce::Slider::RotaryHorizontalVerticalDrag);
             slider.setTextBoxStyle(juce::Slider::TextBoxBelow, false, 64, 20);
+            slider.onValueChange = [this] { publishParameters(); };
             label.setText(text, juce::dontSendNotification);
             label.setJustificationType(juce::Justification::centred);
             addAndMakeVisible(slider);
@@ -144,12 +231,39 @@ public:
         velocityModeBox.addItem("Fixed", 1);
         velocityModeBox.addItem("Dynamic", 2);
         velocityModeBox.setSelectedId(settings.velocityModeId);
+        velocityModeBox.onChange = [this] { publishParameters(); };
         addAndMakeVisible(velocityModeBox);
 
+        retriggerBox.addItem("Retrigger: Layer", 1);
+        retriggerBox.addItem("Retrigger: Cut", 2);
+        retriggerBox.addItem("Retrigger: Extend", 3);
+        retriggerBox.setSelectedId(settings.retriggerId);
+        retriggerBox.onChange = [this] { publishParameters(); };
+        addAndMakeVisible(retriggerBox);
+
         focusLowToggle.setButtonText("FocusLow");
         focusLowToggle.setToggleState(settings.focusLow, juce::dontSendNotification);
+        focusLowToggle.onClick = [this] { publishParameters(); };
         addAndMakeVisible(focusLowToggle);
 
+        midiClockToggle.setButtonText("MIDI Clock");
+        midiClockToggle.setToggleState(settings.midiClock, juce::dontSendNotification);
+        midiClockToggle.onClick = [this] { publishParameters(); };
+        addAndMakeVisible(midiClockToggle);
+
+        traceButton.setButtonText("Record Trace");
+        traceButton.onClick = [this]
+        {
+            if (flightRecorder.isRecording())
+                flightRecorder.stop();
+            else
+                flightRecorder.start(juce::File::getSpecialLocation(juce::File::userDocumentsDirectory).getChildFile("AudioToMidiBeat").getChildFile("Traces"));
+        };
+        addAndMakeVisible(traceButton);
+
+        tempoLabel.setText("Tempo: -", juce::dontSendNotification);
+        addAndMakeVisible(tempoLabel);
+
         refreshDevices();
         if (settings.running == false)
         {
@@ -157,6 +271,10 @@ public:
             startStopButton.setButtonText("Start");
         }
 
+        // The audio thread only ever sees published snapshots, so publish before it starts.
+        publishParameters();
+        deviceManager.addAudioCallback(this);
+
         startTimerHz(30);
     }
 
@@ -166,7 +284,7 @@ public:
             saveSettings(*storage);
 
         deviceManager.removeAudioCallback(this);
-        midiOutput.reset();
+        midiDispatcher.setOutput(nullptr);
     }
 
     void resized() override
@@ -199,7 +317,14 @@ public:
 
         auto toggles = area.removeFromTop(40);
         velocityModeBox.setBounds(toggles.removeFromLeft(160).reduced(2));
+        retriggerBox.setBounds(toggles.removeFromLeft(170).reduced(2));
         focusLowToggle.setBounds(toggles.removeFromLeft(130).reduced(2));
+        midiClockToggle.setBounds(toggles.removeFromLeft(120).reduced(2));
+        traceButton.setBounds(toggles.removeFromRight(120).reduced(2));
+        tempoLabel.setBounds(toggles.reduced(2));
+
+        timingView.setBounds(area.removeFromTop(150).reduced(2));
+        telemetryView.setBounds(area.removeFromTop(160).reduced(2));
 
         audioSelector.setBounds(area.reduced(2));
     }
@@ -212,16 +337,21 @@ private:
 
         detector.prepare(sr);
         midiEngine.prepare(sr);
+        tempoTracker.prepare(sr);
+        midiDispatcher.prepare(sr);
+        telemetry.prepare(sr);
+        flightRecorder.prepare(sr);
+        midiBuffer.ensureSize(2048);
 
         monoBuffer.allocate(static_cast<size_t>(maxBlock), true);
         monoBufferSize = maxBlock;
-        currentSampleRate = sr;
     }
 
     void audioDeviceStopped() override
     {
         detector.reset();
         midiEngine.reset();
+        tempoTracker.reset();
     }
 
     void audioDeviceIOCallbackWithContext(const float* const* inputChannelData,
@@ -229,9 +359,10 @@ private:
                                           float* const* outputChannelData,
                                           int numOutputChannels,
                                           int numSamples,
-                                          const juce::AudioIODeviceCallbackContext&) override
+                                          const juce::AudioIODeviceCallbackContext& context) override
     {
         juce::ignoreUnused(outputChannelData, numOutputChannels);
+        telemetry.beginCallback();
 
         if (numSamples > monoBufferSize)
         {
@@ -239,49 +370,41 @@ private:
             monoBufferSize = numSamples;
         }
 
-        float peak = 0.0f;
-        for (int s = 0; s < numSamples; ++s)
-        {
-            float mono = 0.0f;
-            for (int ch = 0; ch < numInputChannels; ++ch)
-            {
-                const auto* in = inputChannelData[ch];
-                mono += in != nullptr ? in[s] : 0.0f;
-            }
-
-            mono *= (numInputChannels > 0 ? 1.0f / static_cast<float>(numInputChannels) : 1.0f);
-            monoBuffer[s] = mono;
-            peak = std::max(peak, std::abs(mono));
-        }
+        const float peak = audiotomidi::downmixToMono(inputChannelData, numInputChannels, monoBuffer.get(), numSamples);
 
         levelAtomic.store(peak, std::memory_order_relaxed);
 
-        if (!running)
-            return;
-
-        audiotomidi::BeatDetector::Params detParams;
-        detParams.sensitivity = static_cast<float>(sensitivitySlider.getValue());
-        detParams.minGapMs = static_cast<float>(minGapSlider.getValue());
-        detParams.focusLow = focusLowToggle.getToggleState();
+        midiBuffer.clear();
+        telemetry.endStage(audiotomidi::CallbackTelemetry::Stage::Downmix);
 
+        // Stopped blocks still go to the dispatcher so its clock model stays locked, and to the
+        // tempo tracker so a running MIDI clock is stopped.
+        const auto& params = parameterStore.read();
         audiotomidi::BeatDetector::TriggerBuffer triggers;
-        detector.processBlock(monoBuffer.get(), numSamples, detParams, triggers);
+        if (!params.running)
+        {
+            tempoTracker.process(triggers, midiBuffer, numSamples, false);
+            midiDispatcher.pushBlock(midiBuffer, numSamples, context);
+            telemetry.endCallback(numSamples);
+            return;
+        }
+
+        detector.processBlock(monoBuffer.get(), numSamples, params.detector, triggers, peak);
+        telemetry.endStage(audiotomidi::CallbackTelemetry::Stage::Detection);
+        flightRecorder.recordBlock(numSamples, peak, detector.getNoiseFloor(), triggers);
 
         if (triggers.count > 0)
             triggerAtomic.store(true, std::memory_order_relaxed);
 
-        audiotomidi::MidiEngineParams midiParams;
-        midiParams.noteNumber = static_cast<int>(noteSlider.getValue());
-        midiParams.midiChannel = static_cast<int>(channelSlider.getValue());
-        midiParams.noteLengthMs = static_cast<int>(noteLenSlider.getValue());
-        midiParams.velocityMode = velocityModeBox.getSelectedId() == 1 ? audiotomidi::VelocityMode::Fixed : audiotomidi::VelocityMode::Dynamic;
-        midiParams.fixedVelocity = static_cast<int>(velocitySlider.getValue());
+        midiEngine.process(triggers, midiBuffer, numSamples, params.midi);
+        tempoTracker.process(triggers, midiBuffer, numSamples, params.midiClock);
+        midiDispatcher.pushBlock(midiBuffer, numSamples, context);
 
-        juce::MidiBuffer midi;
-        midiEngine.process(triggers, midi, numSamples, midiParams);
+        tempoBpmAtomic.store(static_cast<float>(tempoTracker.getBpm()), std::memory_order_relaxed);
+        tempoConfidenceAtomic.store(tempoTracker.getConfidence(), std::memory_order_relaxed);
 
-        if (midiOutput != nullptr && !midi.isEmpty())
-            midiOutput->sendBlockOfMessages(midi, juce::Time::getMillisecondCounterHiRes(), currentSampleRate);
+        telemetry.endStage(audiotomidi::CallbackTelemetry::Stage::Midi);
+        telemetry.endCallback(numSamples);
     }
 
     void comboBoxChanged(juce::ComboBox* comboBoxThatHasChanged) override
@@ -294,6 +417,36 @@ private:
     {
         levelMeter.setLevel(levelAtomic.load(std::memory_order_relaxed));
         triggerLed.setTriggered(triggerAtomic.exchange(false, std::memory_order_relaxed));
+        timingView.repaint();
+        telemetryView.repaint();
+
+        traceButton.setButtonText(flightRecorder.isRecording() ? "Stop Trace" : "Record Trace");
+        traceButton.setTooltip(flightRecorder.isRecording() ? flightRecorder.getTraceFile().getFullPathName() : juce::String());
+
+        const auto bpm = tempoBpmAtomic.load(std::memory_order_relaxed);
+        tempoLabel.setText(bpm > 0.0f ? "Tempo: " + juce::String(bpm, 1) + " BPM ("
+                                            + juce::String(juce::roundToInt(tempoConfidenceAtomic.load(std::memory_order_relaxed) * 100.0f)) + "%)"
+                                      : juce::String("Tempo: -"),
+                           juce::dontSendNotification);
+    }
+
+    // Message thread only: the controls are read here and nowhere else.
+    void publishParameters()
+    {
+        audiotomidi::ParameterSnapshot snapshot;
+        snapshot.detector.sensitivity = static_cast<float>(sensitivitySlider.getValue());
+        snapshot.detector.minGapMs = static_cast<float>(minGapSlider.getValue());
+        snapshot.detector.focusLow = focusLowToggle.getToggleState();
+        snapshot.midi.noteNumber = static_cast<int>(noteSlider.getValue());
+        snapshot.midi.midiChannel = static_cast<int>(channelSlider.getValue());
+        snapshot.midi.noteLengthMs = static_cast<int>(noteLenSlider.getValue());
+        snapshot.midi.velocityMode = velocityModeBox.getSelectedId() == 1 ? audiotomidi::VelocityMode::Fixed : audiotomidi::VelocityMode::Dynamic;
+        snapshot.midi.fixedVelocity = static_cast<int>(velocitySlider.getValue());
+        snapshot.midi.retrigger = static_cast<audiotomidi::RetriggerPolicy>(std::max(0, retriggerBox.getSelectedId() - 1));
+        snapshot.midiClock = midiClockToggle.getToggleState();
+        snapshot.running = running;
+
+        parameterStore.write(snapshot);
     }
 
     void refreshDevices()
@@ -318,7 +471,7 @@ private:
 
     void openSelectedMidiDevice()
     {
-        midiOutput.reset();
+        midiDispatcher.setOutput(nullptr);
         const auto idx = midiOutputBox.getSelectedItemIndex();
         if (idx < 0)
             return;
@@ -327,7 +480,7 @@ private:
         if (idx >= static_cast<int>(devices.size()))
             return;
 
-        midiOutput = juce::MidiOutput::openDevice(devices[static_cast<size_t>(idx)].identifier);
+        midiDispatcher.setOutput(juce::MidiOutput::openDevice(devices[static_cast<size_t>(idx)].identifier));
     }
 
     void restoreSettings(juce::PropertiesFile& props)
@@ -341,7 +494,9 @@ private:
         settings.noteLengthMs = props.getIntValue("noteLengthMs", 30);
         settings.fixedVelocity = props.getIntValue("fixedVelocity", 100);
         settings.velocityModeId = props.getIntValue("velocityModeId", 1);
+        settings.retriggerId = props.getIntValue("retriggerId", 1);
         settings.focusLow = props.getBoolValue("focusLow", true);
+        settings.midiClock = props.getBoolValue("midiClock", false);
         settings.running = props.getBoolValue("running", true);
     }
 
@@ -358,7 +513,9 @@ private:
         props.setValue("noteLengthMs", static_cast<int>(noteLenSlider.getValue()));
         props.setValue("fixedVelocity", static_cast<int>(velocitySlider.getValue()));
         props.setValue("velocityModeId", velocityModeBox.getSelectedId());
+        props.setValue("retriggerId", retriggerBox.getSelectedId());
         props.setValue("focusLow", focusLowToggle.getToggleState());
+        props.setValue("midiClock", midiClockToggle.getToggleState());
         props.setValue("running", running);
         props.saveIfNeeded();
     }
@@ -374,7 +531,9 @@ private:
         int noteLengthMs = 30;
         int fixedVelocity = 100;
         int velocityModeId = 1;
+        int retriggerId = 1;
         bool focusLow = true;
+        bool midiClock = false;
         bool running = true;
     } settings;
 
@@ -394,18 +553,31 @@ private:
     juce::Slider sensitivitySlider, minGapSlider, noteSlider, channelSlider, noteLenSlider, velocitySlider;
     juce::Label sensitivityLabel, minGapLabel, noteLabel, channelLabel, noteLenLabel, velocityLabel;
     juce::ComboBox velocityModeBox;
+    juce::ComboBox retriggerBox;
     juce::ToggleButton focusLowToggle;
+    juce::ToggleButton midiClockToggle;
+    juce::TextButton traceButton;
+    juce::Label tempoLabel;
 
     juce::HeapBlock<float> monoBuffer;
     int monoBufferSize = 0;
-    double currentSampleRate = 44100.0;
 
     audiotomidi::BeatDetector detector;
     audiotomidi::MidiEngine midiEngine;
-    std::unique_ptr<juce::MidiOutput> midiOutput;
+    audiotomidi::TempoTracker tempoTracker;
+    juce::MidiBuffer midiBuffer;
+    audiotomidi::MidiDispatcher midiDispatcher;
+    TimingView timingView { midiDispatcher };
+    audiotomidi::CallbackTelemetry telemetry;
+    audiotomidi::TelemetryView telemetryView { telemetry };
+    audiotomidi::FlightRecorder flightRecorder;
+
+    audiotomidi::ParameterStore parameterStore;
 
     std::atomic<float> levelAtomic { 0.0f };
     std::atomic<bool> triggerAtomic { false };
+    std::atomic<float> tempoBpmAtomic { 0.0f };
+    std::atomic<float> tempoConfidenceAtomic { 0.0f };
 
     bool running = true;
 
@@ -0,0 +1,148 @@
+#include "MidiDispatcher.h"
+
+#include <algorithm>
+
+namespace audiotomidi {
+
+namespace
+{
+// Messages go out this long after their sample's modelled time. It has to cover the callback's
+// own processing plus the scheduling noise the clock model filters out; anything pushed later
+// than that is sent at once and shows up in the send jitter histogram.
+constexpr double kSendDelayMs = 2.0;
+
+// A message further in the future than this belongs to a clock that has since been restarted.
+constexpr double kMaxScheduleAheadMs = 500.0;
+
+// The host clock and the ms counter may drift apart slowly; let the offset estimate rise by this
+// much per block so it can follow.
+constexpr double kHostOffsetDriftMsPerBlock = 0.0005;
+} // namespace
+
+MidiDispatcher::MidiDispatcher()
+    : juce::Thread("MIDI dispatch")
+{
+    startThread(juce::Thread::Priority::highest);
+}
+
+MidiDispatcher::~MidiDispatcher()
+{
+    stopThread(1000);
+}
+
+double MidiDispatcher::getSendDelayMs() noexcept
+{
+    return kSendDelayMs;
+}
+
+void MidiDispatcher::prepare(double sampleRate) noexcept
+{
+    sampleRateHz = sampleRate > 0.0 ? sampleRate : 44100.0;
+    sampleClock.prepare(sampleRateHz);
+    samplesPushed = 0;
+    previousNumSamples = 0;
+    hostOffsetValid = false;
+    clock.write({ 0, juce::Time::getMillisecondCounterHiRes(), 1000.0 / sampleRateHz });
+}
+
+void MidiDispatcher::setOutput(std::unique_ptr<juce::MidiOutput> newOutput)
+{
+    const juce::ScopedLock sl(outputLock);
+    output = std::move(newOutput);
+}
+
+double MidiDispatcher::observeBlockTime(double entryMs, int numSamples, const juce::AudioIODeviceCallbackContext& context) noexcept
+{
+    if (previousNumSamples > 0)
+        callbackJitter.record(entryMs - previousEntryMs - 1000.0 * previousNumSamples / sampleRateHz);
+
+    previousEntryMs = entryMs;
+    previousNumSamples = numSamples;
+
+    const bool hasHostTime = context.hostTimeNs != nullptr;
+    usingHostTime.store(hasHostTime, std::memory_order_relaxed);
+    if (!hasHostTime)
+        return entryMs;
+
+    // The host timestamp marks the block at the device and is on its own clock. The callback can
+    // never start earlier than a fixed offset after it, so the smallest entry-minus-host
+    // difference seen maps host time onto the ms counter without the callback's jitter.
+    const double hostMs = static_cast<double>(*context.hostTimeNs) * 1.0e-6;
+    const double difference = entryMs - hostMs;
+    hostOffsetMs = hostOffsetValid ? std::min(difference, hostOffsetMs + kHostOffsetDriftMsPerBlock) : difference;
+    hostOffsetValid = true;
+
+    return hostMs + hostOffsetMs;
+}
+
+void MidiDispatcher::pushBlock(const juce::MidiBuffer& midi, int numSamples, const juce::AudioIODeviceCallbackContext& context) noexcept
+{
+    const double observedMs = observeBlockTime(juce::Time::getMillisecondCounterHiRes(), numSamples, context);
+    sampleClock.update(samplesPushed, numSamples, observedMs);
+    clock.write({ samplesPushed, sampleClock.getTimeMs(samplesPushed), sampleClock.getMsPerSample() });
+
+    for (const auto metadata : midi)
+    {
+        ScheduledMessage message;
+        message.samplePosition = samplesPushed + metadata.samplePosition;
+
+        if (metadata.numBytes > static_cast<int>(sizeof(message.data)))
+        {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            continue;
+        }
+
+        message.size = static_cast<std::uint8_t>(metadata.numBytes);
+        std::copy(metadata.data, metadata.data + metadata.numBytes, message.data);
+
+        if (!queue.push(message))
+            dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    samplesPushed += numSamples;
+}
+
+double MidiDispatcher::getDueTimeMs(const ScheduledMessage& message, const ClockAnchor& anchor) noexcept
+{
+    return anchor.timeMs + static_cast<double>(message.samplePosition - anchor.samplePosition) * anchor.msPerSample + kSendDelayMs;
+}
+
+void MidiDispatcher::run()
+{
+    while (!threadShouldExit())
+    {
+        const auto* next = queue.front();
+        if (next == nullptr)
+        {
+            wait(1);
+            continue;
+        }
+
+        const auto nowMs = juce::Time::getMillisecondCounterHiRes();
+        const auto dueMs = getDueTimeMs(*next, clock.read());
+
+        if (dueMs > nowMs && dueMs - nowMs < kMaxScheduleAheadMs)
+        {
+            // Sleep coarsely, then yield through the last couple of milliseconds, since timed
+            // waits can overshoot by a scheduler tick.
+            if (dueMs - nowMs > 3.0)
+                wait(static_cast<int>(dueMs - nowMs) - 2);
+            else
+                juce::Thread::yield();
+            continue;
+        }
+
+        {
+            const juce::ScopedLock sl(outputLock);
+            if (output != nullptr)
+                output->sendMessageNow(juce::MidiMessage(next->data, static_cast<int>(next->size)));
+        }
+
+        if (dueMs <= nowMs)
+            sendJitter.record(juce::Time::getMillisecondCounterHiRes() - dueMs);
+
+        queue.pop();
+    }
+}
+
+} // namespace audiotomidi
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+#include <juce_audio_devices/juce_audio_devices.h>
+
+#include "SampleClock.h"
+#include "SpscQueue.h"
+#include "TimingHistogram.h"
+#include "TripleBuffer.h"
+
+namespace audiotomidi {
+
+// Sends the standalone's MIDI from its own high-priority thread. The audio callback hands each
+// block's MidiBuffer to pushBlock(), which copies the events into a preallocated SPSC queue
+// stamped with their absolute sample position and returns; the dispatch thread turns those
+// positions back into wall-clock times and sends every message when it falls due. The thread
+// polls an empty queue every millisecond rather than being woken, so the audio thread never
+// touches a lock. Slow MIDI drivers therefore delay only this thread, never the audio callback.
+//
+// Wall-clock times come from a SampleClock fed once per block. When the device reports a host
+// timestamp for the block it is used (mapped onto the Time::getMillisecondCounterHiRes() scale);
+// otherwise the callback entry time is. Either way the loop filter removes scheduling noise, and
+// every message is sent a fixed getSendDelayMs() after its sample's modelled time, so triggers
+// keep a constant latency instead of inheriting the callback's jitter.
+class MidiDispatcher : private juce::Thread
+{
+public:
+    MidiDispatcher();
+    ~MidiDispatcher() override;
+
+    // Restarts the sample clock. Call from audioDeviceAboutToStart, before the first pushBlock().
+    void prepare(double sampleRate) noexcept;
+
+    // Message thread. Takes ownership of the output (or closes it when null).
+    void setOutput(std::unique_ptr<juce::MidiOutput> newOutput);
+
+    // Audio thread. Never blocks or allocates; events that do not fit are counted and dropped.
+    void pushBlock(const juce::MidiBuffer& midi, int numSamples, const juce::AudioIODeviceCallbackContext& context) noexcept;
+
+    std::uint32_t getNumDropped() const noexcept { return dropped.load(std::memory_order_relaxed); }
+    bool isUsingHostTime() const noexcept { return usingHostTime.load(std::memory_order_relaxed); }
+    static double getSendDelayMs() noexcept;
+
+    // Actual minus scheduled send time of every message, in ms.
+    const TimingHistogram& getSendJitter() const noexcept { return sendJitter; }
+    TimingHistogram& getSendJitter() noexcept { return sendJitter; }
+
+    // Time between callbacks minus the previous block's duration, in ms.
+    const TimingHistogram& getCallbackJitter() const noexcept { return callbackJitter; }
+    TimingHistogram& getCallbackJitter() noexcept { return callbackJitter; }
+
+private:
+    struct ScheduledMessage
+    {
+        std::int64_t samplePosition = 0;
+        std::uint8_t data[3] {};
+        std::uint8_t size = 0;
+    };
+
+    // The sample clock model as of the latest block.
+    struct ClockAnchor
+    {
+        std::int64_t samplePosition = 0;
+        double timeMs = 0.0;
+        double msPerSample = 1000.0 / 44100.0;
+    };
+
+    void run() override;
+    double observeBlockTime(double entryMs, int numSamples, const juce::AudioIODeviceCallbackContext& context) noexcept;
+    static double getDueTimeMs(const ScheduledMessage& message, const ClockAnchor& anchor) noexcept;
+
+    SpscQueue<ScheduledMessage, 4096> queue;
+    TripleBuffer<ClockAnchor> clock;
+    std::atomic<std::uint32_t> dropped { 0 };
+    std::atomic<bool> usingHostTime { false };
+
+    // Audio thread state.
+    SampleClock sampleClock;
+    std::int64_t samplesPushed = 0;
+    double sampleRateHz = 44100.0;
+    double previousEntryMs = 0.0;
+    int previousNumSamples = 0;
+    double hostOffsetMs = 0.0;
+    bool hostOffsetValid = false;
+
+    TimingHistogram sendJitter { -2.0, 8.0, 200 };
+    TimingHistogram callbackJitter { -10.0, 10.0, 200 };
+
+    juce::CriticalSection outputLock;
+    std::unique_ptr<juce::MidiOutput> output;
+
+    JUCE_DECLARE_NON_COPYABLE(MidiDispatcher)
+};
+
+} // namespace audiotomidi
@@ -12,47 +12,126 @@ void MidiEngine::prepare(double sampleRate) noexcept
 
 void MidiEngine::reset() noexcept
 {
-    for (auto& note : pending)
-        note = {};
+    numPending = 0;
+    for (auto& channel : held)
+        channel.fill(0);
+    blockStartSample = 0;
 }
 
-void MidiEngine::processPending(juce::MidiBuffer& midi, int numSamples) noexcept
+void MidiEngine::siftUp(int index) noexcept
 {
-    for (auto& note : pending)
+    const auto entry = pending[static_cast<size_t>(index)];
+    while (index > 0)
     {
-        if (!note.active)
-            continue;
+        const int parent = (index - 1) / 2;
+        if (pending[static_cast<size_t>(parent)].dueSample <= entry.dueSample)
+            break;
 
-        if (note.samplesRemaining < numSamples)
-        {
-            midi.addEvent(juce::MidiMessage::noteOff(note.midiChannel, note.noteNumber), note.samplesRemaining);
-            note = {};
-        }
-        else
-        {
-            note.samplesRemaining -= numSamples;
-        }
+        pending[static_cast<size_t>(index)] = pending[static_cast<size_t>(parent)];
+        index = parent;
     }
+    pending[static_cast<size_t>(index)] = entry;
 }
 
-void MidiEngine::addPending(int samplesRemaining, int noteNumber, int midiChannel) noexcept
+void MidiEngine::siftDown(int index) noexcept
 {
-    for (auto& note : pending)
+    const auto entry = pending[static_cast<size_t>(index)];
+    for (;;)
     {
-        if (!note.active)
-        {
-            note.active = true;
-            note.samplesRemaining = samplesRemaining;
-            note.noteNumber = noteNumber;
-            note.midiChannel = midiChannel;
-            return;
-        }
+        int child = 2 * index + 1;
+        if (child >= numPending)
+            break;
+
+        if (child + 1 < numPending && pending[static_cast<size_t>(child + 1)].dueSample < pending[static_cast<size_t>(child)].dueSample)
+            ++child;
+
+        if (entry.dueSample <= pending[static_cast<size_t>(child)].dueSample)
+            break;
+
+        pending[static_cast<size_t>(index)] = pending[static_cast<size_t>(child)];
+        index = child;
     }
+    pending[static_cast<size_t>(index)] = entry;
+}
+
+void MidiEngine::pushHeap(const PendingNoteOff& entry) noexcept
+{
+    pending[static_cast<size_t>(numPending)] = entry;
+    siftUp(numPending++);
+    ++heldCount(entry.noteNumber, entry.channelIndex + 1);
+}
+
+MidiEngine::PendingNoteOff MidiEngine::removeHeapAt(int index) noexcept
+{
+    const auto removed = pending[static_cast<size_t>(index)];
+    --heldCount(removed.noteNumber, removed.channelIndex + 1);
 
-    pending[0].active = true;
-    pending[0].samplesRemaining = samplesRemaining;
-    pending[0].noteNumber = noteNumber;
-    pending[0].midiChannel = midiChannel;
+    if (--numPending > index)
+    {
+        pending[static_cast<size_t>(index)] = pending[static_cast<size_t>(numPending)];
+        siftDown(index);
+        siftUp(index);
+    }
+
+    return removed;
+}
+
+int MidiEngine::findPending(int noteNumber, int midiChannel) const noexcept
+{
+    for (int i = 0; i < numPending; ++i)
+    {
+        const auto& entry = pending[static_cast<size_t>(i)];
+        if (entry.noteNumber == noteNumber && entry.channelIndex + 1 == midiChannel)
+            return i;
+    }
+    return -1;
+}
+
+void MidiEngine::sendNoteOff(juce::MidiBuffer& midi, const PendingNoteOff& entry, int offset) noexcept
+{
+    midi.addEvent(juce::MidiMessage::noteOff(entry.channelIndex + 1, entry.noteNumber), offset);
+}
+
+void MidiEngine::releaseAll(juce::MidiBuffer& midi, int offset) noexcept
+{
+    while (numPending > 0)
+        sendNoteOff(midi, removeHeapAt(0), offset);
+}
+
+void MidiEngine::sendDueNoteOffs(juce::MidiBuffer& midi, std::int64_t lastSample) noexcept
+{
+    while (numPending > 0 && pending[0].dueSample <= lastSample)
+    {
+        const auto entry = removeHeapAt(0);
+        sendNoteOff(midi, entry, static_cast<int>(std::max<std::int64_t>(0, entry.dueSample - blockStartSample)));
+    }
+}
+
+void MidiEngine::endHeldNote(juce::MidiBuffer& midi, int noteNumber, int midiChannel, int offset) noexcept
+{
+    while (heldCount(noteNumber, midiChannel) > 0)
+    {
+        const int index = findPending(noteNumber, midiChannel);
+        if (index < 0)
+            break;
+
+        sendNoteOff(midi, removeHeapAt(index), offset);
+    }
+}
+
+bool MidiEngine::extendHeldNote(std::int64_t dueSample, int noteNumber, int midiChannel) noexcept
+{
+    const int index = findPending(noteNumber, midiChannel);
+    if (index < 0)
+        return false;
+
+    auto& entry = pending[static_cast<size_t>(index)];
+    if (dueSample > entry.dueSample)
+    {
+        entry.dueSample = dueSample;
+        siftDown(index);
+    }
+    return true;
 }
 
 void MidiEngine::process(const BeatDetector::TriggerBuffer& triggers,
@@ -60,8 +139,6 @@ void MidiEngine::process(const BeatDetector::TriggerBuffer& triggers,
                          int numSamples,
                          const MidiEngineParams& params) noexcept
 {
-    processPending(midi, numSamples);
-
     const auto noteNumber = std::clamp(params.noteNumber, 0, 127);
     const auto channel = std::clamp(params.midiChannel, 1, 16);
     const auto fixedVelocity = std::clamp(params.fixedVelocity, 0, 127);
@@ -71,23 +148,39 @@ void MidiEngine::process(const BeatDetector::TriggerBuffer& triggers,
     {
         const auto& event = triggers.events[static_cast<size_t>(i)];
         const int offset = std::clamp(event.sampleOffset, 0, std::max(0, numSamples - 1));
+        const auto eventNote = event.noteNumber >= 0 ? std::clamp(event.noteNumber, 0, 127) : noteNumber;
+        const auto noteOnSample = blockStartSample + offset;
+
+        // Note-offs due at or before this trigger go first, so a note ending on the same sample
+        // as its retrigger is released before it is struck again.
+        sendDueNoteOffs(midi, noteOnSample);
+
+        if (heldCount(eventNote, channel) > 0)
+        {
+            if (params.retrigger == RetriggerPolicy::Cut)
+                endHeldNote(midi, eventNote, channel, offset);
+            else if (params.retrigger == RetriggerPolicy::Extend && extendHeldNote(noteOnSample + noteLengthSamples, eventNote, channel))
+                continue;
+        }
+
+        if (numPending == maxPendingNoteOffs)
+            sendNoteOff(midi, removeHeapAt(0), offset);
 
         int velocity = fixedVelocity;
         if (params.velocityMode == VelocityMode::Dynamic)
             velocity = std::clamp(static_cast<int>(juce::jmap(event.strength, 0.0f, 1.0f, 25.0f, 127.0f)), 1, 127);
 
-        midi.addEvent(juce::MidiMessage::noteOn(channel, noteNumber, static_cast<juce::uint8>(velocity)), offset);
+        midi.addEvent(juce::MidiMessage::noteOn(channel, eventNote, static_cast<juce::uint8>(velocity)), offset);
 
-        const int noteOffOffset = offset + noteLengthSamples;
-        if (noteOffOffset < numSamples)
-        {
-            midi.addEvent(juce::MidiMessage::noteOff(channel, noteNumber), noteOffOffset);
-        }
-        else
-        {
-            addPending(noteOffOffset - numSamples, noteNumber, channel);
-        }
+        PendingNoteOff noteOff;
+        noteOff.dueSample = noteOnSample + noteLengthSamples;
+        noteOff.noteNumber = static_cast<std::uint8_t>(eventNote);
+        noteOff.channelIndex = static_cast<std::uint8_t>(channel - 1);
+        pushHeap(noteOff);
     }
+
+    sendDueNoteOffs(midi, blockStartSample + numSamples - 1);
+    blockStartSample += numSamples;
 }
 
 } // namespace audiotomidi
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <array>
+#include <cstdint>
 
 #include <juce_audio_basics/juce_audio_basics.h>
 
@@ -14,6 +15,14 @@ enum class VelocityMode
     Dynamic = 1
 };
 
+// What a trigger does when its note is still held from an earlier trigger.
+enum class RetriggerPolicy
+{
+    Layer = 0,  // send another note-on; each note-on gets its own note-off
+    Cut = 1,    // end the held note with a note-off, then send the new note-on
+    Extend = 2  // keep the held note and move its note-off to the new trigger's end
+};
+
 struct MidiEngineParams
 {
     int noteNumber = 36;
@@ -21,11 +30,18 @@ struct MidiEngineParams
     int noteLengthMs = 30;
     VelocityMode velocityMode = VelocityMode::Fixed;
     int fixedVelocity = 100;
+    RetriggerPolicy retrigger = RetriggerPolicy::Layer;
 };
 
+// Turns triggers into note-ons and schedules their note-offs. Pending note-offs live in a
+// fixed-capacity min-heap keyed on absolute sample time, so each block costs O(log n) per note
+// that starts or ends rather than a scan of every slot. A note-off is never dropped: when the
+// heap is full the earliest pending note-off is sent early to make room.
 class MidiEngine
 {
 public:
+    static constexpr int maxPendingNoteOffs = 1024;
+
     void prepare(double sampleRate) noexcept;
     void reset() noexcept;
 
@@ -34,19 +50,43 @@ public:
                  int numSamples,
                  const MidiEngineParams& params) noexcept;
 
+    // Sends every pending note-off at offset, so no note is left held.
+    void releaseAll(juce::MidiBuffer& midi, int offset) noexcept;
+
+    int getNumPendingNoteOffs() const noexcept { return numPending; }
+
 private:
     struct PendingNoteOff
     {
-        bool active = false;
-        int samplesRemaining = 0;
-        int noteNumber = 0;
-        int midiChannel = 1;
+        std::int64_t dueSample = 0;
+        std::uint8_t noteNumber = 0;
+        std::uint8_t channelIndex = 0;
     };
 
-    void processPending(juce::MidiBuffer& midi, int numSamples) noexcept;
-    void addPending(int samplesRemaining, int noteNumber, int midiChannel) noexcept;
+    void sendDueNoteOffs(juce::MidiBuffer& midi, std::int64_t lastSample) noexcept;
+    void sendNoteOff(juce::MidiBuffer& midi, const PendingNoteOff& entry, int offset) noexcept;
+    void endHeldNote(juce::MidiBuffer& midi, int noteNumber, int midiChannel, int offset) noexcept;
+    bool extendHeldNote(std::int64_t dueSample, int noteNumber, int midiChannel) noexcept;
+    int findPending(int noteNumber, int midiChannel) const noexcept;
+
+    void pushHeap(const PendingNoteOff& entry) noexcept;
+    PendingNoteOff removeHeapAt(int index) noexcept;
+    void siftUp(int index) noexcept;
+    void siftDown(int index) noexcept;
+
+    std::uint16_t& heldCount(int noteNumber, int midiChannel) noexcept
+    {
+        return held[static_cast<size_t>(midiChannel - 1)][static_cast<size_t>(noteNumber)];
+    }
+
+    std::array<PendingNoteOff, maxPendingNoteOffs> pending {};
+    int numPending = 0;
+
+    // Pending note-offs per channel and note, so retrigger policies only search the heap when
+    // the note is actually held.
+    std::array<std::array<std::uint16_t, 128>, 16> held {};
 
-    std::array<PendingNoteOff, 128> pending{};
+    std::int64_t blockStartSample = 0;
     double sampleRateHz = 44100.0;
 };
 
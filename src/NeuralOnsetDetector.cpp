@@ -0,0 +1,252 @@
+#include "NeuralOnsetDetector.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "Int8Kernel.h"
+
+namespace audiotomidi {
+
+namespace
+{
+constexpr float kLogCompression = 100.0f;
+
+float hzToMel(float hz) noexcept
+{
+    return 2595.0f * std::log10(1.0f + hz / 700.0f);
+}
+
+float melToHz(float mel) noexcept
+{
+    return 700.0f * (std::pow(10.0f, mel / 2595.0f) - 1.0f);
+}
+
+std::int8_t quantize(float value, float scale) noexcept
+{
+    return static_cast<std::int8_t>(std::clamp(static_cast<int>(std::lround(value * scale)), -127, 127));
+}
+
+// Dequantizes a layer's accumulators, adds the bias and applies ReLU before requantizing.
+template <size_t size>
+void finishHiddenLayer(const std::int32_t* accumulators, const std::array<float, size>& scales, const std::array<float, size>& biases,
+                       float outputScale, std::int8_t* out) noexcept
+{
+    for (size_t o = 0; o < size; ++o)
+        out[o] = quantize(std::max(0.0f, static_cast<float>(accumulators[o]) * scales[o] + biases[o]), outputScale);
+}
+} // namespace
+
+float NeuralOnsetDetector::getActivationThreshold(float sensitivity) noexcept
+{
+    return 0.85f - std::clamp(sensitivity, 0.0f, 100.0f) * 0.007f;
+}
+
+void NeuralOnsetDetector::prepare(double sr)
+{
+    prepare(sr, getBestSimdIsa());
+}
+
+void NeuralOnsetDetector::prepare(double sr, SimdIsa isa)
+{
+    sampleRateHz = sr > 0.0 ? sr : 44100.0;
+    layerIsa = isa;
+
+    // Keep the frame near 21 ms and the hop near 2.7 ms whatever the sample rate.
+    const int order = sampleRateHz <= 50000.0 ? 10 : (sampleRateHz <= 100000.0 ? 11 : 12);
+    fftSize = 1 << order;
+    hopSize = fftSize / 8;
+    numBins = fftSize / 2 + 1;
+
+    fft = std::make_unique<juce::dsp::FFT>(order);
+
+    window.assign(static_cast<size_t>(fftSize), 0.0f);
+    juce::dsp::WindowingFunction<float>::fillWindowingTables(window.data(), static_cast<size_t>(fftSize),
+                                                             juce::dsp::WindowingFunction<float>::hann, false);
+
+    // Normalise so a full-scale sine reads roughly 1.0 in its peak bin.
+    float windowSum = 0.0f;
+    for (auto w : window)
+        windowSum += w;
+    for (auto& w : window)
+        w *= 2.0f / windowSum;
+
+    inputRing.assign(static_cast<size_t>(fftSize), 0.0f);
+    fftData.assign(static_cast<size_t>(fftSize * 2), 0.0f);
+
+    // Triangles between mel-spaced edges with unit peak. Summing power under them makes a band's
+    // reading independent of the FFT size for tones and noise alike. A band narrower than the bin
+    // spacing still takes the bin nearest its centre, so the low bands never go empty.
+    const float binHz = static_cast<float>(sampleRateHz) / static_cast<float>(fftSize);
+    const float lowMel = hzToMel(neuralmodel::lowestBandHz);
+    const float melStep = (hzToMel(neuralmodel::highestBandHz) - lowMel) / static_cast<float>(neuralmodel::numBands + 1);
+
+    bandWeights.clear();
+    bandWeights.reserve(static_cast<size_t>(numBins) * 2);
+    for (int band = 0; band < neuralmodel::numBands; ++band)
+    {
+        const float lowHz = melToHz(lowMel + melStep * static_cast<float>(band));
+        const float centreHz = melToHz(lowMel + melStep * static_cast<float>(band + 1));
+        const float highHz = melToHz(lowMel + melStep * static_cast<float>(band + 2));
+
+        const int first = std::max(0, static_cast<int>(std::ceil(lowHz / binHz)));
+        const int last = std::min(numBins - 1, static_cast<int>(std::floor(highHz / binHz)));
+
+        const auto start = bandWeights.size();
+        float area = 0.0f;
+        for (int k = first; k <= last; ++k)
+        {
+            const float hz = static_cast<float>(k) * binHz;
+            const float w = hz <= centreHz ? (hz - lowHz) / (centreHz - lowHz) : (highHz - hz) / (highHz - centreHz);
+            bandWeights.push_back(std::max(0.0f, w));
+            area += bandWeights.back();
+        }
+
+        if (area <= 0.0f)
+        {
+            bandWeights.resize(start);
+            bandFirstBin[static_cast<size_t>(band)] = std::min(numBins - 1, static_cast<int>(std::lround(centreHz / binHz)));
+            bandNumBins[static_cast<size_t>(band)] = 1;
+            bandWeights.push_back(1.0f);
+            continue;
+        }
+
+        bandFirstBin[static_cast<size_t>(band)] = first;
+        bandNumBins[static_cast<size_t>(band)] = last - first + 1;
+    }
+
+    reset();
+}
+
+void NeuralOnsetDetector::reset() noexcept
+{
+    std::fill(inputRing.begin(), inputRing.end(), 0.0f);
+    features.fill(0);
+    ringPosition = 0;
+    samplesUntilHop = hopSize;
+    framesUntilReady = neuralmodel::numFrames;
+    previousActivation = 0.0f;
+    previousPreviousActivation = 0.0f;
+    previousStrength = 0.0f;
+    samplesSinceLastTrigger = static_cast<int>(sampleRateHz);
+}
+
+void NeuralOnsetDetector::computeFeatures() noexcept
+{
+    // Unroll the ring so the oldest sample lands at index 0.
+    const auto tailLength = static_cast<size_t>(fftSize - ringPosition);
+    std::copy(inputRing.begin() + ringPosition, inputRing.end(), fftData.begin());
+    std::copy(inputRing.begin(), inputRing.begin() + ringPosition, fftData.begin() + static_cast<std::ptrdiff_t>(tailLength));
+    juce::FloatVectorOperations::multiply(fftData.data(), window.data(), fftSize);
+    std::fill(fftData.begin() + fftSize, fftData.end(), 0.0f);
+
+    fft->performFrequencyOnlyForwardTransform(fftData.data(), true);
+
+    // Drop the oldest frame and append the new one at the end.
+    constexpr auto frameBytes = static_cast<size_t>(neuralmodel::numBands);
+    std::memmove(features.data(), features.data() + frameBytes, features.size() - frameBytes);
+    auto* newest = features.data() + features.size() - frameBytes;
+
+    const float* weights = bandWeights.data();
+    for (size_t band = 0; band < frameBytes; ++band)
+    {
+        const float* magnitudes = fftData.data() + bandFirstBin[band];
+        float power = 0.0f;
+        for (int k = 0; k < bandNumBins[band]; ++k)
+            power += weights[k] * magnitudes[k] * magnitudes[k];
+        weights += bandNumBins[band];
+
+        newest[band] = quantize(std::log1p(kLogCompression * std::sqrt(power)), neuralmodel::featureScale);
+    }
+}
+
+void NeuralOnsetDetector::runNetwork(std::array<float, neuralmodel::numHeads>& probabilities) noexcept
+{
+    using namespace neuralmodel;
+
+    int8MatVec(layerIsa, layer1Weights.data(), features.data(), inputSize, hidden1Size, accumulators.data());
+    finishHiddenLayer(accumulators.data(), layer1Scales, layer1Biases, hidden1Scale, hidden1.data());
+
+    int8MatVec(layerIsa, layer2Weights.data(), hidden1.data(), hidden1Size, hidden2Size, accumulators.data());
+    finishHiddenLayer(accumulators.data(), layer2Scales, layer2Biases, hidden2Scale, hidden2.data());
+
+    int8MatVec(layerIsa, outputWeights.data(), hidden2.data(), hidden2Size, numHeads, accumulators.data());
+    for (size_t head = 0; head < static_cast<size_t>(numHeads); ++head)
+    {
+        const float logit = static_cast<float>(accumulators[head]) * outputScales[head] + outputBiases[head];
+        probabilities[head] = 1.0f / (1.0f + std::exp(-logit));
+    }
+}
+
+void NeuralOnsetDetector::analyseFrame(const BeatDetector::Params& params, int sampleOffset, BeatDetector::TriggerBuffer& out) noexcept
+{
+    computeFeatures();
+
+    std::array<float, neuralmodel::numHeads> probabilities {};
+    runNetwork(probabilities);
+    const float activation = probabilities[static_cast<size_t>(params.focusLow ? neuralmodel::lowBandHead : neuralmodel::fullBandHead)];
+
+    // Velocity follows the loudest band the head listens to, on the log scale of the features.
+    const int strengthBands = params.focusLow ? neuralmodel::numLowBands : neuralmodel::numBands;
+    const auto* newest = features.data() + features.size() - static_cast<size_t>(neuralmodel::numBands);
+    const auto loudest = *std::max_element(newest, newest + strengthBands);
+    const float strength = std::clamp(static_cast<float>(loudest) / (neuralmodel::featureScale * std::log1p(kLogCompression)), 0.0f, 1.0f);
+
+    const float threshold = getActivationThreshold(params.sensitivity);
+
+    // The previous frame is a peak once we know the current one is not higher.
+    const float candidate = previousActivation;
+    const float candidateStrength = previousStrength;
+    const bool isPeak = candidate > previousPreviousActivation && candidate >= activation && candidate > threshold;
+
+    previousPreviousActivation = previousActivation;
+    previousActivation = activation;
+    previousStrength = strength;
+    out.envelope = activation;
+    out.threshold = threshold;
+
+    // Until the network has seen a full context, its input is partly the silence after reset.
+    if (framesUntilReady > 0)
+    {
+        --framesUntilReady;
+        return;
+    }
+
+    if (isPeak && samplesSinceLastTrigger >= std::max(1, static_cast<int>(params.minGapMs * 0.001f * static_cast<float>(sampleRateHz))))
+    {
+        if (out.count < static_cast<int>(out.events.size()))
+        {
+            auto& event = out.events[static_cast<size_t>(out.count++)];
+            event = {};
+            event.sampleOffset = sampleOffset;
+            event.strength = candidateStrength;
+        }
+        samplesSinceLastTrigger = 0;
+    }
+}
+
+void NeuralOnsetDetector::processBlock(const float* monoSamples, int numSamples, const BeatDetector::Params& params, BeatDetector::TriggerBuffer& out) noexcept
+{
+    out.count = 0;
+
+    int i = 0;
+    while (i < numSamples)
+    {
+        const int toRingEnd = fftSize - ringPosition;
+        const int length = std::min({ samplesUntilHop, numSamples - i, toRingEnd });
+
+        std::copy(monoSamples + i, monoSamples + i + length, inputRing.begin() + ringPosition);
+        ringPosition = (ringPosition + length) % fftSize;
+        samplesUntilHop -= length;
+        samplesSinceLastTrigger = std::min(samplesSinceLastTrigger + length, 1 << 30);
+        i += length;
+
+        if (samplesUntilHop == 0)
+        {
+            samplesUntilHop = hopSize;
+            analyseFrame(params, i - 1, out);
+        }
+    }
+}
+
+} // namespace audiotomidi
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <juce_dsp/juce_dsp.h>
+
+#include "BeatDetector.h"
+#include "DownmixKernel.h"
+#include "NeuralOnsetWeights.h"
+
+namespace audiotomidi {
+
+// Onset detector that runs a small int8-quantized network over mel-band features. Every hop
+// (1/8 of a ~21 ms Hann frame) the frame's magnitude spectrum is pooled into 32 mel bands from
+// 30 Hz to 16 kHz and log-compressed; the network sees the last eight such frames and outputs an
+// onset probability per hop from two heads, full band and low band (chosen by focusLow). Local
+// maxima of that probability above a sensitivity-dependent threshold trigger, subject to the
+// minimum gap, and velocity follows the loudest band of the peak frame.
+//
+// The layers are int8 matrix-vector products with int32 accumulation (Int8Kernel.h), so the
+// output does not depend on the instruction set. Weights are compiled in from
+// NeuralOnsetWeights.h. Like SpectralFluxDetector, triggers are reported getLatencySamples() after
+// the transient. Everything is allocated in prepare(); processBlock() never allocates.
+class NeuralOnsetDetector
+{
+public:
+    void prepare(double sampleRate);
+
+    // Same, with an explicit instruction set for the layers; isa must be supported on this CPU.
+    void prepare(double sampleRate, SimdIsa isa);
+
+    void reset() noexcept;
+    void processBlock(const float* monoSamples, int numSamples, const BeatDetector::Params& params, BeatDetector::TriggerBuffer& out) noexcept;
+
+    // A transient raises the newest frame's bands while it is still in the leading half of the
+    // window, and its peak is confirmed one hop later; half a frame plus half a hop is the mean
+    // of that delay, measured on AudioToMidiBeatEval's signals.
+    int getLatencySamples() const noexcept { return fftSize / 2 + hopSize / 2; }
+
+    // Probability a frame's activation must exceed to trigger at a sensitivity setting.
+    static float getActivationThreshold(float sensitivity) noexcept;
+
+private:
+    void analyseFrame(const BeatDetector::Params& params, int sampleOffset, BeatDetector::TriggerBuffer& out) noexcept;
+    void computeFeatures() noexcept;
+    void runNetwork(std::array<float, neuralmodel::numHeads>& probabilities) noexcept;
+
+    double sampleRateHz = 44100.0;
+    SimdIsa layerIsa = SimdIsa::Scalar;
+    int fftSize = 1024;
+    int hopSize = 128;
+    int numBins = 513;
+
+    std::unique_ptr<juce::dsp::FFT> fft;
+    std::vector<float> window;
+    std::vector<float> inputRing;
+    std::vector<float> fftData;
+
+    // Triangular mel filters as (first bin, number of bins) per band into one weight array.
+    std::array<int, neuralmodel::numBands> bandFirstBin {};
+    std::array<int, neuralmodel::numBands> bandNumBins {};
+    std::vector<float> bandWeights;
+
+    // Quantized features of the last numFrames frames, oldest first, and layer activations.
+    alignas(32) std::array<std::int8_t, neuralmodel::inputSize> features {};
+    alignas(32) std::array<std::int8_t, neuralmodel::hidden1Size> hidden1 {};
+    alignas(32) std::array<std::int8_t, neuralmodel::hidden2Size> hidden2 {};
+    std::array<std::int32_t, neuralmodel::hidden1Size> accumulators {};
+
+    int ringPosition = 0;
+    int samplesUntilHop = 0;
+    int framesUntilReady = 0;
+
+    float previousActivation = 0.0f;
+    float previousPreviousActivation = 0.0f;
+    float previousStrength = 0.0f;
+    int samplesSinceLastTrigger = 0;
+};
+
+} // namespace audiotomidi
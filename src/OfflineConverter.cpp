@@ -0,0 +1,234 @@
+#include "OfflineConverter.h"
+
+#include <algorithm>
+#include <thread>
+
+#include "DownmixKernel.h"
+
+namespace audiotomidi {
+
+OfflineConverter::OfflineConverter(const OfflineSettings& s)
+    : settings(s)
+{
+    settings.blockSize = std::max(16, settings.blockSize);
+    formatManager.registerBasicFormats();
+}
+
+void OfflineConverter::streamChunk(juce::AudioFormatReader& reader, const AnalysisChunk& chunk, int blockSize,
+                                   StreamBuffers& streamBuffers, OnsetAnalyser& onsetAnalyser)
+{
+    const auto numChannels = static_cast<int>(reader.numChannels);
+
+    streamBuffers.read.setSize(numChannels, blockSize, false, false, true);
+    streamBuffers.mono.allocate(static_cast<size_t>(blockSize), false);
+
+    onsetAnalyser.begin(chunk);
+
+    // Reads past the end of the file return silence, which flushes the lookahead.
+    const auto streamEnd = chunk.end + onsetAnalyser.getLatencySamples();
+    for (auto position = chunk.warmupStart; position < streamEnd; position += blockSize)
+    {
+        const auto numSamples = static_cast<int>(std::min<juce::int64>(blockSize, streamEnd - position));
+        reader.read(&streamBuffers.read, 0, numSamples, position, true, true);
+
+        auto* mono = streamBuffers.mono.get();
+        downmixToMono(streamBuffers.read.getArrayOfReadPointers(), numChannels, mono, numSamples);
+        onsetAnalyser.process(mono, numSamples);
+    }
+}
+
+bool OfflineConverter::analyse(const juce::File& input, int numThreads, OnsetList& onsets, OfflineResult& result)
+{
+    const auto startTicks = juce::Time::getHighResolutionTicks();
+
+    std::unique_ptr<juce::AudioFormatReader> reader(formatManager.createReaderFor(input));
+    if (reader == nullptr)
+    {
+        result.error = "unsupported or unreadable audio file";
+        return false;
+    }
+
+    if (reader->numChannels == 0 || reader->sampleRate <= 0.0)
+    {
+        result.error = "file has no audio channels";
+        return false;
+    }
+
+    result.sampleRate = reader->sampleRate;
+    result.numSamples = reader->lengthInSamples;
+    result.numChunks = 1;
+
+    if (numThreads > 1)
+    {
+        reader.reset();
+        if (!analyseChunked(input, numThreads, onsets, result))
+            return false;
+    }
+    else
+    {
+        analyser.prepare(result.sampleRate, settings.detector);
+        streamChunk(*reader, { 0, 0, result.numSamples }, settings.blockSize, buffers, analyser);
+        onsets = analyser.takeOnsets();
+    }
+
+    result.numTriggers = static_cast<int>(onsets.size());
+    result.analysisSeconds = juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - startTicks);
+    return true;
+}
+
+bool OfflineConverter::analyseChunked(const juce::File& input, int numThreads, OnsetList& onsets, OfflineResult& result)
+{
+    BeatDetector gapReference;
+    gapReference.prepare(result.sampleRate);
+
+    const auto warmupSamples = getChunkWarmupSamples(result.sampleRate, settings.detector);
+    const auto chunks = planAnalysisChunks(result.numSamples, numThreads, warmupSamples);
+    result.numChunks = static_cast<int>(chunks.size());
+
+    std::vector<OnsetList> chunkOnsets(chunks.size());
+    std::vector<juce::String> chunkErrors(chunks.size());
+    std::vector<std::thread> workers;
+    workers.reserve(chunks.size());
+
+    for (size_t i = 0; i < chunks.size(); ++i)
+    {
+        workers.emplace_back([&, i]
+        {
+            // AudioFormatReader is not thread-safe, so every chunk opens its own.
+            juce::AudioFormatManager chunkFormats;
+            chunkFormats.registerBasicFormats();
+
+            std::unique_ptr<juce::AudioFormatReader> chunkReader(chunkFormats.createReaderFor(input));
+            if (chunkReader == nullptr)
+            {
+                chunkErrors[i] = "could not reopen file for chunk " + juce::String(static_cast<int>(i));
+                return;
+            }
+
+            StreamBuffers chunkBuffers;
+            OnsetAnalyser chunkAnalyser;
+            chunkAnalyser.prepare(result.sampleRate, settings.detector);
+            streamChunk(*chunkReader, chunks[i], settings.blockSize, chunkBuffers, chunkAnalyser);
+            chunkOnsets[i] = chunkAnalyser.takeOnsets();
+        });
+    }
+
+    for (auto& worker : workers)
+        worker.join();
+
+    for (const auto& error : chunkErrors)
+    {
+        if (error.isNotEmpty())
+        {
+            result.error = error;
+            return false;
+        }
+    }
+
+    onsets = stitchOnsets(chunkOnsets, gapReference.getGapSamples(settings.detector));
+    return true;
+}
+
+juce::MidiMessageSequence OfflineConverter::renderMidi(const OnsetList& onsets, juce::int64 numSamples, double sampleRate)
+{
+    const int blockSize = settings.blockSize;
+    const double ticksPerSample = static_cast<double>(ticksPerQuarterNote) * 1.0e6
+                                / static_cast<double>(microsecondsPerQuarterNote) / sampleRate;
+
+    midiEngine.prepare(sampleRate);
+    blockMidi.clear();
+    blockMidi.ensureSize(4096);
+
+    juce::MidiMessageSequence sequence;
+    sequence.addEvent(juce::MidiMessage::tempoMetaEvent(microsecondsPerQuarterNote), 0.0);
+
+    auto appendBlockMidi = [&](juce::int64 blockStart)
+    {
+        for (const auto metadata : blockMidi)
+            sequence.addEvent(metadata.getMessage(), static_cast<double>(blockStart + metadata.samplePosition) * ticksPerSample);
+
+        blockMidi.clear();
+    };
+
+    BeatDetector::TriggerBuffer triggers;
+    size_t next = 0;
+
+    for (juce::int64 position = 0; position < numSamples; position += blockSize)
+    {
+        const auto blockLength = static_cast<int>(std::min<juce::int64>(blockSize, numSamples - position));
+
+        triggers.count = 0;
+        for (; next < onsets.size() && onsets[next].samplePosition < position + blockLength; ++next)
+        {
+            if (triggers.count < static_cast<int>(triggers.events.size()))
+            {
+                auto& event = triggers.events[static_cast<size_t>(triggers.count++)];
+                event = {};
+                event.sampleOffset = static_cast<int>(onsets[next].samplePosition - position);
+                event.strength = onsets[next].strength;
+            }
+        }
+
+        midiEngine.process(triggers, blockMidi, blockLength, settings.midi);
+        appendBlockMidi(position);
+    }
+
+    // Run one silent block past the end of the file so note-offs still pending in the engine
+    // are written instead of leaving hanging notes.
+    triggers.count = 0;
+    const int tailSamples = 1 + static_cast<int>(0.001 * static_cast<double>(std::max(0, settings.midi.noteLengthMs)) * sampleRate);
+    midiEngine.process(triggers, blockMidi, tailSamples, settings.midi);
+    appendBlockMidi(numSamples);
+
+    return sequence;
+}
+
+OfflineResult OfflineConverter::convert(const juce::File& input, const juce::File& output, int numThreads)
+{
+    OfflineResult result;
+    result.input = input;
+    result.output = output;
+
+    const auto startTicks = juce::Time::getHighResolutionTicks();
+
+    OnsetList onsets;
+    OnsetCache::Entry cached;
+    const auto cacheKey = onsetCache != nullptr ? onsetCache->makeKey(input, settings.detector, settings.blockSize, numThreads) : juce::String();
+
+    if (onsetCache != nullptr && onsetCache->lookup(cacheKey, cached))
+    {
+        onsets = std::move(cached.onsets);
+        result.sampleRate = cached.sampleRate;
+        result.numSamples = cached.numSamples;
+        result.numTriggers = static_cast<int>(onsets.size());
+        result.fromCache = true;
+    }
+    else
+    {
+        if (!analyse(input, numThreads, onsets, result))
+            return result;
+
+        if (onsetCache != nullptr)
+            onsetCache->store(cacheKey, { result.sampleRate, result.numSamples, onsets });
+    }
+
+    juce::MidiFile midiFile;
+    midiFile.setTicksPerQuarterNote(ticksPerQuarterNote);
+    midiFile.addTrack(renderMidi(onsets, result.numSamples, result.sampleRate));
+
+    output.getParentDirectory().createDirectory();
+    output.deleteFile();
+
+    juce::FileOutputStream stream(output);
+    if (!stream.openedOk() || !midiFile.writeTo(stream))
+    {
+        result.error = "could not write " + output.getFullPathName();
+        return result;
+    }
+
+    result.ok = true;
+    result.processingSeconds = juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - startTicks);
+    return result;
+}
+
+} // namespace audiotomidi
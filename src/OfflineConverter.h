@@ -0,0 +1,87 @@
+#pragma once
+
+#include <juce_audio_formats/juce_audio_formats.h>
+
+#include "BeatDetector.h"
+#include "ChunkedAnalysis.h"
+#include "MidiEngine.h"
+#include "OnsetCache.h"
+
+namespace audiotomidi {
+
+struct OfflineSettings
+{
+    BeatDetector::Params detector;
+    MidiEngineParams midi;
+    int blockSize = 4096;
+};
+
+struct OfflineResult
+{
+    juce::File input;
+    juce::File output;
+    bool ok = false;
+    juce::String error;
+    juce::int64 numSamples = 0;
+    double sampleRate = 0.0;
+    int numTriggers = 0;
+    int numChunks = 1;
+    bool fromCache = false;
+    double analysisSeconds = 0.0;
+    double processingSeconds = 0.0;
+
+    double getAudioSeconds() const noexcept { return sampleRate > 0.0 ? static_cast<double>(numSamples) / sampleRate : 0.0; }
+};
+
+// Streams an audio file through BeatDetector and MidiEngine block by block, exactly as the
+// plugin would see it, and writes the resulting notes to a Standard MIDI File. The audio is never
+// held whole: buffers depend only on the block size. The onset list and the MIDI sequence still
+// grow with the number of triggers, so a longer file with more hits uses more memory.
+//
+// With numThreads > 1 a single file is split into chunks that are analysed concurrently (see
+// ChunkedAnalysis.h). Trigger positions then match the sequential run exactly once each chunk's
+// warm-up has converged; strengths agree to within 1e-4.
+//
+// With an OnsetCache set, convert() looks the file up before opening it and on a hit only
+// renders the cached onsets, so changing MIDI settings never decodes the audio again.
+class OfflineConverter
+{
+public:
+    explicit OfflineConverter(const OfflineSettings& settings);
+
+    // The cache is not owned and may be shared between converters on different threads.
+    void setCache(OnsetCache* cache) noexcept { onsetCache = cache; }
+
+    OfflineResult convert(const juce::File& input, const juce::File& output, int numThreads = 1);
+
+    // Detection only: fills onsets and the audio/analysis fields of result.
+    bool analyse(const juce::File& input, int numThreads, OnsetList& onsets, OfflineResult& result);
+
+    // Replays a list of onsets through MidiEngine using the same block partition as analyse().
+    juce::MidiMessageSequence renderMidi(const OnsetList& onsets, juce::int64 numSamples, double sampleRate);
+
+    static constexpr int ticksPerQuarterNote = 960;
+    static constexpr int microsecondsPerQuarterNote = 500000;
+
+private:
+    struct StreamBuffers
+    {
+        juce::AudioBuffer<float> read;
+        juce::HeapBlock<float> mono;
+    };
+
+    bool analyseChunked(const juce::File& input, int numThreads, OnsetList& onsets, OfflineResult& result);
+    static void streamChunk(juce::AudioFormatReader& reader, const AnalysisChunk& chunk, int blockSize,
+                            StreamBuffers& buffers, OnsetAnalyser& analyser);
+
+    OfflineSettings settings;
+    juce::AudioFormatManager formatManager;
+    OnsetCache* onsetCache = nullptr;
+
+    StreamBuffers buffers;
+    OnsetAnalyser analyser;
+    juce::MidiBuffer blockMidi;
+    MidiEngine midiEngine;
+};
+
+} // namespace audiotomidi
@@ -0,0 +1,267 @@
+#include "OnsetCache.h"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+namespace audiotomidi {
+
+namespace
+{
+constexpr std::int32_t kEntryMagic = 0x4f4d3241; // "A2MO" in file order
+constexpr std::int32_t kEntryFormat = 1;
+constexpr auto kEntryExtension = ".onsets";
+constexpr size_t kHashReadBytes = 1 << 20;
+
+juce::Array<juce::File> findEntries(const juce::File& directory)
+{
+    return directory.findChildFiles(juce::File::findFiles, false, juce::String("*") + kEntryExtension);
+}
+} // namespace
+
+void ContentHash::add(const void* data, size_t size) noexcept
+{
+    auto* bytes = static_cast<const std::uint8_t*>(data);
+    length += size;
+
+    if (numPending > 0)
+    {
+        const auto take = std::min(size, pending.size() - numPending);
+        std::memcpy(pending.data() + numPending, bytes, take);
+        numPending += take;
+        bytes += take;
+        size -= take;
+        if (numPending < pending.size())
+            return;
+
+        mixBlock(pending.data());
+        numPending = 0;
+    }
+
+    for (; size >= 16; bytes += 16, size -= 16)
+        mixBlock(bytes);
+
+    std::memcpy(pending.data(), bytes, size);
+    numPending = size;
+}
+
+std::array<std::uint64_t, 2> ContentHash::finish() noexcept
+{
+    std::array<std::uint64_t, 2> k {};
+    std::memcpy(k.data(), pending.data(), numPending);
+    if (numPending > 8)
+        h2 ^= rotl(k[1] * c2, 33) * c1;
+    if (numPending > 0)
+        h1 ^= rotl(k[0] * c1, 31) * c2;
+
+    h1 ^= length;
+    h2 ^= length;
+    h1 += h2;
+    h2 += h1;
+    h1 = mix(h1);
+    h2 = mix(h2);
+    h1 += h2;
+    h2 += h1;
+    return { h1, h2 };
+}
+
+std::uint64_t ContentHash::mix(std::uint64_t k) noexcept
+{
+    k ^= k >> 33;
+    k *= 0xff51afd7ed558ccdull;
+    k ^= k >> 33;
+    k *= 0xc4ceb9fe1a85ec53ull;
+    k ^= k >> 33;
+    return k;
+}
+
+void ContentHash::mixBlock(const std::uint8_t* block) noexcept
+{
+    std::uint64_t k1, k2;
+    std::memcpy(&k1, block, 8);
+    std::memcpy(&k2, block + 8, 8);
+
+    h1 ^= rotl(k1 * c1, 31) * c2;
+    h1 = rotl(h1, 27) + h2;
+    h1 = h1 * 5 + 0x52dce729;
+
+    h2 ^= rotl(k2 * c2, 33) * c1;
+    h2 = rotl(h2, 31) + h1;
+    h2 = h2 * 5 + 0x38495ab5;
+}
+
+//==============================================================================
+OnsetCache::OnsetCache(const juce::File& cacheDirectory, juce::int64 maxBytesToUse)
+    : directory(cacheDirectory), maxBytes(std::max<juce::int64>(0, maxBytesToUse))
+{
+    directory.createDirectory();
+    for (const auto& file : findEntries(directory))
+    {
+        totalBytes += file.getSize();
+        ++numEntries;
+    }
+}
+
+juce::File OnsetCache::getDefaultDirectory()
+{
+    return juce::File::getSpecialLocation(juce::File::userApplicationDataDirectory).getChildFile("AudioToMidiBeat").getChildFile("OnsetCache");
+}
+
+juce::File OnsetCache::getEntryFile(const juce::String& key) const
+{
+    return directory.getChildFile(key + kEntryExtension);
+}
+
+juce::String OnsetCache::makeKey(const juce::File& audioFile, const BeatDetector::Params& params, int blockSize, int numThreads)
+{
+    const auto startTicks = juce::Time::getHighResolutionTicks();
+
+    juce::FileInputStream stream(audioFile);
+    if (!stream.openedOk())
+        return {};
+
+    ContentHash hash;
+    std::vector<char> buffer(kHashReadBytes);
+    for (;;)
+    {
+        const auto numRead = stream.read(buffer.data(), static_cast<int>(buffer.size()));
+        if (numRead <= 0)
+            break;
+        hash.add(buffer.data(), static_cast<size_t>(numRead));
+    }
+
+    hash.addValue(params.sensitivity);
+    hash.addValue(params.minGapMs);
+    hash.addValue(static_cast<std::int32_t>(params.focusLow ? 1 : 0));
+    hash.addValue(params.lookaheadMs);
+    hash.addValue(static_cast<std::int32_t>(blockSize));
+    hash.addValue(static_cast<std::int32_t>(std::max(1, numThreads)));
+    hash.addValue(static_cast<std::int32_t>(detectorVersion));
+
+    const auto digest = hash.finish();
+    hashTicks += juce::Time::getHighResolutionTicks() - startTicks;
+    return juce::String::toHexString(static_cast<juce::int64>(digest[0])).paddedLeft('0', 16)
+         + juce::String::toHexString(static_cast<juce::int64>(digest[1])).paddedLeft('0', 16);
+}
+
+bool OnsetCache::lookup(const juce::String& key, Entry& entry)
+{
+    const auto file = getEntryFile(key);
+    juce::MemoryBlock data;
+    if (key.isEmpty() || !file.loadFileAsData(data))
+    {
+        ++misses;
+        return false;
+    }
+
+    juce::MemoryInputStream stream(data, false);
+    const bool headerOk = stream.readInt() == kEntryMagic && stream.readInt() == kEntryFormat;
+    entry.sampleRate = stream.readDouble();
+    entry.numSamples = stream.readInt64();
+    const auto count = stream.readInt();
+
+    // A truncated or foreign file counts as a miss and is overwritten by the next store.
+    if (!headerOk || count < 0 || stream.getNumBytesRemaining() != static_cast<juce::int64>(count) * 12)
+    {
+        ++misses;
+        return false;
+    }
+
+    entry.onsets.resize(static_cast<size_t>(count));
+    for (auto& onset : entry.onsets)
+    {
+        onset.samplePosition = stream.readInt64();
+        onset.strength = stream.readFloat();
+    }
+
+    file.setLastModificationTime(juce::Time::getCurrentTime());
+    ++hits;
+    return true;
+}
+
+void OnsetCache::store(const juce::String& key, const Entry& entry)
+{
+    if (key.isEmpty())
+        return;
+
+    juce::MemoryOutputStream stream;
+    stream.writeInt(kEntryMagic);
+    stream.writeInt(kEntryFormat);
+    stream.writeDouble(entry.sampleRate);
+    stream.writeInt64(entry.numSamples);
+    stream.writeInt(static_cast<int>(entry.onsets.size()));
+    for (const auto& onset : entry.onsets)
+    {
+        stream.writeInt64(onset.samplePosition);
+        stream.writeFloat(onset.strength);
+    }
+
+    // Readers in other threads or processes only ever see a complete entry. Every store writes
+    // its own randomly named temporary file, which the TemporaryFile deletes if the rename fails;
+    // its .tmp extension keeps it out of the entry scan.
+    const auto file = getEntryFile(key);
+    const auto previousSize = file.getSize();
+    const juce::TemporaryFile temporary(file.withFileExtension(".tmp"));
+    if (!temporary.getFile().replaceWithData(stream.getData(), stream.getDataSize()) || !temporary.getFile().moveFileTo(file))
+        return;
+
+    ++stores;
+    {
+        const std::lock_guard<std::mutex> lock(sizeLock);
+        totalBytes += static_cast<juce::int64>(stream.getDataSize()) - previousSize;
+        if (previousSize == 0)
+            ++numEntries;
+    }
+
+    evictLeastRecentlyUsed();
+}
+
+void OnsetCache::evictLeastRecentlyUsed()
+{
+    const std::lock_guard<std::mutex> lock(sizeLock);
+    if (totalBytes <= maxBytes)
+        return;
+
+    // Other processes may have added or removed entries since the last scan.
+    auto entries = findEntries(directory);
+    std::sort(entries.begin(), entries.end(), [](const juce::File& a, const juce::File& b)
+    {
+        return a.getLastModificationTime() < b.getLastModificationTime();
+    });
+
+    totalBytes = 0;
+    for (const auto& file : entries)
+        totalBytes += file.getSize();
+    numEntries = entries.size();
+
+    for (const auto& file : entries)
+    {
+        if (totalBytes <= maxBytes)
+            break;
+
+        const auto size = file.getSize();
+        if (file.deleteFile())
+        {
+            totalBytes -= size;
+            --numEntries;
+            ++evictions;
+        }
+    }
+}
+
+OnsetCache::Statistics OnsetCache::getStatistics() const
+{
+    Statistics statistics;
+    statistics.hits = hits.load();
+    statistics.misses = misses.load();
+    statistics.stores = stores.load();
+    statistics.evictions = evictions.load();
+    statistics.hashSeconds = juce::Time::highResolutionTicksToSeconds(hashTicks.load());
+
+    const std::lock_guard<std::mutex> lock(sizeLock);
+    statistics.entries = numEntries;
+    statistics.bytes = totalBytes;
+    return statistics;
+}
+
+} // namespace audiotomidi
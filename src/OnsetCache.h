@@ -0,0 +1,116 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+
+#include <juce_core/juce_core.h>
+
+#include "BeatDetector.h"
+#include "ChunkedAnalysis.h"
+
+namespace audiotomidi {
+
+// MurmurHash3 x64_128 with seed 0, fed incrementally: any split of the same bytes across add()
+// calls gives the same digest. Not cryptographic, but an accidental collision between two audio
+// files is far less likely than a disk error.
+class ContentHash
+{
+public:
+    void add(const void* data, size_t size) noexcept;
+
+    template <typename T>
+    void addValue(T value) noexcept
+    {
+        add(&value, sizeof(T));
+    }
+
+    // h1 and h2 of the reference implementation.
+    std::array<std::uint64_t, 2> finish() noexcept;
+
+private:
+    static constexpr std::uint64_t c1 = 0x87c37b91114253d5ull;
+    static constexpr std::uint64_t c2 = 0x4cf5ad432745937full;
+
+    static std::uint64_t rotl(std::uint64_t x, int r) noexcept { return (x << r) | (x >> (64 - r)); }
+    static std::uint64_t mix(std::uint64_t k) noexcept;
+    void mixBlock(const std::uint8_t* block) noexcept;
+
+    std::uint64_t h1 = 0;
+    std::uint64_t h2 = 0;
+    std::uint64_t length = 0;
+    std::array<std::uint8_t, 16> pending {};
+    size_t numPending = 0;
+};
+
+// On-disk cache of analysed onset lists, so a batch run that only changes MIDI settings (note,
+// channel, velocity, note length, retrigger) skips decoding and detection. An entry is keyed by
+// a 128-bit hash of the audio file's bytes together with every detection parameter, the block
+// size, the analysis thread count and detectorVersion, and holds the onsets plus the file's sample rate and
+// length, which is all MidiEngine needs to render the MIDI again.
+//
+// Entries are small files in one directory, written to a temporary name and renamed into place,
+// so several processes can share a cache. A hit refreshes the entry's modification time; when the
+// cache grows past its size limit the least recently used entries are deleted. All methods are
+// thread-safe.
+class OnsetCache
+{
+public:
+    // Bump whenever BeatDetector, the downmix or the chunked analysis change the onsets they
+    // report, so entries from older builds are no longer used.
+    static constexpr int detectorVersion = 2;
+
+    OnsetCache(const juce::File& directory, juce::int64 maxBytes);
+
+    static juce::File getDefaultDirectory();
+
+    struct Entry
+    {
+        double sampleRate = 0.0;
+        juce::int64 numSamples = 0;
+        OnsetList onsets;
+    };
+
+    // Hashes the audio file's bytes (not the decoded audio) with the detection settings. Returns
+    // an empty key when the file cannot be read.
+    juce::String makeKey(const juce::File& audioFile, const BeatDetector::Params& params, int blockSize, int numThreads);
+
+    bool lookup(const juce::String& key, Entry& entry);
+    void store(const juce::String& key, const Entry& entry);
+
+    struct Statistics
+    {
+        int hits = 0;
+        int misses = 0;
+        int stores = 0;
+        int evictions = 0;
+        int entries = 0;
+        juce::int64 bytes = 0;
+        double hashSeconds = 0.0;
+
+        double getHitRate() const noexcept { return hits + misses > 0 ? static_cast<double>(hits) / (hits + misses) : 0.0; }
+    };
+
+    Statistics getStatistics() const;
+
+private:
+    juce::File getEntryFile(const juce::String& key) const;
+    void evictLeastRecentlyUsed();
+
+    const juce::File directory;
+    const juce::int64 maxBytes;
+
+    std::atomic<int> hits { 0 };
+    std::atomic<int> misses { 0 };
+    std::atomic<int> stores { 0 };
+    std::atomic<int> evictions { 0 };
+    std::atomic<juce::int64> hashTicks { 0 };
+
+    // Size of the directory's entries, scanned at construction and kept up to date from here.
+    mutable std::mutex sizeLock;
+    juce::int64 totalBytes = 0;
+    int numEntries = 0;
+};
+
+} // namespace audiotomidi
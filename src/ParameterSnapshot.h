@@ -0,0 +1,28 @@
+#pragma once
+
+#include <array>
+
+#include "BeatDetector.h"
+#include "DetectorBank.h"
+#include "MidiEngine.h"
+#include "TripleBuffer.h"
+
+namespace audiotomidi {
+
+// Every setting the audio thread needs for one block, read once at the top of the callback so a
+// block never mixes old and new values.
+struct ParameterSnapshot
+{
+    BeatDetector::Params detector;
+    MidiEngineParams midi;
+    DetectorEngine engine = DetectorEngine::Envelope;
+    bool multiInput = false;
+    std::array<int, DetectorBank::maxLanes> laneNotes {};
+    bool midiClock = false;
+    bool running = true;
+};
+
+// The message thread publishes snapshots and the audio thread reads the latest one per block.
+using ParameterStore = TripleBuffer<ParameterSnapshot>;
+
+} // namespace audiotomidi
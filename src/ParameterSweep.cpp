@@ -0,0 +1,133 @@
+#include "ParameterSweep.h"
+
+#include <algorithm>
+#include <limits>
+#include <numeric>
+
+namespace audiotomidi {
+
+void ThresholdSweep::prepare(double sampleRate, bool focusLowToUse, const std::vector<float>& sensitivities)
+{
+    reference.prepare(sampleRate);
+    focusLow = focusLowToUse;
+
+    const int factor = reference.getDecimationFactor();
+    decimating = focusLow && factor > 1;
+    decimator.prepare(decimating ? factor : 1);
+    coefficients = BeatDetector::makeCoefficients(decimating ? reference.getSampleRate() / factor : reference.getSampleRate());
+    state = {};
+    position = 0;
+
+    std::vector<size_t> order(sensitivities.size());
+    std::iota(order.begin(), order.end(), size_t { 0 });
+    std::stable_sort(order.begin(), order.end(), [&sensitivities](size_t a, size_t b)
+    {
+        return BeatDetector::getThresholdLift(sensitivities[a]) < BeatDetector::getThresholdLift(sensitivities[b]);
+    });
+
+    lifts.resize(order.size());
+    liftForSensitivity.resize(order.size());
+    for (size_t k = 0; k < order.size(); ++k)
+    {
+        lifts[k] = BeatDetector::getThresholdLift(sensitivities[order[k]]);
+        liftForSensitivity[order[k]] = k;
+    }
+
+    edges.assign(lifts.size(), {});
+    numAbove = 0;
+}
+
+void ThresholdSweep::recordStep(std::int64_t stepPosition, float envelope, float noiseFloor)
+{
+    // The same comparison RefractoryGate makes against AdaptiveNoiseFloor's threshold.
+    const auto isAbove = [&](size_t k) { return envelope >= std::max(BeatDetector::minThreshold, noiseFloor + lifts[k]); };
+
+    if (numAbove < lifts.size() && isAbove(numAbove))
+    {
+        do
+        {
+            edges[numAbove].push_back({ stepPosition, envelope, noiseFloor });
+            ++numAbove;
+        } while (numAbove < lifts.size() && isAbove(numAbove));
+    }
+    else
+    {
+        while (numAbove > 0 && !isAbove(numAbove - 1))
+            --numAbove;
+    }
+}
+
+template <typename Prefilter, bool decimated>
+void ThresholdSweep::processStages(const float* monoSamples, int numSamples)
+{
+    // With no lift and no minimum the threshold policy's output is the noise floor itself.
+    DetectorSettings settings;
+    settings.minThreshold = std::numeric_limits<float>::lowest();
+
+    Prefilter prefilter(coefficients, state);
+    RectifiedOnePole follower(coefficients, state);
+    AdaptiveNoiseFloor noiseFloor(coefficients, state, settings);
+
+    for (int i = 0; i < numSamples; ++i)
+    {
+        float x = monoSamples[i];
+        if constexpr (decimated)
+            if (!decimator.push(monoSamples[i], x))
+                continue;
+
+        const float envelope = follower.process(prefilter.process(x));
+        recordStep(position + i, envelope, noiseFloor.process(envelope));
+    }
+
+    prefilter.store(state);
+    follower.store(state);
+    noiseFloor.store(state);
+    position += numSamples;
+}
+
+void ThresholdSweep::process(const float* monoSamples, int numSamples)
+{
+    if (decimating)
+        processStages<OnePoleLowPass, true>(monoSamples, numSamples);
+    else if (focusLow)
+        processStages<OnePoleLowPass, false>(monoSamples, numSamples);
+    else
+        processStages<PassThrough, false>(monoSamples, numSamples);
+}
+
+OnsetList ThresholdSweep::getOnsets(size_t sensitivityIndex, float minGapMs) const
+{
+    const auto k = liftForSensitivity[sensitivityIndex];
+    const float lift = lifts[k];
+
+    BeatDetector::Params params;
+    params.minGapMs = minGapMs;
+    const auto gapSamples = static_cast<std::int64_t>(reference.getGapSamples(params));
+
+    // A reset detector's gate counts as if it had triggered a second before the first sample,
+    // and every step it takes ends at the input sample it is reported on.
+    auto lastTrigger = -1 - static_cast<std::int64_t>(static_cast<int>(reference.getSampleRate()));
+
+    OnsetList onsets;
+    for (const auto& edge : edges[k])
+    {
+        if (edge.position - lastTrigger < gapSamples)
+            continue;
+
+        const float threshold = std::max(BeatDetector::minThreshold, edge.noiseFloor + lift);
+        onsets.push_back({ edge.position, std::clamp((edge.envelope - threshold) * 8.0f, 0.0f, 1.0f) });
+        lastTrigger = edge.position;
+    }
+
+    return onsets;
+}
+
+size_t ThresholdSweep::getNumEdges() const noexcept
+{
+    size_t total = 0;
+    for (const auto& liftEdges : edges)
+        total += liftEdges.size();
+    return total;
+}
+
+} // namespace audiotomidi
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "BeatDetector.h"
+#include "ChunkedAnalysis.h"
+
+namespace audiotomidi {
+
+// Evaluates the envelope detector for many sensitivity and minimum-gap settings in one pass over
+// the audio. The filter, envelope and noise-floor recurrences do not depend on either setting,
+// so they run once; sensitivity only lifts the threshold above the noise floor and the minimum
+// gap only gates the rising edges through it.
+//
+// Because a larger lift can only raise the threshold, the settings whose threshold the envelope
+// is above always form a prefix of the lifts in ascending order. Each detector step moves the
+// length of that prefix, usually by nothing, and records a rising edge for every lift it grows
+// past. getOnsets() then walks one lift's edges with the refractory gate. Edges are rare, so a
+// large grid costs little more than a single detector pass, and the onsets are bit-identical to
+// BeatDetector's with lookahead off.
+class ThresholdSweep
+{
+public:
+    // Prepares a pass for one focusLow setting. At 88.2 kHz and above with focusLow on, the
+    // stages run behind the same decimator BeatDetector uses.
+    void prepare(double sampleRate, bool focusLow, const std::vector<float>& sensitivities);
+
+    // Feeds the next consecutive mono samples.
+    void process(const float* monoSamples, int numSamples);
+
+    // The onsets BeatDetector reports for sensitivities[sensitivityIndex] and minGapMs, with
+    // absolute sample positions.
+    OnsetList getOnsets(size_t sensitivityIndex, float minGapMs) const;
+
+    size_t getNumEdges() const noexcept;
+
+private:
+    template <typename Prefilter, bool decimated>
+    void processStages(const float* monoSamples, int numSamples);
+    void recordStep(std::int64_t stepPosition, float envelope, float noiseFloor);
+
+    struct Edge
+    {
+        std::int64_t position = 0;
+        float envelope = 0.0f;
+        float noiseFloor = 0.0f;
+    };
+
+    BeatDetector reference;
+    DetectorCoefficients coefficients;
+    DetectorState state;
+    PolyphaseDecimator decimator;
+    bool focusLow = true;
+    bool decimating = false;
+    std::int64_t position = 0;
+
+    // Lifts in ascending order, the sensitivity index each came from, and its rising edges.
+    std::vector<float> lifts;
+    std::vector<size_t> liftForSensitivity;
+    std::vector<std::vector<Edge>> edges;
+    size_t numAbove = 0;
+};
+
+} // namespace audiotomidi
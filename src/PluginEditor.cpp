@@ -11,9 +11,9 @@ void configureSlider(juce::Slider& slider, const juce::String& suffix)
 } // namespace
 
 AudioToMidiBeatAudioProcessorEditor::AudioToMidiBeatAudioProcessorEditor(AudioToMidiBeatAudioProcessor& p)
-    : AudioProcessorEditor(&p), audioProcessor(p)
+    : AudioProcessorEditor(&p), audioProcessor(p), telemetryView(p.getTelemetry())
 {
-    setSize(720, 440);
+    setSize(720, 780);
 
     titleLabel.setText("AudioToMidiBeat", juce::dontSendNotification);
     titleLabel.setJustificationType(juce::Justification::centredLeft);
@@ -26,6 +26,7 @@ AudioToMidiBeatAudioProcessorEditor::AudioToMidiBeatAudioProcessorEditor(AudioTo
 
     configureSlider(sensitivitySlider, "");
     configureSlider(minGapSlider, " ms");
+    configureSlider(lookaheadSlider, " ms");
     configureSlider(noteSlider, "");
     configureSlider(channelSlider, "");
     configureSlider(noteLengthSlider, " ms");
@@ -33,6 +34,7 @@ AudioToMidiBeatAudioProcessorEditor::AudioToMidiBeatAudioProcessorEditor(AudioTo
 
     sensitivitySlider.setName("Sensitivity");
     minGapSlider.setName("Min Gap");
+    lookaheadSlider.setName("Lookahead");
     noteSlider.setName("Note");
     channelSlider.setName("Channel");
     noteLengthSlider.setName("Note Len");
@@ -40,6 +42,7 @@ AudioToMidiBeatAudioProcessorEditor::AudioToMidiBeatAudioProcessorEditor(AudioTo
 
     addAndMakeVisible(sensitivitySlider);
     addAndMakeVisible(minGapSlider);
+    addAndMakeVisible(lookaheadSlider);
     addAndMakeVisible(noteSlider);
     addAndMakeVisible(channelSlider);
     addAndMakeVisible(noteLengthSlider);
@@ -52,6 +55,75 @@ AudioToMidiBeatAudioProcessorEditor::AudioToMidiBeatAudioProcessorEditor(AudioTo
     focusLowToggle.setButtonText("Focus Low (180Hz)");
     addAndMakeVisible(focusLowToggle);
 
+    multiInputToggle.setButtonText("Multi-Input (note per channel)");
+    addAndMakeVisible(multiInputToggle);
+
+    engineBox.addItem("Envelope", 1);
+    engineBox.addItem("Spectral Flux", 2);
+    engineBox.addItem("Neural", 3);
+    addAndMakeVisible(engineBox);
+
+    retriggerBox.addItem("Layer", 1);
+    retriggerBox.addItem("Cut", 2);
+    retriggerBox.addItem("Extend", 3);
+    addAndMakeVisible(retriggerBox);
+
+    engineCpuLabel.setText("CPU: -", juce::dontSendNotification);
+    addAndMakeVisible(engineCpuLabel);
+
+    midiClockToggle.setButtonText("Send MIDI Clock");
+    addAndMakeVisible(midiClockToggle);
+
+    tempoLabel.setText("Tempo: -", juce::dontSendNotification);
+    addAndMakeVisible(tempoLabel);
+
+    traceButton.setButtonText("Record Trace");
+    traceButton.onClick = [this]
+    {
+        auto& recorder = audioProcessor.getFlightRecorder();
+        if (recorder.isRecording())
+            recorder.stop();
+        else
+            recorder.start(juce::File::getSpecialLocation(juce::File::userDocumentsDirectory).getChildFile("AudioToMidiBeat").getChildFile("Traces"));
+    };
+    addAndMakeVisible(traceButton);
+
+    captureButton.setButtonText("Capture Input");
+    captureButton.onClick = [this]
+    {
+        auto& capture = audioProcessor.getInputCapture();
+        if (capture.isCapturing())
+            capture.stop();
+        else
+            capture.start(juce::File::getSpecialLocation(juce::File::userDocumentsDirectory).getChildFile("AudioToMidiBeat").getChildFile("Captures"));
+    };
+    addAndMakeVisible(captureButton);
+
+    samplePlayerToggle.setButtonText("Sample Player");
+    addAndMakeVisible(samplePlayerToggle);
+
+    loadSamplesButton.setButtonText("Load Samples...");
+    loadSamplesButton.onClick = [this]
+    {
+        sampleFolderChooser = std::make_unique<juce::FileChooser>("Choose a folder of drum samples", audioProcessor.getDrumSampler().getFolder());
+        sampleFolderChooser->launchAsync(juce::FileBrowserComponent::openMode | juce::FileBrowserComponent::canSelectDirectories,
+                                         [this](const juce::FileChooser& chooser)
+                                         {
+                                             const auto folder = chooser.getResult();
+                                             if (folder.isDirectory())
+                                                 audioProcessor.loadSampleFolder(folder);
+                                         });
+    };
+    addAndMakeVisible(loadSamplesButton);
+
+    sampleGainSlider.setSliderStyle(juce::Slider::LinearHorizontal);
+    sampleGainSlider.setTextBoxStyle(juce::Slider::TextBoxRight, false, 72, 20);
+    sampleGainSlider.setTextValueSuffix(" dB");
+    addAndMakeVisible(sampleGainSlider);
+
+    sampleStatusLabel.setText("No samples", juce::dontSendNotification);
+    addAndMakeVisible(sampleStatusLabel);
+
     startStopButton.onClick = [this]
     {
         running = !running;
@@ -68,15 +140,24 @@ AudioToMidiBeatAudioProcessorEditor::AudioToMidiBeatAudioProcessorEditor(AudioTo
     triggerLabel.setJustificationType(juce::Justification::centred);
     addAndMakeVisible(triggerLabel);
 
+    addAndMakeVisible(telemetryView);
+
     auto& apvts = audioProcessor.getValueTreeState();
     sensitivityAttachment = std::make_unique<SliderAttachment>(apvts, paramids::sensitivity, sensitivitySlider);
     minGapAttachment = std::make_unique<SliderAttachment>(apvts, paramids::minGapMs, minGapSlider);
+    lookaheadAttachment = std::make_unique<SliderAttachment>(apvts, paramids::lookaheadMs, lookaheadSlider);
     noteAttachment = std::make_unique<SliderAttachment>(apvts, paramids::noteNumber, noteSlider);
     channelAttachment = std::make_unique<SliderAttachment>(apvts, paramids::midiChannel, channelSlider);
     noteLengthAttachment = std::make_unique<SliderAttachment>(apvts, paramids::noteLengthMs, noteLengthSlider);
     fixedVelocityAttachment = std::make_unique<SliderAttachment>(apvts, paramids::fixedVelocity, fixedVelocitySlider);
     velocityModeAttachment = std::make_unique<ComboAttachment>(apvts, paramids::velocityMode, velocityModeBox);
     focusLowAttachment = std::make_unique<ButtonAttachment>(apvts, paramids::focusLow, focusLowToggle);
+    multiInputAttachment = std::make_unique<ButtonAttachment>(apvts, paramids::multiInput, multiInputToggle);
+    engineAttachment = std::make_unique<ComboAttachment>(apvts, paramids::detectorEngine, engineBox);
+    retriggerAttachment = std::make_unique<ComboAttachment>(apvts, paramids::retriggerPolicy, retriggerBox);
+    midiClockAttachment = std::make_unique<ButtonAttachment>(apvts, paramids::midiClock, midiClockToggle);
+    samplePlayerAttachment = std::make_unique<ButtonAttachment>(apvts, paramids::samplePlayer, samplePlayerToggle);
+    sampleGainAttachment = std::make_unique<SliderAttachment>(apvts, paramids::samplePlayerGainDb, sampleGainSlider);
 
     startTimerHz(30);
 }
@@ -90,7 +171,7 @@ void AudioToMidiBeatAudioProcessorEditor::paint(juce::Graphics& g)
     g.fillRoundedRectangle(getLocalBounds().reduced(12).toFloat(), 14.0f);
 
     g.setColour(juce::Colours::white.withAlpha(0.72f));
-    for (auto* slider : std::array<juce::Slider*, 6> { &sensitivitySlider, &minGapSlider, &noteSlider, &channelSlider, &noteLengthSlider, &fixedVelocitySlider })
+    for (auto* slider : std::array<juce::Slider*, 7> { &sensitivitySlider, &minGapSlider, &lookaheadSlider, &noteSlider, &channelSlider, &noteLengthSlider, &fixedVelocitySlider })
     {
         const auto bounds = slider->getBounds().translated(0, -18);
         g.drawFittedText(slider->getName(), bounds, juce::Justification::centred, 1);
@@ -106,10 +187,11 @@ void AudioToMidiBeatAudioProcessorEditor::resized()
     modeLabel.setBounds(header);
 
     auto topControls = area.removeFromTop(170);
-    auto cellW = topControls.getWidth() / 3;
+    auto cellW = topControls.getWidth() / 4;
 
     sensitivitySlider.setBounds(topControls.removeFromLeft(cellW).reduced(6));
     minGapSlider.setBounds(topControls.removeFromLeft(cellW).reduced(6));
+    lookaheadSlider.setBounds(topControls.removeFromLeft(cellW).reduced(6));
     noteSlider.setBounds(topControls.reduced(6));
 
     auto midControls = area.removeFromTop(170);
@@ -125,6 +207,26 @@ void AudioToMidiBeatAudioProcessorEditor::resized()
     startStopButton.setBounds(footer.removeFromLeft(110).reduced(2));
     levelLabel.setBounds(footer.removeFromLeft(120).reduced(2));
     triggerLabel.setBounds(footer.removeFromLeft(90).reduced(2));
+
+    auto options = area.removeFromTop(40);
+    multiInputToggle.setBounds(options.removeFromLeft(240).reduced(2));
+    engineBox.setBounds(options.removeFromLeft(160).reduced(2));
+    retriggerBox.setBounds(options.removeFromLeft(100).reduced(2));
+    engineCpuLabel.setBounds(options.reduced(2));
+
+    auto tempoRow = area.removeFromTop(40);
+    midiClockToggle.setBounds(tempoRow.removeFromLeft(240).reduced(2));
+    captureButton.setBounds(tempoRow.removeFromRight(130).reduced(2));
+    traceButton.setBounds(tempoRow.removeFromRight(130).reduced(2));
+    tempoLabel.setBounds(tempoRow.reduced(2));
+
+    auto sampleRow = area.removeFromTop(40);
+    samplePlayerToggle.setBounds(sampleRow.removeFromLeft(140).reduced(2));
+    loadSamplesButton.setBounds(sampleRow.removeFromLeft(130).reduced(2));
+    sampleGainSlider.setBounds(sampleRow.removeFromLeft(180).reduced(2));
+    sampleStatusLabel.setBounds(sampleRow.reduced(2));
+
+    telemetryView.setBounds(area.reduced(2));
 }
 
 void AudioToMidiBeatAudioProcessorEditor::timerCallback()
@@ -132,6 +234,38 @@ void AudioToMidiBeatAudioProcessorEditor::timerCallback()
     const auto level = audioProcessor.getInputLevel();
     levelLabel.setText("Input: " + juce::String(static_cast<int>(juce::jlimit(0.0f, 1.0f, level) * 100.0f)) + "%", juce::dontSendNotification);
 
+    auto formatLoad = [this](audiotomidi::DetectorEngine engine)
+    {
+        const auto load = audioProcessor.getEngineCpuLoad(engine);
+        return load < 0.0f ? juce::String("-") : juce::String(load * 100.0f, 2) + "%";
+    };
+    engineCpuLabel.setText("CPU  Env " + formatLoad(audiotomidi::DetectorEngine::Envelope)
+                               + "  |  Flux " + formatLoad(audiotomidi::DetectorEngine::SpectralFlux)
+                               + "  |  Neural " + formatLoad(audiotomidi::DetectorEngine::Neural),
+                           juce::dontSendNotification);
+
+    const auto bpm = audioProcessor.getTempoBpm();
+    tempoLabel.setText(bpm > 0.0f ? "Tempo: " + juce::String(bpm, 1) + " BPM  |  Confidence "
+                                        + juce::String(juce::roundToInt(audioProcessor.getTempoConfidence() * 100.0f)) + "%"
+                                  : juce::String("Tempo: -"),
+                       juce::dontSendNotification);
+
+    const auto& recorder = audioProcessor.getFlightRecorder();
+    traceButton.setButtonText(recorder.isRecording() ? "Stop Trace" : "Record Trace");
+    traceButton.setTooltip(recorder.isRecording() ? recorder.getTraceFile().getFullPathName() : juce::String());
+
+    const auto& capture = audioProcessor.getInputCapture();
+    captureButton.setButtonText(capture.isCapturing() ? "Stop Capture" : "Capture Input");
+    captureButton.setTooltip(capture.isCapturing() ? capture.getCaptureFile().getFullPathName() : juce::String());
+
+    const auto& sampler = audioProcessor.getDrumSampler();
+    const auto sampleStatus = sampler.getStatus();
+    sampleStatusLabel.setText(sampler.isLoading() ? juce::String("Loading...")
+                                                  : (sampleStatus.isNotEmpty() ? sampleStatus : juce::String("No samples"))
+                                                        + "  |  " + juce::String(sampler.getNumActiveVoices()) + " voices",
+                              juce::dontSendNotification);
+    sampleStatusLabel.setTooltip(sampler.getFolder().getFullPathName());
+
     if (audioProcessor.consumeTriggerFlash())
         triggerFrames = 4;
 
@@ -149,4 +283,5 @@ void AudioToMidiBeatAudioProcessorEditor::timerCallback()
         triggerLabel.setColour(juce::Label::backgroundColourId, juce::Colours::dimgrey);
 
     triggerLabel.repaint();
+    telemetryView.repaint();
 }
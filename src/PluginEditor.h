@@ -6,6 +6,7 @@
 #include <juce_gui_extra/juce_gui_extra.h>
 
 #include "PluginProcessor.h"
+#include "TelemetryView.h"
 
 class AudioToMidiBeatAudioProcessorEditor : public juce::AudioProcessorEditor,
                                             private juce::Timer
@@ -27,6 +28,7 @@ private:
 
     juce::Slider sensitivitySlider;
     juce::Slider minGapSlider;
+    juce::Slider lookaheadSlider;
     juce::Slider noteSlider;
     juce::Slider channelSlider;
     juce::Slider noteLengthSlider;
@@ -34,12 +36,27 @@ private:
 
     juce::ComboBox velocityModeBox;
     juce::ToggleButton focusLowToggle;
+    juce::ToggleButton multiInputToggle;
+    juce::ComboBox engineBox;
+    juce::ComboBox retriggerBox;
+    juce::Label engineCpuLabel;
+    juce::ToggleButton midiClockToggle;
+    juce::Label tempoLabel;
+    juce::TextButton traceButton;
+    juce::TextButton captureButton;
+    juce::ToggleButton samplePlayerToggle;
+    juce::TextButton loadSamplesButton;
+    juce::Slider sampleGainSlider;
+    juce::Label sampleStatusLabel;
+    std::unique_ptr<juce::FileChooser> sampleFolderChooser;
 
     juce::TextButton startStopButton { "Stop" };
 
     juce::Label levelLabel;
     juce::Label triggerLabel;
 
+    audiotomidi::TelemetryView telemetryView;
+
     bool running = true;
     int triggerFrames = 0;
 
@@ -49,12 +66,19 @@ private:
 
     std::unique_ptr<SliderAttachment> sensitivityAttachment;
     std::unique_ptr<SliderAttachment> minGapAttachment;
+    std::unique_ptr<SliderAttachment> lookaheadAttachment;
     std::unique_ptr<SliderAttachment> noteAttachment;
     std::unique_ptr<SliderAttachment> channelAttachment;
     std::unique_ptr<SliderAttachment> noteLengthAttachment;
     std::unique_ptr<SliderAttachment> fixedVelocityAttachment;
     std::unique_ptr<ComboAttachment> velocityModeAttachment;
     std::unique_ptr<ButtonAttachment> focusLowAttachment;
+    std::unique_ptr<ButtonAttachment> multiInputAttachment;
+    std::unique_ptr<ComboAttachment> engineAttachment;
+    std::unique_ptr<ComboAttachment> retriggerAttachment;
+    std::unique_ptr<ButtonAttachment> midiClockAttachment;
+    std::unique_ptr<ButtonAttachment> samplePlayerAttachment;
+    std::unique_ptr<SliderAttachment> sampleGainAttachment;
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(AudioToMidiBeatAudioProcessorEditor)
 };
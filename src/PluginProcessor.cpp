@@ -2,14 +2,43 @@
 
 #include "PluginEditor.h"
 
+#include "DownmixKernel.h"
+
+namespace
+{
+// State property holding the sample player's folder; it is not a parameter, so hosts never automate it.
+constexpr auto kSampleFolderProperty = "sampleFolder";
+} // namespace
+
 AudioToMidiBeatAudioProcessor::AudioToMidiBeatAudioProcessor()
     : AudioProcessor(BusesProperties().withInput("Input", juce::AudioChannelSet::stereo(), true)
                                      .withOutput("Output", juce::AudioChannelSet::stereo(), true)),
       apvts(*this, nullptr, "PARAMETERS", createParameterLayout())
 {
+    rawParams.sensitivity = apvts.getRawParameterValue(paramids::sensitivity);
+    rawParams.minGapMs = apvts.getRawParameterValue(paramids::minGapMs);
+    rawParams.focusLow = apvts.getRawParameterValue(paramids::focusLow);
+    rawParams.lookaheadMs = apvts.getRawParameterValue(paramids::lookaheadMs);
+    rawParams.noteNumber = apvts.getRawParameterValue(paramids::noteNumber);
+    rawParams.midiChannel = apvts.getRawParameterValue(paramids::midiChannel);
+    rawParams.noteLengthMs = apvts.getRawParameterValue(paramids::noteLengthMs);
+    rawParams.velocityMode = apvts.getRawParameterValue(paramids::velocityMode);
+    rawParams.fixedVelocity = apvts.getRawParameterValue(paramids::fixedVelocity);
+    rawParams.multiInput = apvts.getRawParameterValue(paramids::multiInput);
+    rawParams.detectorEngine = apvts.getRawParameterValue(paramids::detectorEngine);
+    rawParams.retriggerPolicy = apvts.getRawParameterValue(paramids::retriggerPolicy);
+    rawParams.midiClock = apvts.getRawParameterValue(paramids::midiClock);
+    rawParams.samplePlayer = apvts.getRawParameterValue(paramids::samplePlayer);
+    rawParams.samplePlayerGainDb = apvts.getRawParameterValue(paramids::samplePlayerGainDb);
+
+    for (int lane = 0; lane < audiotomidi::DetectorBank::maxLanes; ++lane)
+        rawParams.laneNotes[static_cast<size_t>(lane)] = apvts.getRawParameterValue(getLaneNoteParamId(lane));
 }
 
-AudioToMidiBeatAudioProcessor::~AudioToMidiBeatAudioProcessor() = default;
+AudioToMidiBeatAudioProcessor::~AudioToMidiBeatAudioProcessor()
+{
+    cancelPendingUpdate();
+}
 
 juce::AudioProcessorValueTreeState::ParameterLayout AudioToMidiBeatAudioProcessor::createParameterLayout()
 {
@@ -26,14 +55,56 @@ juce::AudioProcessorValueTreeState::ParameterLayout AudioToMidiBeatAudioProcesso
 
     params.push_back(std::make_unique<juce::AudioParameterInt>(paramids::fixedVelocity, "Fixed Velocity", 0, 127, 100));
     params.push_back(std::make_unique<juce::AudioParameterBool>(paramids::focusLow, "Focus Low", true));
+    params.push_back(std::make_unique<juce::AudioParameterBool>(paramids::multiInput, "Multi-Input", false));
+
+    juce::StringArray engineChoices { "Envelope", "Spectral Flux", "Neural" };
+    params.push_back(std::make_unique<juce::AudioParameterChoice>(paramids::detectorEngine, "Detector Engine", engineChoices, 0));
+
+    juce::StringArray retriggerChoices { "Layer", "Cut", "Extend" };
+    params.push_back(std::make_unique<juce::AudioParameterChoice>(paramids::retriggerPolicy, "Retrigger", retriggerChoices, 0));
+
+    params.push_back(std::make_unique<juce::AudioParameterBool>(paramids::midiClock, "MIDI Clock", false));
+    params.push_back(std::make_unique<juce::AudioParameterBool>(paramids::samplePlayer, "Sample Player", false));
+    params.push_back(std::make_unique<juce::AudioParameterFloat>(paramids::samplePlayerGainDb, "Sample Gain (dB)", -36.0f, 12.0f, 0.0f));
+
+    // Changing the lookahead changes the reported latency, which hosts should not see mid-playback.
+    params.push_back(std::make_unique<juce::AudioParameterFloat>(paramids::lookaheadMs, "Lookahead (ms)",
+                                                                 juce::NormalisableRange<float>(0.0f, audiotomidi::BeatDetector::maxLookaheadMs, 0.5f), 0.0f,
+                                                                 juce::AudioParameterFloatAttributes().withAutomatable(false)));
+
+    // General MIDI drum notes for a typical close-miked kit: kick, snare, hats, toms, cymbals.
+    constexpr std::array<int, audiotomidi::DetectorBank::maxLanes> defaultLaneNotes { 36, 38, 42, 46, 48, 47, 45, 43,
+                                                                                      49, 51, 57, 52, 55, 37, 39, 54 };
+    for (int lane = 0; lane < audiotomidi::DetectorBank::maxLanes; ++lane)
+        params.push_back(std::make_unique<juce::AudioParameterInt>(getLaneNoteParamId(lane),
+                                                                   "Input " + juce::String(lane + 1) + " Note",
+                                                                   0,
+                                                                   127,
+                                                                   defaultLaneNotes[static_cast<size_t>(lane)]));
 
     return { params.begin(), params.end() };
 }
 
+juce::String AudioToMidiBeatAudioProcessor::getLaneNoteParamId(int lane)
+{
+    return paramids::laneNotePrefix + juce::String(lane + 1);
+}
+
 void AudioToMidiBeatAudioProcessor::prepareToPlay(double sampleRate, int samplesPerBlock)
 {
-    detector.prepare(sampleRate);
-    midiEngine.prepare(sampleRate);
+    engine.prepare(sampleRate);
+    telemetry.prepare(sampleRate);
+    flightRecorder.prepare(sampleRate);
+    inputCapture.prepare(sampleRate);
+    drumSampler.prepare(sampleRate);
+    currentSampleRate = sampleRate;
+
+    for (auto& load : engineCpuLoad)
+        load.store(-1.0f, std::memory_order_relaxed);
+
+    // prepareToPlay runs off the audio thread, so the host hears about the latency right away.
+    engineLatency.store(engine.getLatencySamples(readParameters()), std::memory_order_relaxed);
+    setLatencySamples(engineLatency.load(std::memory_order_relaxed));
 
     monoBuffer.allocate(static_cast<size_t>(samplesPerBlock), true);
     monoBufferSize = samplesPerBlock;
@@ -41,8 +112,47 @@ void AudioToMidiBeatAudioProcessor::prepareToPlay(double sampleRate, int samples
 
 void AudioToMidiBeatAudioProcessor::releaseResources()
 {
-    midiEngine.reset();
-    detector.reset();
+    engine.reset();
+    drumSampler.reset();
+}
+
+void AudioToMidiBeatAudioProcessor::updateLatency(const audiotomidi::ParameterSnapshot& params)
+{
+    const int latency = engine.getLatencySamples(params);
+    if (engineLatency.exchange(latency, std::memory_order_relaxed) != latency)
+        triggerAsyncUpdate();
+}
+
+void AudioToMidiBeatAudioProcessor::handleAsyncUpdate()
+{
+    const int latency = engineLatency.load(std::memory_order_relaxed);
+    if (latency != getLatencySamples())
+        setLatencySamples(latency);
+}
+
+audiotomidi::ParameterSnapshot AudioToMidiBeatAudioProcessor::readParameters() const noexcept
+{
+    audiotomidi::ParameterSnapshot snapshot;
+    snapshot.detector.sensitivity = rawParams.sensitivity->load();
+    snapshot.detector.minGapMs = rawParams.minGapMs->load();
+    snapshot.detector.focusLow = rawParams.focusLow->load() >= 0.5f;
+    snapshot.detector.lookaheadMs = rawParams.lookaheadMs->load();
+
+    snapshot.midi.noteNumber = static_cast<int>(rawParams.noteNumber->load());
+    snapshot.midi.midiChannel = static_cast<int>(rawParams.midiChannel->load());
+    snapshot.midi.noteLengthMs = static_cast<int>(rawParams.noteLengthMs->load());
+    snapshot.midi.velocityMode = static_cast<int>(rawParams.velocityMode->load()) == 0 ? audiotomidi::VelocityMode::Fixed
+                                                                                       : audiotomidi::VelocityMode::Dynamic;
+    snapshot.midi.fixedVelocity = static_cast<int>(rawParams.fixedVelocity->load());
+    snapshot.midi.retrigger = static_cast<audiotomidi::RetriggerPolicy>(static_cast<int>(rawParams.retriggerPolicy->load()));
+
+    snapshot.engine = static_cast<audiotomidi::DetectorEngine>(static_cast<int>(rawParams.detectorEngine->load()));
+    snapshot.multiInput = rawParams.multiInput->load() >= 0.5f;
+    snapshot.midiClock = rawParams.midiClock->load() >= 0.5f;
+    for (size_t lane = 0; lane < snapshot.laneNotes.size(); ++lane)
+        snapshot.laneNotes[lane] = static_cast<int>(rawParams.laneNotes[lane]->load());
+
+    return snapshot;
 }
 
 bool AudioToMidiBeatAudioProcessor::isBusesLayoutSupported(const BusesLayout& layouts) const
@@ -56,6 +166,7 @@ bool AudioToMidiBeatAudioProcessor::isBusesLayoutSupported(const BusesLayout& la
 void AudioToMidiBeatAudioProcessor::processBlock(juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midiMessages)
 {
     juce::ScopedNoDenormals noDenormals;
+    telemetry.beginCallback();
 
     const auto totalNumInputChannels = getTotalNumInputChannels();
     const auto totalNumOutputChannels = getTotalNumOutputChannels();
@@ -70,42 +181,69 @@ void AudioToMidiBeatAudioProcessor::processBlock(juce::AudioBuffer<float>& buffe
         monoBufferSize = numSamples;
     }
 
-    float peak = 0.0f;
-    for (int s = 0; s < numSamples; ++s)
-    {
-        float mono = 0.0f;
-        for (int c = 0; c < totalNumInputChannels; ++c)
-            mono += buffer.getReadPointer(c)[s];
-
-        mono *= (totalNumInputChannels > 0 ? 1.0f / static_cast<float>(totalNumInputChannels) : 1.0f);
-        monoBuffer[s] = mono;
-        peak = std::max(peak, std::abs(mono));
-    }
+    const float peak = audiotomidi::downmixToMono(buffer.getArrayOfReadPointers(), totalNumInputChannels, monoBuffer.get(), numSamples);
 
     inputLevelAtomic.store(peak, std::memory_order_relaxed);
 
-    audiotomidi::BeatDetector::Params detParams;
-    detParams.sensitivity = apvts.getRawParameterValue(paramids::sensitivity)->load();
-    detParams.minGapMs = apvts.getRawParameterValue(paramids::minGapMs)->load();
-    detParams.focusLow = apvts.getRawParameterValue(paramids::focusLow)->load() >= 0.5f;
+    const auto params = readParameters();
+    updateLatency(params);
+    telemetry.endStage(audiotomidi::CallbackTelemetry::Stage::Downmix);
+
+    midiMessages.clear();
+
+    // A capture starts from a freshly reset engine, the state the replay starts from; the
+    // note-offs and Stop that ends the previous state are not part of the captured block.
+    int firstCapturedEvent = 0;
+    if (inputCapture.beginBlock())
+    {
+        engine.restart(midiMessages, 0);
+        firstCapturedEvent = midiMessages.getNumEvents();
+    }
 
     audiotomidi::BeatDetector::TriggerBuffer triggers;
-    detector.processBlock(monoBuffer.get(), numSamples, detParams, triggers);
+    engine.detect(monoBuffer.get(), buffer.getArrayOfReadPointers(), totalNumInputChannels, numSamples, peak, params, triggers);
+
+    const auto elapsed = telemetry.endStage(audiotomidi::CallbackTelemetry::Stage::Detection);
+    if (!params.multiInput)
+    {
+        const auto blockSeconds = static_cast<double>(numSamples) / currentSampleRate;
+        auto& load = engineCpuLoad[static_cast<size_t>(params.engine)];
+        const auto previous = load.load(std::memory_order_relaxed);
+        const auto current = static_cast<float>(elapsed / std::max(1.0e-9, blockSeconds));
+        load.store(previous < 0.0f ? current : previous + 0.05f * (current - previous), std::memory_order_relaxed);
+    }
+
+    const bool envelopeEngine = !params.multiInput && params.engine == audiotomidi::DetectorEngine::Envelope;
+    flightRecorder.recordBlock(numSamples, peak, envelopeEngine ? engine.getDetector().getNoiseFloor() : 0.0f, triggers);
 
     if (triggers.count > 0)
         triggerFlashAtomic.store(true, std::memory_order_relaxed);
 
-    audiotomidi::MidiEngineParams midiParams;
-    midiParams.noteNumber = static_cast<int>(apvts.getRawParameterValue(paramids::noteNumber)->load());
-    midiParams.midiChannel = static_cast<int>(apvts.getRawParameterValue(paramids::midiChannel)->load());
-    midiParams.noteLengthMs = static_cast<int>(apvts.getRawParameterValue(paramids::noteLengthMs)->load());
-    midiParams.velocityMode = static_cast<int>(apvts.getRawParameterValue(paramids::velocityMode)->load()) == 0
-                                ? audiotomidi::VelocityMode::Fixed
-                                : audiotomidi::VelocityMode::Dynamic;
-    midiParams.fixedVelocity = static_cast<int>(apvts.getRawParameterValue(paramids::fixedVelocity)->load());
-
-    midiMessages.clear();
-    midiEngine.process(triggers, midiMessages, numSamples, midiParams);
+    engine.generateMidi(triggers, midiMessages, numSamples, params);
+
+    const auto& tempoTracker = engine.getTempoTracker();
+    tempoBpmAtomic.store(static_cast<float>(tempoTracker.getBpm()), std::memory_order_relaxed);
+    tempoConfidenceAtomic.store(tempoTracker.getConfidence(), std::memory_order_relaxed);
+
+    // Multi-input mode reads the raw input channels; every other mode reads the downmix.
+    const float* monoChannel = monoBuffer.get();
+    inputCapture.captureBlock(params.multiInput ? buffer.getArrayOfReadPointers() : &monoChannel,
+                              params.multiInput ? totalNumInputChannels : 1,
+                              numSamples,
+                              peak,
+                              params,
+                              midiMessages,
+                              firstCapturedEvent);
+
+    // The player mixes into the output, on top of the passed-through input, so it runs after the
+    // input has been captured.
+    if (rawParams.samplePlayer->load() >= 0.5f)
+        drumSampler.process(triggers, buffer, numSamples, params.midi, juce::Decibels::decibelsToGain(rawParams.samplePlayerGainDb->load()));
+    else
+        drumSampler.skipBlock();
+
+    telemetry.endStage(audiotomidi::CallbackTelemetry::Stage::Midi);
+    telemetry.endCallback(numSamples);
 }
 
 juce::AudioProcessorEditor* AudioToMidiBeatAudioProcessor::createEditor() { return new AudioToMidiBeatAudioProcessorEditor(*this); }
@@ -134,7 +272,19 @@ void AudioToMidiBeatAudioProcessor::setStateInformation(const void* data, int si
 {
     std::unique_ptr<juce::XmlElement> xmlState(getXmlFromBinary(data, sizeInBytes));
     if (xmlState != nullptr && xmlState->hasTagName(apvts.state.getType()))
+    {
         apvts.replaceState(juce::ValueTree::fromXml(*xmlState));
+
+        const auto folder = apvts.state.getProperty(kSampleFolderProperty).toString();
+        if (folder.isNotEmpty() || drumSampler.getFolder() != juce::File())
+            drumSampler.loadFolder(folder.isNotEmpty() ? juce::File(folder) : juce::File());
+    }
+}
+
+void AudioToMidiBeatAudioProcessor::loadSampleFolder(const juce::File& folder)
+{
+    apvts.state.setProperty(kSampleFolderProperty, folder.getFullPathName(), nullptr);
+    drumSampler.loadFolder(folder);
 }
 
 bool AudioToMidiBeatAudioProcessor::consumeTriggerFlash() noexcept
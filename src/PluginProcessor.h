@@ -1,11 +1,16 @@
 #pragma once
 
+#include <array>
 #include <atomic>
 
 #include <juce_audio_processors/juce_audio_processors.h>
 
-#include "BeatDetector.h"
-#include "MidiEngine.h"
+#include "CallbackTelemetry.h"
+#include "DrumSampler.h"
+#include "FlightRecorder.h"
+#include "InputCapture.h"
+#include "ParameterSnapshot.h"
+#include "TriggerEngine.h"
 
 namespace paramids {
 static constexpr auto sensitivity = "sensitivity";
@@ -16,9 +21,18 @@ static constexpr auto noteLengthMs = "noteLengthMs";
 static constexpr auto velocityMode = "velocityMode";
 static constexpr auto fixedVelocity = "fixedVelocity";
 static constexpr auto focusLow = "focusLow";
+static constexpr auto multiInput = "multiInput";
+static constexpr auto detectorEngine = "detectorEngine";
+static constexpr auto retriggerPolicy = "retriggerPolicy";
+static constexpr auto lookaheadMs = "lookaheadMs";
+static constexpr auto midiClock = "midiClock";
+static constexpr auto samplePlayer = "samplePlayer";
+static constexpr auto samplePlayerGainDb = "samplePlayerGainDb";
+static constexpr auto laneNotePrefix = "laneNote";
 }
 
-class AudioToMidiBeatAudioProcessor : public juce::AudioProcessor
+class AudioToMidiBeatAudioProcessor : public juce::AudioProcessor,
+                                      private juce::AsyncUpdater
 {
 public:
     AudioToMidiBeatAudioProcessor();
@@ -51,18 +65,83 @@ public:
     float getInputLevel() const noexcept { return inputLevelAtomic.load(std::memory_order_relaxed); }
     bool consumeTriggerFlash() noexcept;
 
+    // Smoothed detector cost as a fraction of the block duration, per engine. An engine that has
+    // not run since prepareToPlay reports a negative value.
+    float getEngineCpuLoad(audiotomidi::DetectorEngine engine) const noexcept
+    {
+        return engineCpuLoad[static_cast<size_t>(engine)].load(std::memory_order_relaxed);
+    }
+
+    // Tracked tempo (0 while unknown) and the share of recent onsets that fit its beat grid.
+    float getTempoBpm() const noexcept { return tempoBpmAtomic.load(std::memory_order_relaxed); }
+    float getTempoConfidence() const noexcept { return tempoConfidenceAtomic.load(std::memory_order_relaxed); }
+
+    // Callback duration and load, timed on every block.
+    audiotomidi::CallbackTelemetry& getTelemetry() noexcept { return telemetry; }
+
+    // Records the detector's internals to disk while started from the editor.
+    audiotomidi::FlightRecorder& getFlightRecorder() noexcept { return flightRecorder; }
+
+    // Streams the engine's input, parameters and MIDI to disk for AudioToMidiBeatReplay.
+    audiotomidi::InputCapture& getInputCapture() noexcept { return inputCapture; }
+
+    // Plays one-shots on the output bus while the Sample Player parameter is on.
+    audiotomidi::DrumSampler& getDrumSampler() noexcept { return drumSampler; }
+
+    // Loads a sample folder into the player and stores its path in the plugin state.
+    void loadSampleFolder(const juce::File& folder);
+
     static juce::AudioProcessorValueTreeState::ParameterLayout createParameterLayout();
+    static juce::String getLaneNoteParamId(int lane);
 
 private:
     juce::AudioProcessorValueTreeState apvts;
-    audiotomidi::BeatDetector detector;
-    audiotomidi::MidiEngine midiEngine;
+    audiotomidi::TriggerEngine engine;
+    audiotomidi::CallbackTelemetry telemetry;
+    audiotomidi::FlightRecorder flightRecorder;
+    audiotomidi::InputCapture inputCapture;
+    audiotomidi::DrumSampler drumSampler;
+
+    // APVTS values are individually atomic; reading them all once per block through cached
+    // pointers gives the audio thread one consistent snapshot without string lookups.
+    struct RawParameters
+    {
+        std::atomic<float>* sensitivity = nullptr;
+        std::atomic<float>* minGapMs = nullptr;
+        std::atomic<float>* focusLow = nullptr;
+        std::atomic<float>* lookaheadMs = nullptr;
+        std::atomic<float>* noteNumber = nullptr;
+        std::atomic<float>* midiChannel = nullptr;
+        std::atomic<float>* noteLengthMs = nullptr;
+        std::atomic<float>* velocityMode = nullptr;
+        std::atomic<float>* fixedVelocity = nullptr;
+        std::atomic<float>* multiInput = nullptr;
+        std::atomic<float>* detectorEngine = nullptr;
+        std::atomic<float>* retriggerPolicy = nullptr;
+        std::atomic<float>* midiClock = nullptr;
+        std::atomic<float>* samplePlayer = nullptr;
+        std::atomic<float>* samplePlayerGainDb = nullptr;
+        std::array<std::atomic<float>*, audiotomidi::DetectorBank::maxLanes> laneNotes {};
+    } rawParams;
 
     juce::HeapBlock<float> monoBuffer;
     int monoBufferSize = 0;
 
     std::atomic<float> inputLevelAtomic { 0.0f };
     std::atomic<bool> triggerFlashAtomic { false };
+    std::array<std::atomic<float>, 3> engineCpuLoad {};
+    std::atomic<float> tempoBpmAtomic { 0.0f };
+    std::atomic<float> tempoConfidenceAtomic { 0.0f };
+    double currentSampleRate = 44100.0;
+
+    // The active detector's delay, written by the audio thread. setLatencySamples() makes the
+    // host re-query the processor, so a change is reported from the message thread.
+    std::atomic<int> engineLatency { 0 };
+
+    // Audio thread: queues a report to the host when the active detector's delay changes.
+    void updateLatency(const audiotomidi::ParameterSnapshot& params);
+    void handleAsyncUpdate() override;
+    audiotomidi::ParameterSnapshot readParameters() const noexcept;
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(AudioToMidiBeatAudioProcessor)
 };
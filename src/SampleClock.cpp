@@ -0,0 +1,65 @@
+#include "SampleClock.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace audiotomidi {
+
+namespace
+{
+constexpr double kPi = 3.14159265358979323846;
+
+// Observations further than this from the prediction mean the stream was interrupted.
+constexpr double kRelockMs = 20.0;
+
+// The measured rate may differ from the nominal one by this fraction (real crystals are within
+// a few hundred ppm).
+constexpr double kMaxRateDeviation = 0.01;
+} // namespace
+
+void SampleClock::prepare(double sampleRate, double bandwidthHz) noexcept
+{
+    nominalMsPerSample = 1000.0 / (sampleRate > 0.0 ? sampleRate : 44100.0);
+    bandwidth = bandwidthHz;
+    reset();
+}
+
+void SampleClock::reset() noexcept
+{
+    msPerSample = nominalMsPerSample;
+    anchorMs = 0.0;
+    anchorSample = 0;
+    locked = false;
+}
+
+double SampleClock::getTimeMs(std::int64_t samplePosition) const noexcept
+{
+    return anchorMs + static_cast<double>(samplePosition - anchorSample) * msPerSample;
+}
+
+void SampleClock::update(std::int64_t blockStartSample, int numSamples, double observedMs) noexcept
+{
+    const double predicted = getTimeMs(blockStartSample);
+    const double error = observedMs - predicted;
+
+    if (!locked || numSamples <= 0 || std::abs(error) > kRelockMs)
+    {
+        msPerSample = nominalMsPerSample;
+        anchorMs = observedMs;
+        anchorSample = blockStartSample;
+        locked = true;
+        return;
+    }
+
+    // Loop gains for a critically damped DLL whose update period is this block.
+    const double omega = 2.0 * kPi * bandwidth * 0.001 * static_cast<double>(numSamples) * nominalMsPerSample;
+    anchorMs = predicted + std::sqrt(2.0) * omega * error;
+    anchorSample = blockStartSample;
+
+    msPerSample += omega * omega * error / static_cast<double>(numSamples);
+    msPerSample = std::clamp(msPerSample,
+                             nominalMsPerSample * (1.0 - kMaxRateDeviation),
+                             nominalMsPerSample * (1.0 + kMaxRateDeviation));
+}
+
+} // namespace audiotomidi
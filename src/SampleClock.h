@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstdint>
+
+namespace audiotomidi {
+
+// Maps absolute sample positions to wall-clock milliseconds. Each audio block contributes one
+// noisy observation of when its first sample arrived; a second-order delay-locked loop filters
+// those into a steady anchor time and a measured ms-per-sample rate, so the model follows the
+// device's real sample clock while ignoring callback scheduling jitter. The loop relocks when an
+// observation is far off the prediction (device restart, dropout).
+class SampleClock
+{
+public:
+    void prepare(double sampleRate, double bandwidthHz = 0.5) noexcept;
+    void reset() noexcept;
+
+    void update(std::int64_t blockStartSample, int numSamples, double observedMs) noexcept;
+
+    double getTimeMs(std::int64_t samplePosition) const noexcept;
+    double getMsPerSample() const noexcept { return msPerSample; }
+    bool isLocked() const noexcept { return locked; }
+
+private:
+    double nominalMsPerSample = 1000.0 / 44100.0;
+    double bandwidth = 0.5;
+    double msPerSample = 1000.0 / 44100.0;
+    double anchorMs = 0.0;
+    std::int64_t anchorSample = 0;
+    bool locked = false;
+};
+
+} // namespace audiotomidi
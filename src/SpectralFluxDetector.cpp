@@ -0,0 +1,153 @@
+#include "SpectralFluxDetector.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace audiotomidi {
+
+namespace
+{
+constexpr float kLogCompression = 100.0f;
+constexpr float kMedianMultiplier = 1.5f;
+constexpr float kFocusLowMaxHz = 2.0f * BeatDetector::focusLowHz;
+}
+
+void SpectralFluxDetector::prepare(double sr)
+{
+    sampleRateHz = sr > 0.0 ? sr : 44100.0;
+
+    // Keep the frame length near 23 ms whatever the sample rate.
+    const int order = sampleRateHz <= 50000.0 ? 10 : (sampleRateHz <= 100000.0 ? 11 : 12);
+    fftSize = 1 << order;
+    hopSize = fftSize / 4;
+    numBins = fftSize / 2 + 1;
+
+    fft = std::make_unique<juce::dsp::FFT>(order);
+
+    window.assign(static_cast<size_t>(fftSize), 0.0f);
+    juce::dsp::WindowingFunction<float>::fillWindowingTables(window.data(), static_cast<size_t>(fftSize),
+                                                             juce::dsp::WindowingFunction<float>::hann, false);
+
+    // Normalise so a full-scale sine reads roughly 1.0 in its peak bin.
+    float windowSum = 0.0f;
+    for (auto w : window)
+        windowSum += w;
+    for (auto& w : window)
+        w *= 2.0f / windowSum;
+
+    inputRing.assign(static_cast<size_t>(fftSize), 0.0f);
+    fftData.assign(static_cast<size_t>(fftSize * 2), 0.0f);
+    previousLogMagnitude.assign(static_cast<size_t>(numBins), 0.0f);
+
+    reset();
+}
+
+void SpectralFluxDetector::reset() noexcept
+{
+    std::fill(inputRing.begin(), inputRing.end(), 0.0f);
+    std::fill(previousLogMagnitude.begin(), previousLogMagnitude.end(), 0.0f);
+    fluxHistory.fill(0.0f);
+    historyPosition = 0;
+    framesUntilReady = medianFrames;
+    ringPosition = 0;
+    samplesUntilHop = hopSize;
+    previousFlux = 0.0f;
+    previousPreviousFlux = 0.0f;
+    samplesSinceLastTrigger = static_cast<int>(sampleRateHz);
+}
+
+float SpectralFluxDetector::medianOfHistory() noexcept
+{
+    medianScratch = fluxHistory;
+    auto middle = medianScratch.begin() + medianFrames / 2;
+    std::nth_element(medianScratch.begin(), middle, medianScratch.end());
+    return *middle;
+}
+
+void SpectralFluxDetector::analyseFrame(const BeatDetector::Params& params, int sampleOffset, BeatDetector::TriggerBuffer& out) noexcept
+{
+    // Unroll the ring so the oldest sample lands at index 0.
+    const auto tailLength = static_cast<size_t>(fftSize - ringPosition);
+    std::copy(inputRing.begin() + ringPosition, inputRing.end(), fftData.begin());
+    std::copy(inputRing.begin(), inputRing.begin() + ringPosition, fftData.begin() + static_cast<std::ptrdiff_t>(tailLength));
+    juce::FloatVectorOperations::multiply(fftData.data(), window.data(), fftSize);
+    std::fill(fftData.begin() + fftSize, fftData.end(), 0.0f);
+
+    fft->performFrequencyOnlyForwardTransform(fftData.data(), true);
+
+    const float binHz = static_cast<float>(sampleRateHz) / static_cast<float>(fftSize);
+    const int lastBin = params.focusLow ? std::clamp(static_cast<int>(kFocusLowMaxHz / binHz) + 1, 2, numBins - 1)
+                                        : numBins - 1;
+
+    float flux = 0.0f;
+    for (int k = 1; k <= lastBin; ++k)
+    {
+        const float logMagnitude = std::log1p(kLogCompression * fftData[static_cast<size_t>(k)]);
+        flux += std::max(0.0f, logMagnitude - previousLogMagnitude[static_cast<size_t>(k)]);
+        previousLogMagnitude[static_cast<size_t>(k)] = logMagnitude;
+    }
+    flux /= static_cast<float>(lastBin);
+
+    fluxHistory[static_cast<size_t>(historyPosition)] = flux;
+    historyPosition = (historyPosition + 1) % medianFrames;
+
+    const float sensitivity = std::clamp(params.sensitivity, 0.0f, 100.0f) * 0.01f;
+    const float offset = 0.01f + (1.0f - sensitivity) * 0.15f;
+    const float threshold = medianOfHistory() * kMedianMultiplier + offset;
+
+    // The previous frame is a peak once we know the current one is not higher.
+    const float candidate = previousFlux;
+    const bool isPeak = candidate > previousPreviousFlux && candidate >= flux && candidate > threshold;
+
+    // Until the median window has filled, the first frames compare against silence.
+    if (framesUntilReady > 0)
+    {
+        --framesUntilReady;
+        previousPreviousFlux = previousFlux;
+        previousFlux = flux;
+        return;
+    }
+
+    if (isPeak && samplesSinceLastTrigger >= std::max(1, static_cast<int>(params.minGapMs * 0.001f * static_cast<float>(sampleRateHz))))
+    {
+        if (out.count < static_cast<int>(out.events.size()))
+        {
+            auto& event = out.events[static_cast<size_t>(out.count++)];
+            event = {};
+            event.sampleOffset = sampleOffset;
+            event.strength = std::clamp((candidate - threshold) / (threshold + 0.05f) * 0.5f, 0.0f, 1.0f);
+        }
+        samplesSinceLastTrigger = 0;
+    }
+
+    previousPreviousFlux = previousFlux;
+    previousFlux = flux;
+    out.envelope = flux;
+    out.threshold = threshold;
+}
+
+void SpectralFluxDetector::processBlock(const float* monoSamples, int numSamples, const BeatDetector::Params& params, BeatDetector::TriggerBuffer& out) noexcept
+{
+    out.count = 0;
+
+    int i = 0;
+    while (i < numSamples)
+    {
+        const int toRingEnd = fftSize - ringPosition;
+        const int length = std::min({ samplesUntilHop, numSamples - i, toRingEnd });
+
+        std::copy(monoSamples + i, monoSamples + i + length, inputRing.begin() + ringPosition);
+        ringPosition = (ringPosition + length) % fftSize;
+        samplesUntilHop -= length;
+        samplesSinceLastTrigger = std::min(samplesSinceLastTrigger + length, 1 << 30);
+        i += length;
+
+        if (samplesUntilHop == 0)
+        {
+            samplesUntilHop = hopSize;
+            analyseFrame(params, i - 1, out);
+        }
+    }
+}
+
+} // namespace audiotomidi
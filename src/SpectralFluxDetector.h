@@ -0,0 +1,59 @@
+#pragma once
+
+#include <array>
+#include <memory>
+#include <vector>
+
+#include <juce_dsp/juce_dsp.h>
+
+#include "BeatDetector.h"
+
+namespace audiotomidi {
+
+// Onset detector based on log-magnitude spectral flux. Audio is analysed in Hann-windowed STFT
+// frames with 75% overlap; the positive flux of each frame is compared against the median of the
+// surrounding frames plus a sensitivity-dependent offset, and local maxima above that threshold
+// trigger. Picking a peak needs the following frame, so triggers are reported
+// getLatencySamples() after the transient; the processor forwards that to the host.
+//
+// Everything is allocated in prepare(); processBlock() never allocates.
+class SpectralFluxDetector
+{
+public:
+    void prepare(double sampleRate);
+    void reset() noexcept;
+    void processBlock(const float* monoSamples, int numSamples, const BeatDetector::Params& params, BeatDetector::TriggerBuffer& out) noexcept;
+
+    int getLatencySamples() const noexcept { return fftSize / 2 + hopSize; }
+
+private:
+    static constexpr int medianFrames = 15;
+
+    void analyseFrame(const BeatDetector::Params& params, int sampleOffset, BeatDetector::TriggerBuffer& out) noexcept;
+    float medianOfHistory() noexcept;
+
+    double sampleRateHz = 44100.0;
+    int fftSize = 1024;
+    int hopSize = 256;
+    int numBins = 513;
+
+    std::unique_ptr<juce::dsp::FFT> fft;
+    std::vector<float> window;
+    std::vector<float> inputRing;
+    std::vector<float> fftData;
+    std::vector<float> previousLogMagnitude;
+
+    int ringPosition = 0;
+    int samplesUntilHop = 0;
+
+    std::array<float, medianFrames> fluxHistory {};
+    std::array<float, medianFrames> medianScratch {};
+    int historyPosition = 0;
+    int framesUntilReady = 0;
+
+    float previousFlux = 0.0f;
+    float previousPreviousFlux = 0.0f;
+    int samplesSinceLastTrigger = 0;
+};
+
+} // namespace audiotomidi
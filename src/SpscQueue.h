@@ -0,0 +1,55 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <type_traits>
+
+namespace audiotomidi {
+
+// Fixed-capacity single-producer/single-consumer FIFO. Storage lives inside the object, so
+// pushing and popping never allocate; each side owns one index and only reads the other's.
+template <typename T, std::size_t Capacity>
+class SpscQueue
+{
+public:
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "SpscQueue capacity must be a power of two");
+    static_assert(std::is_trivially_copyable_v<T>, "SpscQueue items are copied on the audio thread");
+
+    // Producer thread only. Returns false, leaving the queue unchanged, when it is full.
+    bool push(const T& item) noexcept
+    {
+        const auto write = writeIndex.load(std::memory_order_relaxed);
+        if (write - readIndex.load(std::memory_order_acquire) == Capacity)
+            return false;
+
+        items[write & (Capacity - 1)] = item;
+        writeIndex.store(write + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer thread only. Returns the oldest item without removing it, or nullptr when empty.
+    const T* front() const noexcept
+    {
+        const auto read = readIndex.load(std::memory_order_relaxed);
+        if (read == writeIndex.load(std::memory_order_acquire))
+            return nullptr;
+
+        return &items[read & (Capacity - 1)];
+    }
+
+    // Consumer thread only; call after front() returned an item.
+    void pop() noexcept
+    {
+        readIndex.store(readIndex.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    static constexpr std::size_t capacity() noexcept { return Capacity; }
+
+private:
+    std::array<T, Capacity> items {};
+    alignas(64) std::atomic<std::size_t> writeIndex { 0 };
+    alignas(64) std::atomic<std::size_t> readIndex { 0 };
+};
+
+} // namespace audiotomidi
@@ -0,0 +1,370 @@
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <thread>
+#include <vector>
+
+#include <juce_audio_formats/juce_audio_formats.h>
+
+#include "ChunkedAnalysis.h"
+#include "DetectionEval.h"
+#include "DownmixKernel.h"
+#include "ParameterSweep.h"
+
+namespace
+{
+// The same hit window AudioToMidiBeatEval scores with.
+constexpr double kEarlyToleranceMs = 10.0;
+constexpr double kLateToleranceMs = 50.0;
+
+// Parameter IDs as registered in PluginProcessor.h.
+constexpr auto kSensitivityId = "sensitivity";
+constexpr auto kMinGapId = "minGapMs";
+constexpr auto kFocusLowId = "focusLow";
+
+void printUsage()
+{
+    std::cout << "Usage: AudioToMidiBeatSweep --reference=<file.mid> [options] <audio file>\n"
+                 "\n"
+                 "Scores every sensitivity / minimum gap / Focus Low combination of a grid against the\n"
+                 "note-ons of a reference MIDI file and writes the best one as a plugin preset. The\n"
+                 "envelope is computed once per Focus Low setting, so the whole grid costs little more\n"
+                 "than a single detector pass. Lookahead is off.\n"
+                 "\n"
+                 "Options:\n"
+                 "  --reference=<file>       MIDI file with the true onsets (required)\n"
+                 "  --note=<0-127>           only use reference notes with this number (default: all)\n"
+                 "  --sensitivity=<a:b:step> default 0:100:2.5\n"
+                 "  --min-gap-ms=<a:b:step>  default 50:300:10\n"
+                 "  --focus-low=<on|off|both>  default both\n"
+                 "  --jobs=<n>               threads scoring the grid (default: all cores)\n"
+                 "  --block-size=<n>         samples per block read from the file (default: 4096)\n"
+                 "  --out=<file>             preset to write (default: <audio>.preset.xml)\n"
+                 "  --csv=<file>             also write every grid point's score\n";
+}
+
+std::vector<float> parseRange(const juce::String& text, float from, float to, float step)
+{
+    auto parts = juce::StringArray::fromTokens(text, ":", {});
+    if (parts.size() == 3)
+    {
+        from = parts[0].getFloatValue();
+        to = parts[1].getFloatValue();
+        step = parts[2].getFloatValue();
+    }
+    else if (parts.size() == 1 && text.isNotEmpty())
+    {
+        from = to = parts[0].getFloatValue();
+    }
+
+    std::vector<float> values;
+    const int count = step > 0.0f ? static_cast<int>(std::floor((to - from) / step + 1.0e-3f)) + 1 : 1;
+    for (int i = 0; i < std::max(1, count); ++i)
+        values.push_back(from + static_cast<float>(i) * step);
+    return values;
+}
+
+// Note-on positions of every track (or of one note number), in samples at sampleRate.
+bool readReferenceOnsets(const juce::File& file, int noteFilter, double sampleRate, std::vector<std::int64_t>& onsets)
+{
+    juce::FileInputStream stream(file);
+    juce::MidiFile midiFile;
+    if (!stream.openedOk() || !midiFile.readFrom(stream))
+        return false;
+
+    midiFile.convertTimestampTicksToSeconds();
+    for (int track = 0; track < midiFile.getNumTracks(); ++track)
+        for (const auto* event : *midiFile.getTrack(track))
+        {
+            const auto& message = event->message;
+            if (message.isNoteOn() && (noteFilter < 0 || message.getNoteNumber() == noteFilter))
+                onsets.push_back(static_cast<std::int64_t>(std::llround(message.getTimeStamp() * sampleRate)));
+        }
+
+    std::sort(onsets.begin(), onsets.end());
+    return true;
+}
+
+// Reads the file block by block, downmixes it and hands each block to consume. Every caller
+// opens its own reader, since AudioFormatReader is not thread-safe.
+template <typename Consume>
+bool streamMono(const juce::File& file, int blockSize, Consume&& consume)
+{
+    juce::AudioFormatManager formats;
+    formats.registerBasicFormats();
+    std::unique_ptr<juce::AudioFormatReader> reader(formats.createReaderFor(file));
+    if (reader == nullptr || reader->numChannels == 0)
+        return false;
+
+    const auto numChannels = static_cast<int>(reader->numChannels);
+    juce::AudioBuffer<float> buffer(numChannels, blockSize);
+    std::vector<float> mono(static_cast<size_t>(blockSize));
+
+    for (juce::int64 position = 0; position < reader->lengthInSamples; position += blockSize)
+    {
+        const auto numSamples = static_cast<int>(std::min<juce::int64>(blockSize, reader->lengthInSamples - position));
+        reader->read(&buffer, 0, numSamples, position, true, true);
+        audiotomidi::downmixToMono(buffer.getArrayOfReadPointers(), numChannels, mono.data(), numSamples);
+        consume(mono.data(), numSamples);
+    }
+
+    return true;
+}
+
+struct GridPoint
+{
+    size_t pass = 0;
+    size_t sensitivityIndex = 0;
+    float sensitivity = 0.0f;
+    float minGapMs = 0.0f;
+    bool focusLow = true;
+    audiotomidi::DetectionScore score;
+    int numDetections = 0;
+};
+
+// Higher F-measure wins; among equals the smaller mean timing error does.
+bool isBetter(const GridPoint& a, const GridPoint& b)
+{
+    const auto fa = a.score.getFMeasure();
+    const auto fb = b.score.getFMeasure();
+    if (std::abs(fa - fb) > 1.0e-9)
+        return fa > fb;
+    return std::abs(a.score.meanLatencySamples) < std::abs(b.score.meanLatencySamples);
+}
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    juce::File audioFile;
+    juce::File referenceFile;
+    juce::File presetFile;
+    juce::File csvFile;
+    int noteFilter = -1;
+    int blockSize = 4096;
+    int jobs = juce::SystemStats::getNumCpus();
+    juce::String sensitivityRange;
+    juce::String minGapRange;
+    juce::String focusLowChoice = "both";
+
+    const auto cwd = juce::File::getCurrentWorkingDirectory();
+    for (int i = 1; i < argc; ++i)
+    {
+        const juce::String arg(juce::CharPointer_UTF8(argv[i]));
+        const auto value = arg.fromFirstOccurrenceOf("=", false, false);
+
+        if (arg.startsWith("--reference="))
+            referenceFile = cwd.getChildFile(value);
+        else if (arg.startsWith("--note="))
+            noteFilter = juce::jlimit(0, 127, value.getIntValue());
+        else if (arg.startsWith("--sensitivity="))
+            sensitivityRange = value;
+        else if (arg.startsWith("--min-gap-ms="))
+            minGapRange = value;
+        else if (arg.startsWith("--focus-low="))
+            focusLowChoice = value.toLowerCase();
+        else if (arg.startsWith("--jobs="))
+            jobs = value.getIntValue();
+        else if (arg.startsWith("--block-size="))
+            blockSize = value.getIntValue();
+        else if (arg.startsWith("--out="))
+            presetFile = cwd.getChildFile(value);
+        else if (arg.startsWith("--csv="))
+            csvFile = cwd.getChildFile(value);
+        else if (arg.startsWith("-"))
+        {
+            printUsage();
+            return arg == "--help" || arg == "-h" ? 0 : 1;
+        }
+        else
+            audioFile = cwd.getChildFile(arg);
+    }
+
+    if (audioFile == juce::File() || referenceFile == juce::File())
+    {
+        printUsage();
+        return 1;
+    }
+
+    jobs = std::max(1, jobs);
+    blockSize = std::max(16, blockSize);
+    if (presetFile == juce::File())
+        presetFile = audioFile.withFileExtension("preset.xml");
+
+    juce::AudioFormatManager formats;
+    formats.registerBasicFormats();
+    std::unique_ptr<juce::AudioFormatReader> reader(formats.createReaderFor(audioFile));
+    if (reader == nullptr || reader->numChannels == 0 || reader->sampleRate <= 0.0)
+    {
+        std::cerr << "Unsupported or unreadable audio file: " << audioFile.getFullPathName() << "\n";
+        return 1;
+    }
+
+    const double sampleRate = reader->sampleRate;
+    const double audioSeconds = static_cast<double>(reader->lengthInSamples) / sampleRate;
+    reader.reset();
+
+    std::vector<std::int64_t> truth;
+    if (!readReferenceOnsets(referenceFile, noteFilter, sampleRate, truth) || truth.empty())
+    {
+        std::cerr << "No reference note-ons in " << referenceFile.getFullPathName() << "\n";
+        return 1;
+    }
+
+    const auto sensitivities = parseRange(sensitivityRange, 0.0f, 100.0f, 2.5f);
+    const auto minGaps = parseRange(minGapRange, 50.0f, 300.0f, 10.0f);
+    std::vector<bool> focusLowValues;
+    if (focusLowChoice != "off")
+        focusLowValues.push_back(true);
+    if (focusLowChoice != "on")
+        focusLowValues.push_back(false);
+
+    // One pass over the file per Focus Low setting, concurrently.
+    std::vector<audiotomidi::ThresholdSweep> sweeps(focusLowValues.size());
+    std::vector<double> passSeconds(focusLowValues.size(), 0.0);
+    std::atomic<bool> readFailed { false };
+    const auto sweepStart = juce::Time::getHighResolutionTicks();
+    {
+        std::vector<std::thread> passes;
+        for (size_t p = 0; p < focusLowValues.size(); ++p)
+        {
+            passes.emplace_back([&, p]
+            {
+                const auto start = juce::Time::getHighResolutionTicks();
+                sweeps[p].prepare(sampleRate, focusLowValues[p], sensitivities);
+                if (!streamMono(audioFile, blockSize, [&sweep = sweeps[p]](const float* mono, int numSamples) { sweep.process(mono, numSamples); }))
+                    readFailed = true;
+                passSeconds[p] = juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - start);
+            });
+        }
+
+        for (auto& pass : passes)
+            pass.join();
+    }
+    const auto passesSeconds = juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - sweepStart);
+
+    if (readFailed)
+    {
+        std::cerr << "Cannot read " << audioFile.getFullPathName() << "\n";
+        return 1;
+    }
+
+    std::vector<GridPoint> grid;
+    for (size_t p = 0; p < focusLowValues.size(); ++p)
+        for (size_t s = 0; s < sensitivities.size(); ++s)
+            for (const auto minGap : minGaps)
+                grid.push_back({ p, s, sensitivities[s], minGap, focusLowValues[p], {}, 0 });
+
+    const auto toSamples = [sampleRate](double ms) { return static_cast<std::int64_t>(ms * 0.001 * sampleRate); };
+    const auto scoreStart = juce::Time::getHighResolutionTicks();
+    {
+        std::atomic<size_t> next { 0 };
+        std::vector<std::thread> workers;
+        for (int w = 0; w < std::min<int>(jobs, static_cast<int>(grid.size())); ++w)
+        {
+            workers.emplace_back([&]
+            {
+                std::vector<std::int64_t> detections;
+                for (auto i = next.fetch_add(1); i < grid.size(); i = next.fetch_add(1))
+                {
+                    auto& point = grid[i];
+                    detections.clear();
+                    for (const auto& onset : sweeps[point.pass].getOnsets(point.sensitivityIndex, point.minGapMs))
+                        detections.push_back(onset.samplePosition);
+
+                    point.numDetections = static_cast<int>(detections.size());
+                    point.score = audiotomidi::scoreDetections(truth, detections, toSamples(kEarlyToleranceMs), toSamples(kLateToleranceMs));
+                }
+            });
+        }
+
+        for (auto& worker : workers)
+            worker.join();
+    }
+    const auto scoreSeconds = juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - scoreStart);
+
+    const auto& best = *std::min_element(grid.begin(), grid.end(), [](const GridPoint& a, const GridPoint& b) { return isBetter(a, b); });
+
+    // Runs the winner through BeatDetector itself; the sweep must reproduce it exactly.
+    audiotomidi::BeatDetector::Params bestParams;
+    bestParams.sensitivity = best.sensitivity;
+    bestParams.minGapMs = best.minGapMs;
+    bestParams.focusLow = best.focusLow;
+
+    audiotomidi::OnsetAnalyser analyser;
+    analyser.prepare(sampleRate, bestParams);
+    analyser.begin({ 0, 0, std::numeric_limits<std::int64_t>::max() });
+    const auto verifyStart = juce::Time::getHighResolutionTicks();
+    streamMono(audioFile, blockSize, [&analyser](const float* mono, int numSamples) { analyser.process(mono, numSamples); });
+    const auto singlePassSeconds = juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - verifyStart);
+
+    const auto expected = analyser.getOnsets();
+    const auto swept = sweeps[best.pass].getOnsets(best.sensitivityIndex, best.minGapMs);
+    bool verified = expected.size() == swept.size();
+    for (size_t i = 0; verified && i < expected.size(); ++i)
+        verified = expected[i].samplePosition == swept[i].samplePosition && expected[i].strength == swept[i].strength;
+
+    if (csvFile != juce::File())
+    {
+        juce::String csv = "focus_low,sensitivity,min_gap_ms,detections,true_positives,false_positives,false_negatives,precision,recall,f_measure,mean_error_ms,p99_error_ms\n";
+        for (const auto& point : grid)
+            csv << (point.focusLow ? 1 : 0) << "," << point.sensitivity << "," << point.minGapMs << "," << point.numDetections << ","
+                << point.score.truePositives << "," << point.score.falsePositives << "," << point.score.falseNegatives << ","
+                << juce::String(point.score.getPrecision(), 4) << "," << juce::String(point.score.getRecall(), 4) << ","
+                << juce::String(point.score.getFMeasure(), 4) << "," << juce::String(point.score.meanLatencySamples * 1000.0 / sampleRate, 3) << ","
+                << juce::String(point.score.p99LatencySamples * 1000.0 / sampleRate, 3) << "\n";
+
+        if (!csvFile.replaceWithText(csv))
+            std::cerr << "Cannot write " << csvFile.getFullPathName() << "\n";
+    }
+
+    // The same XML the plugin stores as its state; parameters not listed keep their values.
+    juce::XmlElement preset("PARAMETERS");
+    const auto addParameter = [&preset](const char* id, double value)
+    {
+        auto* parameter = preset.createNewChildElement("PARAM");
+        parameter->setAttribute("id", id);
+        parameter->setAttribute("value", value);
+    };
+    addParameter(kSensitivityId, best.sensitivity);
+    addParameter(kMinGapId, best.minGapMs);
+    addParameter(kFocusLowId, best.focusLow ? 1.0 : 0.0);
+    const bool presetWritten = preset.writeTo(presetFile);
+
+    size_t numEdges = 0;
+    for (const auto& sweep : sweeps)
+        numEdges += sweep.getNumEdges();
+
+    std::cout << "Audio:      " << juce::String(audioSeconds, 1) << " s at " << juce::roundToInt(sampleRate) << " Hz, "
+              << truth.size() << " reference onsets\n"
+              << "Grid:       " << grid.size() << " points (" << sensitivities.size() << " sensitivities x " << minGaps.size()
+              << " gaps x " << focusLowValues.size() << " Focus Low), " << numEdges << " threshold edges\n"
+              << "Passes:     " << juce::String(passesSeconds, 3) << " s wall for " << focusLowValues.size() << " pass(es), slowest "
+              << juce::String(*std::max_element(passSeconds.begin(), passSeconds.end()), 3) << " s; one detector pass "
+              << juce::String(singlePassSeconds, 3) << " s\n"
+              << "Scoring:    " << juce::String(scoreSeconds, 3) << " s on " << jobs << " thread(s)\n"
+              << "\n"
+              << "Best:       sensitivity " << best.sensitivity << ", min gap " << best.minGapMs << " ms, Focus Low "
+              << (best.focusLow ? "on" : "off") << "\n"
+              << "            P " << juce::String(best.score.getPrecision(), 3) << "  R " << juce::String(best.score.getRecall(), 3)
+              << "  F " << juce::String(best.score.getFMeasure(), 3) << "  mean error "
+              << juce::String(best.score.meanLatencySamples * 1000.0 / sampleRate, 2) << " ms  p99 "
+              << juce::String(best.score.p99LatencySamples * 1000.0 / sampleRate, 2) << " ms\n"
+              << "            AudioToMidiBeatCli --sensitivity=" << best.sensitivity << " --min-gap-ms=" << best.minGapMs
+              << " --focus-low=" << (best.focusLow ? "on" : "off") << "\n";
+
+    if (presetWritten)
+        std::cout << "Preset:     " << presetFile.getFullPathName() << "\n";
+    else
+        std::cerr << "Cannot write " << presetFile.getFullPathName() << "\n";
+
+    if (!verified)
+    {
+        std::cout << "MISMATCH: BeatDetector reports " << expected.size() << " onsets for the best point, the sweep "
+                  << swept.size() << "\n";
+        return 2;
+    }
+
+    return presetWritten ? 0 : 1;
+}
@@ -0,0 +1,117 @@
+#include "TelemetryView.h"
+
+#include <algorithm>
+
+namespace audiotomidi {
+
+void drawTimingHistogram(juce::Graphics& g, juce::Rectangle<int> area, const juce::String& title,
+                         const TimingHistogram& histogram, bool markZero)
+{
+    const auto summary = histogram.getSummary();
+    g.setColour(juce::Colours::white);
+    g.drawText(title + "  n=" + juce::String(static_cast<juce::int64>(summary.count))
+                   + "  mean " + juce::String(summary.meanMs, 3) + "  p99 " + juce::String(summary.p99Ms, 2)
+                   + "  max " + juce::String(summary.maxMs, 2) + " ms",
+               area.removeFromTop(18), juce::Justification::centredLeft);
+
+    g.setColour(juce::Colours::black.withAlpha(0.25f));
+    g.fillRect(area);
+
+    const auto counts = histogram.getCounts();
+    const auto peak = *std::max_element(counts.begin() + 1, counts.end() - 1);
+    if (peak == 0)
+        return;
+
+    const float barWidth = static_cast<float>(area.getWidth()) / static_cast<float>(histogram.getNumBins());
+    g.setColour(juce::Colours::limegreen.withAlpha(0.85f));
+    for (int bin = 0; bin < histogram.getNumBins(); ++bin)
+    {
+        const float height = static_cast<float>(area.getHeight()) * static_cast<float>(counts[static_cast<size_t>(bin + 1)]) / static_cast<float>(peak);
+        g.fillRect(static_cast<float>(area.getX()) + barWidth * static_cast<float>(bin), static_cast<float>(area.getBottom()) - height,
+                   std::max(1.0f, barWidth - 0.5f), height);
+    }
+
+    if (!markZero)
+        return;
+
+    // Mark zero so early and late values read at a glance.
+    const float zeroX = static_cast<float>(area.getX())
+                      + static_cast<float>(-histogram.getRangeStartMs() / histogram.getBinWidthMs()) * barWidth;
+    g.setColour(juce::Colours::white.withAlpha(0.5f));
+    g.drawVerticalLine(static_cast<int>(zeroX), static_cast<float>(area.getY()), static_cast<float>(area.getBottom()));
+}
+
+//==============================================================================
+TelemetryView::TelemetryView(CallbackTelemetry& telemetryToShow)
+    : telemetry(telemetryToShow)
+{
+    resetButton.setButtonText("Reset");
+    resetButton.onClick = [this]
+    {
+        telemetry.reset();
+        repaint();
+    };
+    addAndMakeVisible(resetButton);
+
+    exportButton.setButtonText("Export CSV");
+    exportButton.onClick = [this] { exportCsv(); };
+    addAndMakeVisible(exportButton);
+}
+
+void TelemetryView::resized()
+{
+    auto buttons = getLocalBounds().removeFromRight(110).removeFromTop(60);
+    resetButton.setBounds(buttons.removeFromTop(30).reduced(2));
+    exportButton.setBounds(buttons.reduced(2));
+}
+
+void TelemetryView::paint(juce::Graphics& g)
+{
+    auto area = getLocalBounds().withTrimmedRight(110);
+
+    auto summaryText = "Load " + juce::String(telemetry.getLoad() * 100.0f, 1) + "% (peak "
+                     + juce::String(telemetry.getPeakLoad() * 100.0f, 1) + "%)   Overruns: "
+                     + juce::String(static_cast<juce::int64>(telemetry.getNumOverruns()));
+    if (getDeviceXRuns != nullptr)
+    {
+        const int deviceXRuns = getDeviceXRuns();
+        summaryText += "   Device xruns: " + (deviceXRuns >= 0 ? juce::String(deviceXRuns) : juce::String("-"));
+    }
+
+    g.setColour(juce::Colours::white);
+    g.setFont(13.0f);
+    g.drawText(summaryText, area.removeFromTop(18), juce::Justification::centredLeft);
+
+    // Callback and downmix on the top row, detection and MIDI below.
+    auto top = area.removeFromTop(area.getHeight() / 2);
+    auto bottom = area;
+    const auto stageArea = [](juce::Rectangle<int>& row, bool left)
+    {
+        return (left ? row.removeFromLeft(row.getWidth() / 2) : row).reduced(4, 2);
+    };
+
+    using Stage = CallbackTelemetry::Stage;
+    drawTimingHistogram(g, stageArea(top, true), "Callback", telemetry.getCallbackTimes(), false);
+    drawTimingHistogram(g, stageArea(top, false), "Downmix", telemetry.getStageTimes(Stage::Downmix), false);
+    drawTimingHistogram(g, stageArea(bottom, true), "Detection", telemetry.getStageTimes(Stage::Detection), false);
+    drawTimingHistogram(g, stageArea(bottom, false), "MIDI", telemetry.getStageTimes(Stage::Midi), false);
+}
+
+void TelemetryView::exportCsv()
+{
+    chooser = std::make_unique<juce::FileChooser>("Export callback telemetry",
+                                                  juce::File::getSpecialLocation(juce::File::userDocumentsDirectory).getChildFile("AudioToMidiBeatTelemetry.csv"),
+                                                  "*.csv");
+    chooser->launchAsync(juce::FileBrowserComponent::saveMode | juce::FileBrowserComponent::canSelectFiles
+                             | juce::FileBrowserComponent::warnAboutOverwriting,
+                         [this](const juce::FileChooser& fc)
+                         {
+                             const auto file = fc.getResult();
+                             if (file == juce::File())
+                                 return;
+
+                             file.replaceWithText(telemetry.toCsv());
+                         });
+}
+
+} // namespace audiotomidi
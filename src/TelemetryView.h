@@ -0,0 +1,42 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+
+#include <juce_gui_basics/juce_gui_basics.h>
+
+#include "CallbackTelemetry.h"
+#include "TimingHistogram.h"
+
+namespace audiotomidi {
+
+// Draws a histogram's bars under a title line with its count, mean, p99 and maximum. markZero
+// draws a line at 0 ms, for histograms of signed errors.
+void drawTimingHistogram(juce::Graphics& g, juce::Rectangle<int> area, const juce::String& title,
+                         const TimingHistogram& histogram, bool markZero);
+
+// Shows a CallbackTelemetry: smoothed and peak load, overruns, and the callback and per-stage
+// duration histograms, with reset and CSV export. The owner repaints it from its timer.
+class TelemetryView : public juce::Component
+{
+public:
+    explicit TelemetryView(CallbackTelemetry& telemetryToShow);
+
+    // Optional: the audio device's own xrun count, or a negative value when it does not report one.
+    std::function<int()> getDeviceXRuns;
+
+    void resized() override;
+    void paint(juce::Graphics& g) override;
+
+private:
+    void exportCsv();
+
+    CallbackTelemetry& telemetry;
+    juce::TextButton resetButton;
+    juce::TextButton exportButton;
+    std::unique_ptr<juce::FileChooser> chooser;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(TelemetryView)
+};
+
+} // namespace audiotomidi
@@ -0,0 +1,247 @@
+#include "TempoTracker.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace audiotomidi {
+
+namespace
+{
+// Intervals outside this range are neither beats nor useful subdivisions.
+constexpr double kMinIntervalSeconds = 0.1;
+constexpr double kMaxIntervalSeconds = 4.0;
+
+// Each onset's votes outweigh the previous onset's by 1 / kHistogramDecay.
+constexpr float kHistogramDecay = 0.9f;
+constexpr float kRescaleWeight = 1.0e15f;
+
+// The beat clock follows the histogram once this many onsets have voted, and jumps to the
+// histogram tempo when the two disagree by more than kRetuneTolerance.
+constexpr int kMinOnsets = 4;
+constexpr double kRetuneTolerance = 0.04;
+
+// An onset within this many beats of a beat or half beat counts as a hit and pulls the clock.
+constexpr double kHitToleranceBeats = 0.06;
+constexpr double kPhaseGain = 0.3;
+constexpr double kPeriodGain = 0.05;
+constexpr float kConfidenceSmoothing = 0.15f;
+
+// Clock start and stop.
+constexpr int kMinOnsetsForClock = 8;
+constexpr float kStartConfidence = 0.6f;
+constexpr float kStopConfidence = 0.3f;
+constexpr double kStopAfterBeats = 8.0;
+
+constexpr juce::uint8 kMidiStart = 0xfa;
+constexpr juce::uint8 kMidiTimingClock = 0xf8;
+constexpr juce::uint8 kMidiStop = 0xfc;
+} // namespace
+
+void TempoTracker::prepare(double sampleRate) noexcept
+{
+    sampleRateHz = sampleRate > 0.0 ? sampleRate : 44100.0;
+    reset();
+}
+
+void TempoTracker::reset() noexcept
+{
+    histogram.fill(0.0f);
+    histogramTotal = 0.0f;
+    voteWeight = 1.0f;
+    peakBin = 0;
+
+    recentOnsets.fill(0);
+    numOnsets = 0;
+
+    blockStartSample = 0;
+    beatPhase = 0.0;
+    periodSamples = 0.0;
+    confidence = 0.0f;
+    lastOnsetSample = 0;
+
+    clockRunning = false;
+    startPending = false;
+    lastTick = 0;
+}
+
+double TempoTracker::getBpm() const noexcept
+{
+    return periodSamples > 0.0 ? 60.0 * sampleRateHz / periodSamples : 0.0;
+}
+
+void TempoTracker::vote(double intervalSamples) noexcept
+{
+    if (intervalSamples < kMinIntervalSeconds * sampleRateHz || intervalSamples > kMaxIntervalSeconds * sampleRateHz)
+        return;
+
+    // Fold into the tracked octave, where the bins are log-spaced.
+    double bpm = 60.0 * sampleRateHz / intervalSamples;
+    while (bpm < minBpm)
+        bpm *= 2.0;
+    while (bpm >= 2.0 * minBpm)
+        bpm *= 0.5;
+
+    const double position = std::log2(bpm / minBpm) * binsPerOctave;
+    const int lower = std::min(binsPerOctave - 1, static_cast<int>(position));
+    const int upper = (lower + 1) % binsPerOctave;
+    const auto fraction = static_cast<float>(position - lower);
+
+    histogram[static_cast<size_t>(lower)] += (1.0f - fraction) * voteWeight;
+    histogram[static_cast<size_t>(upper)] += fraction * voteWeight;
+    histogramTotal += voteWeight;
+
+    // Bins only grow between rescales, so the peak can only move to a bin that just grew.
+    for (const int bin : { lower, upper })
+        if (histogram[static_cast<size_t>(bin)] > histogram[static_cast<size_t>(peakBin)])
+            peakBin = bin;
+}
+
+double TempoTracker::getHistogramPeriodSamples() const noexcept
+{
+    // Parabolic interpolation around the peak; the octave wraps around.
+    const float below = histogram[static_cast<size_t>((peakBin + binsPerOctave - 1) % binsPerOctave)];
+    const float peak = histogram[static_cast<size_t>(peakBin)];
+    const float above = histogram[static_cast<size_t>((peakBin + 1) % binsPerOctave)];
+
+    const float curvature = below - 2.0f * peak + above;
+    const double offset = curvature < 0.0f ? 0.5 * static_cast<double>(below - above) / static_cast<double>(curvature) : 0.0;
+
+    const double bpm = minBpm * std::exp2((peakBin + offset) / binsPerOctave);
+    return 60.0 * sampleRateHz / bpm;
+}
+
+void TempoTracker::addOnset(std::int64_t onsetSample) noexcept
+{
+    const int numRecent = std::min(numOnsets, static_cast<int>(recentOnsets.size()));
+    for (int i = 0; i < numRecent; ++i)
+        vote(static_cast<double>(onsetSample - recentOnsets[static_cast<size_t>(i)]));
+
+    std::move_backward(recentOnsets.begin(), recentOnsets.end() - 1, recentOnsets.end());
+    recentOnsets[0] = onsetSample;
+    numOnsets = std::min(numOnsets + 1, kMinOnsetsForClock);
+    lastOnsetSample = onsetSample;
+
+    voteWeight /= kHistogramDecay;
+    if (voteWeight > kRescaleWeight)
+    {
+        for (auto& bin : histogram)
+            bin /= voteWeight;
+        histogramTotal /= voteWeight;
+        voteWeight = 1.0f;
+    }
+
+    if (numOnsets < kMinOnsets || histogramTotal <= 0.0f)
+        return;
+
+    const double histogramPeriod = getHistogramPeriodSamples();
+    if (periodSamples <= 0.0 || std::abs(periodSamples / histogramPeriod - 1.0) > kRetuneTolerance)
+    {
+        // The tempo changed, so the old phase is meaningless too: this onset becomes a beat. A
+        // running clock never repeats a tick, it only waits for the new phase to catch up.
+        periodSamples = histogramPeriod;
+        beatPhase = std::round(beatPhase);
+    }
+
+    // Distance to the nearest beat or half beat, positive when the onset came late.
+    const double error = 0.5 * (2.0 * beatPhase - std::round(2.0 * beatPhase));
+    const bool hit = std::abs(error) < kHitToleranceBeats;
+    if (hit)
+    {
+        beatPhase -= kPhaseGain * error;
+        periodSamples = std::clamp(periodSamples * (1.0 + kPeriodGain * error),
+                                   histogramPeriod * (1.0 - kRetuneTolerance),
+                                   histogramPeriod * (1.0 + kRetuneTolerance));
+    }
+    else if (!clockRunning)
+    {
+        // Nothing downstream follows a stopped clock, so re-anchor the beat on this onset.
+        beatPhase = std::round(beatPhase);
+    }
+
+    confidence += kConfidenceSmoothing * ((hit ? 1.0f : 0.0f) - confidence);
+
+    if (!clockRunning && numOnsets >= kMinOnsetsForClock && confidence >= kStartConfidence)
+        startPending = true;
+}
+
+void TempoTracker::advanceClock(juce::MidiBuffer& midi, int fromOffset, int toOffset, bool sendClock) noexcept
+{
+    if (periodSamples <= 0.0 || toOffset <= fromOffset)
+        return;
+
+    const double beatsPerSample = 1.0 / periodSamples;
+    const auto offsetOf = [&](double phase)
+    {
+        return fromOffset + static_cast<int>(std::max(0.0, std::ceil((phase - beatPhase) / beatsPerSample)));
+    };
+
+    if (sendClock && startPending)
+    {
+        const double startBeat = std::ceil(beatPhase);
+        const int offset = offsetOf(startBeat);
+        if (offset < toOffset)
+        {
+            midi.addEvent(juce::MidiMessage(kMidiStart), offset);
+            midi.addEvent(juce::MidiMessage(kMidiTimingClock), offset);
+            lastTick = static_cast<std::int64_t>(startBeat) * ticksPerBeat;
+            startPending = false;
+            clockRunning = true;
+        }
+    }
+
+    if (clockRunning)
+    {
+        for (;;)
+        {
+            const int offset = offsetOf(static_cast<double>(lastTick + 1) / ticksPerBeat);
+            if (offset >= toOffset)
+                break;
+
+            midi.addEvent(juce::MidiMessage(kMidiTimingClock), offset);
+            ++lastTick;
+        }
+    }
+
+    beatPhase += static_cast<double>(toOffset - fromOffset) * beatsPerSample;
+}
+
+void TempoTracker::stopClock(juce::MidiBuffer& midi, int offset) noexcept
+{
+    if (clockRunning)
+        midi.addEvent(juce::MidiMessage(kMidiStop), offset);
+
+    clockRunning = false;
+    startPending = false;
+}
+
+void TempoTracker::process(const BeatDetector::TriggerBuffer& triggers, juce::MidiBuffer& midi, int numSamples, bool sendClock) noexcept
+{
+    if (numSamples <= 0)
+        return;
+
+    if (!sendClock)
+        stopClock(midi, 0);
+
+    int cursor = 0;
+    for (int i = 0; i < triggers.count; ++i)
+    {
+        const int offset = std::clamp(triggers.events[static_cast<size_t>(i)].sampleOffset, cursor, numSamples - 1);
+        advanceClock(midi, cursor, offset, sendClock);
+        cursor = offset;
+        addOnset(blockStartSample + offset);
+    }
+
+    advanceClock(midi, cursor, numSamples, sendClock);
+    blockStartSample += numSamples;
+
+    // The band stopped, or the onsets no longer fit the beat.
+    const bool silent = periodSamples > 0.0
+                        && static_cast<double>(blockStartSample - lastOnsetSample) > kStopAfterBeats * periodSamples;
+    if (silent)
+        confidence = 0.0f;
+
+    if ((clockRunning || startPending) && (silent || confidence < kStopConfidence))
+        stopClock(midi, numSamples - 1);
+}
+
+} // namespace audiotomidi
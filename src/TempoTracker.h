@@ -0,0 +1,74 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+#include <juce_audio_basics/juce_audio_basics.h>
+
+#include "BeatDetector.h"
+
+namespace audiotomidi {
+
+// Follows the tempo and beat phase of the trigger stream and optionally drives MIDI clock.
+//
+// Every onset votes for the intervals to its last few predecessors in a tempo histogram that
+// spans one octave (minBpm to 2 * minBpm, so eighth notes and half notes fold onto the beat).
+// Old votes fade by growing the weight of new ones instead of decaying every bin, and the peak
+// is maintained as bins grow, so an onset costs O(1); the bins are rescaled only when the
+// weight gets large. A phase-locked beat clock follows the histogram tempo and is nudged by
+// every onset that lands near a beat or half beat. The share of recent onsets that do is the
+// confidence.
+//
+// With the clock enabled, MIDI Start (0xFA) is sent on a beat once the confidence is high enough,
+// then 24 Timing Clock messages (0xF8) per beat, and Stop (0xFC) when the confidence drops or the
+// onsets stop. Everything lives in fixed-size members; process() never allocates.
+class TempoTracker
+{
+public:
+    static constexpr float minBpm = 90.0f;
+    static constexpr int binsPerOctave = 96;
+    static constexpr int ticksPerBeat = 24;
+
+    void prepare(double sampleRate) noexcept;
+    void reset() noexcept;
+
+    // Feeds one block's triggers and, when sendClock is set, appends clock messages to midi.
+    void process(const BeatDetector::TriggerBuffer& triggers, juce::MidiBuffer& midi, int numSamples, bool sendClock) noexcept;
+
+    // 0 until enough onsets have been seen.
+    double getBpm() const noexcept;
+    float getConfidence() const noexcept { return confidence; }
+    bool isClockRunning() const noexcept { return clockRunning; }
+
+    // Sends Stop at offset if the clock is running, and cancels a pending start.
+    void stopClock(juce::MidiBuffer& midi, int offset) noexcept;
+
+private:
+    void addOnset(std::int64_t onsetSample) noexcept;
+    void vote(double intervalSamples) noexcept;
+    double getHistogramPeriodSamples() const noexcept;
+    void advanceClock(juce::MidiBuffer& midi, int fromOffset, int toOffset, bool sendClock) noexcept;
+
+    double sampleRateHz = 44100.0;
+
+    std::array<float, binsPerOctave> histogram {};
+    float histogramTotal = 0.0f;
+    float voteWeight = 1.0f;
+    int peakBin = 0;
+
+    std::array<std::int64_t, 4> recentOnsets {};
+    int numOnsets = 0;
+
+    // Beat clock: beats elapsed at blockStartSample and the current beat length.
+    std::int64_t blockStartSample = 0;
+    double beatPhase = 0.0;
+    double periodSamples = 0.0;
+    float confidence = 0.0f;
+    std::int64_t lastOnsetSample = 0;
+
+    bool clockRunning = false;
+    bool startPending = false;
+    std::int64_t lastTick = 0; // index of the last tick sent, in ticks of beatPhase
+};
+
+} // namespace audiotomidi
@@ -0,0 +1,119 @@
+#include "TimingHistogram.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+namespace audiotomidi {
+
+TimingHistogram::TimingHistogram(double minMs, double maxMs, int numBinsToUse)
+    : rangeStartMs(minMs),
+      binWidthMs((maxMs - minMs) / static_cast<double>(std::max(1, numBinsToUse))),
+      numBins(std::max(1, numBinsToUse)),
+      bins(std::make_unique<std::atomic<std::uint32_t>[]>(static_cast<size_t>(numBins + 2)))
+{
+    reset();
+}
+
+void TimingHistogram::record(double valueMs) noexcept
+{
+    int index = 0;
+    if (valueMs >= rangeStartMs)
+        index = std::min(numBins + 1, 1 + static_cast<int>((valueMs - rangeStartMs) / binWidthMs));
+
+    bins[static_cast<size_t>(index)].fetch_add(1, std::memory_order_relaxed);
+
+    // Single writer, so plain load/store pairs are enough for the running statistics.
+    const bool first = count.load(std::memory_order_relaxed) == 0;
+    sumMs.store(sumMs.load(std::memory_order_relaxed) + valueMs, std::memory_order_relaxed);
+    if (first || valueMs < minSeenMs.load(std::memory_order_relaxed))
+        minSeenMs.store(valueMs, std::memory_order_relaxed);
+    if (first || valueMs > maxSeenMs.load(std::memory_order_relaxed))
+        maxSeenMs.store(valueMs, std::memory_order_relaxed);
+
+    count.fetch_add(1, std::memory_order_release);
+}
+
+void TimingHistogram::reset() noexcept
+{
+    for (int i = 0; i < numBins + 2; ++i)
+        bins[static_cast<size_t>(i)].store(0, std::memory_order_relaxed);
+
+    sumMs.store(0.0, std::memory_order_relaxed);
+    minSeenMs.store(0.0, std::memory_order_relaxed);
+    maxSeenMs.store(0.0, std::memory_order_relaxed);
+    count.store(0, std::memory_order_release);
+}
+
+std::vector<std::uint32_t> TimingHistogram::getCounts() const
+{
+    std::vector<std::uint32_t> counts(static_cast<size_t>(numBins + 2));
+    for (size_t i = 0; i < counts.size(); ++i)
+        counts[i] = bins[i].load(std::memory_order_relaxed);
+    return counts;
+}
+
+double TimingHistogram::percentileFromCounts(const std::vector<std::uint32_t>& counts, std::uint64_t total, double fraction) const noexcept
+{
+    const auto target = static_cast<std::uint64_t>(std::ceil(fraction * static_cast<double>(total)));
+    std::uint64_t seen = 0;
+
+    for (size_t i = 0; i < counts.size(); ++i)
+    {
+        seen += counts[i];
+        if (seen >= target && seen > 0)
+        {
+            if (i == 0)
+                return rangeStartMs;
+            if (i == counts.size() - 1)
+                return rangeStartMs + binWidthMs * numBins;
+
+            // Upper edge of the bin, so a reported p99 is never optimistic.
+            return rangeStartMs + binWidthMs * static_cast<double>(i);
+        }
+    }
+
+    return rangeStartMs + binWidthMs * numBins;
+}
+
+TimingHistogram::Summary TimingHistogram::getSummary() const
+{
+    Summary summary;
+    summary.count = count.load(std::memory_order_acquire);
+    if (summary.count == 0)
+        return summary;
+
+    const auto counts = getCounts();
+    std::uint64_t total = 0;
+    for (auto c : counts)
+        total += c;
+
+    summary.meanMs = sumMs.load(std::memory_order_relaxed) / static_cast<double>(summary.count);
+    summary.minMs = minSeenMs.load(std::memory_order_relaxed);
+    summary.maxMs = maxSeenMs.load(std::memory_order_relaxed);
+    summary.p50Ms = percentileFromCounts(counts, total, 0.5);
+    summary.p99Ms = percentileFromCounts(counts, total, 0.99);
+    return summary;
+}
+
+std::string TimingHistogram::toCsvRows(const std::string& name) const
+{
+    const auto counts = getCounts();
+    std::string csv;
+    char row[128];
+
+    for (size_t i = 0; i < counts.size(); ++i)
+    {
+        if (counts[i] == 0)
+            continue;
+
+        const double start = i == 0 ? -INFINITY : rangeStartMs + binWidthMs * static_cast<double>(i - 1);
+        const double end = i == counts.size() - 1 ? INFINITY : rangeStartMs + binWidthMs * static_cast<double>(i);
+        std::snprintf(row, sizeof(row), "%s,%.3f,%.3f,%u\n", name.c_str(), start, end, static_cast<unsigned>(counts[i]));
+        csv += row;
+    }
+
+    return csv;
+}
+
+} // namespace audiotomidi
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace audiotomidi {
+
+// Fixed-bin histogram of millisecond timings. record() is wait-free and allocation-free and must
+// be called from a single thread (audio or dispatch); any thread may read summaries or export
+// CSV while it runs. Values outside [minMs, maxMs) land in under- and overflow bins.
+class TimingHistogram
+{
+public:
+    TimingHistogram(double minMs, double maxMs, int numBins);
+
+    void record(double valueMs) noexcept;
+
+    // Safe to call while recording; increments racing the reset may survive it.
+    void reset() noexcept;
+
+    struct Summary
+    {
+        std::uint64_t count = 0;
+        double meanMs = 0.0;
+        double minMs = 0.0;
+        double maxMs = 0.0;
+        double p50Ms = 0.0;
+        double p99Ms = 0.0;
+    };
+
+    Summary getSummary() const;
+
+    // Counts for every bin, underflow first and overflow last.
+    std::vector<std::uint32_t> getCounts() const;
+
+    int getNumBins() const noexcept { return numBins; }
+    double getRangeStartMs() const noexcept { return rangeStartMs; }
+    double getBinWidthMs() const noexcept { return binWidthMs; }
+
+    // One "name,bin_start_ms,bin_end_ms,count" row per non-empty bin, without a header.
+    std::string toCsvRows(const std::string& name) const;
+
+private:
+    double percentileFromCounts(const std::vector<std::uint32_t>& counts, std::uint64_t total, double fraction) const noexcept;
+
+    double rangeStartMs;
+    double binWidthMs;
+    int numBins;
+
+    std::unique_ptr<std::atomic<std::uint32_t>[]> bins;
+    std::atomic<std::uint64_t> count { 0 };
+    std::atomic<double> sumMs { 0.0 };
+    std::atomic<double> minSeenMs { 0.0 };
+    std::atomic<double> maxSeenMs { 0.0 };
+};
+
+} // namespace audiotomidi
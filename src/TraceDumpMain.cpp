@@ -0,0 +1,112 @@
+#include <iostream>
+#include <vector>
+
+#include <juce_core/juce_core.h>
+
+#include "FlightRecorder.h"
+
+namespace
+{
+using Record = audiotomidi::FlightRecorder::Record;
+
+void printUsage()
+{
+    std::cout << "Usage: AudioToMidiBeatTraceDump [--out=<file.csv>] <trace files...>\n"
+                 "\n"
+                 "Converts flight recorder traces to CSV, one row per record, in the order given.\n"
+                 "A trace's .prev.bin segment, when present and not listed, is read before it.\n"
+                 "\n"
+                 "Options:\n"
+                 "  --out=<file>    write the CSV here (default: stdout)\n";
+}
+
+// Session rows carry the sample rate, block rows the detector state, trigger rows strength and note.
+juce::String toCsvRow(const Record& record, double sampleRate)
+{
+    const auto time = juce::String(static_cast<double>(record.samplePosition) / sampleRate, 6);
+    const auto position = juce::String(static_cast<juce::int64>(record.samplePosition));
+
+    switch (record.kind)
+    {
+        case Record::Kind::Session:
+            return "session," + position + "," + time + ",,,,,,,," + juce::String(juce::roundToInt(sampleRate));
+        case Record::Kind::Block:
+            return "block," + position + "," + time + "," + juce::String(record.numSamples) + "," + juce::String(record.value, 6) + ","
+                 + juce::String(record.envelope, 6) + "," + juce::String(record.noiseFloor, 6) + "," + juce::String(record.threshold, 6) + ",,,";
+        case Record::Kind::Trigger:
+            return "trigger," + position + "," + time + ",,,,,," + juce::String(record.value, 4) + "," + juce::String(static_cast<int>(record.note)) + ",";
+    }
+
+    return {};
+}
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    juce::File outFile;
+    juce::StringArray traces;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const juce::String arg(juce::CharPointer_UTF8(argv[i]));
+        if (arg.startsWith("--out="))
+            outFile = juce::File::getCurrentWorkingDirectory().getChildFile(arg.fromFirstOccurrenceOf("=", false, false));
+        else if (arg.startsWith("-"))
+        {
+            printUsage();
+            return arg == "--help" || arg == "-h" ? 0 : 1;
+        }
+        else
+            traces.add(juce::File::getCurrentWorkingDirectory().getChildFile(arg).getFullPathName());
+    }
+
+    if (traces.isEmpty())
+    {
+        printUsage();
+        return 1;
+    }
+
+    juce::Array<juce::File> files;
+    for (const auto& path : traces)
+    {
+        const juce::File file(path);
+        const auto previous = file.getSiblingFile(file.getFileNameWithoutExtension() + ".prev.bin");
+        if (!file.getFileName().endsWith(".prev.bin") && previous.existsAsFile() && !traces.contains(previous.getFullPathName()))
+            files.add(previous);
+        files.add(file);
+    }
+
+    juce::String csv = "kind,sample,time_s,num_samples,input_peak,envelope,noise_floor,threshold,strength,note,sample_rate\n";
+    int numRecords = 0;
+    for (const auto& file : files)
+    {
+        std::vector<Record> records;
+        if (!audiotomidi::FlightRecorder::readTrace(file, records))
+        {
+            std::cerr << "Not a readable trace: " << file.getFullPathName() << "\n";
+            return 1;
+        }
+
+        double sampleRate = 44100.0;
+        for (const auto& record : records)
+        {
+            if (record.kind == Record::Kind::Session && record.value > 0.0f)
+                sampleRate = static_cast<double>(record.value);
+
+            csv << toCsvRow(record, sampleRate) << "\n";
+        }
+
+        numRecords += static_cast<int>(records.size());
+    }
+
+    if (outFile == juce::File())
+        std::cout << csv;
+    else if (!outFile.replaceWithText(csv))
+    {
+        std::cerr << "Cannot write " << outFile.getFullPathName() << "\n";
+        return 1;
+    }
+
+    std::cerr << numRecords << " records from " << files.size() << " file(s)\n";
+    return 0;
+}
@@ -0,0 +1,111 @@
+#include "TriggerEngine.h"
+
+#include <algorithm>
+
+namespace audiotomidi {
+
+namespace
+{
+// Slice length used while a detector parameter is ramping; short enough that a sensitivity
+// ramp moves in sub-millisecond steps.
+constexpr int kAutomationSliceSamples = 32;
+} // namespace
+
+void TriggerEngine::prepare(double sampleRate)
+{
+    detector.prepare(sampleRate);
+    detectorBank.prepare(sampleRate);
+    spectralDetector.prepare(sampleRate);
+    neuralDetector.prepare(sampleRate);
+    midiEngine.prepare(sampleRate);
+    tempoTracker.prepare(sampleRate);
+    hasPreviousDetectorParams = false;
+}
+
+void TriggerEngine::reset() noexcept
+{
+    detector.reset();
+    detectorBank.reset();
+    spectralDetector.reset();
+    neuralDetector.reset();
+    midiEngine.reset();
+    tempoTracker.reset();
+    hasPreviousDetectorParams = false;
+}
+
+void TriggerEngine::restart(juce::MidiBuffer& midi, int offset) noexcept
+{
+    midiEngine.releaseAll(midi, offset);
+    tempoTracker.stopClock(midi, offset);
+    reset();
+}
+
+int TriggerEngine::getLatencySamples(const ParameterSnapshot& params) const noexcept
+{
+    if (params.multiInput)
+        return 0;
+
+    switch (params.engine)
+    {
+        case DetectorEngine::SpectralFlux: return spectralDetector.getLatencySamples();
+        case DetectorEngine::Neural: return neuralDetector.getLatencySamples();
+        case DetectorEngine::Envelope: break;
+    }
+
+    return detector.getLatencySamples(params.detector);
+}
+
+void TriggerEngine::detect(const float* mono, const float* const* channels, int numChannels, int numSamples, float inputPeak,
+                           const ParameterSnapshot& params, BeatDetector::TriggerBuffer& triggers) noexcept
+{
+    if (!hasPreviousDetectorParams)
+    {
+        previousDetectorParams = params.detector;
+        hasPreviousDetectorParams = true;
+    }
+
+    if (params.multiInput)
+        detectorBank.processBlock(channels, numChannels, numSamples, params.detector, params.laneNotes, triggers);
+    else if (params.engine == DetectorEngine::SpectralFlux)
+        spectralDetector.processBlock(mono, numSamples, params.detector, triggers);
+    else if (params.engine == DetectorEngine::Neural)
+        neuralDetector.processBlock(mono, numSamples, params.detector, triggers);
+    else
+        runEnvelopeDetector(mono, numSamples, inputPeak, params.detector, triggers);
+
+    previousDetectorParams = params.detector;
+}
+
+void TriggerEngine::generateMidi(const BeatDetector::TriggerBuffer& triggers, juce::MidiBuffer& midi, int numSamples,
+                                 const ParameterSnapshot& params) noexcept
+{
+    midiEngine.process(triggers, midi, numSamples, params.midi);
+    tempoTracker.process(triggers, midi, numSamples, params.midiClock);
+}
+
+void TriggerEngine::runEnvelopeDetector(const float* mono, int numSamples, float inputPeak, const BeatDetector::Params& params,
+                                        BeatDetector::TriggerBuffer& triggers) noexcept
+{
+    const auto& from = previousDetectorParams;
+    if (from.sensitivity == params.sensitivity && from.minGapMs == params.minGapMs)
+    {
+        detector.processBlock(mono, numSamples, params, triggers, inputPeak);
+        return;
+    }
+
+    // The host's parameter value is the one at the end of this block, so ramp linearly from the
+    // previous block's value across the block instead of stepping at its start.
+    triggers.count = 0;
+    for (int start = 0; start < numSamples; start += kAutomationSliceSamples)
+    {
+        const int length = std::min(kAutomationSliceSamples, numSamples - start);
+        const auto position = static_cast<float>(start + length) / static_cast<float>(numSamples);
+
+        auto sliceParams = params;
+        sliceParams.sensitivity = juce::jmap(position, from.sensitivity, params.sensitivity);
+        sliceParams.minGapMs = juce::jmap(position, from.minGapMs, params.minGapMs);
+        detector.processRange(mono, start, length, sliceParams, triggers);
+    }
+}
+
+} // namespace audiotomidi
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <juce_audio_basics/juce_audio_basics.h>
+
+#include "BeatDetector.h"
+#include "DetectorBank.h"
+#include "MidiEngine.h"
+#include "NeuralOnsetDetector.h"
+#include "ParameterSnapshot.h"
+#include "SpectralFluxDetector.h"
+#include "TempoTracker.h"
+
+namespace audiotomidi {
+
+// The plugin's processing from the downmixed input to the MIDI output: the detector the
+// parameters select, MidiEngine and TempoTracker. The plugin and the capture replay tool both run
+// it, so a replayed block takes exactly the code path the live block took. prepare() allocates;
+// everything else is real-time safe.
+class TriggerEngine
+{
+public:
+    void prepare(double sampleRate);
+    void reset() noexcept;
+
+    // Sends a note-off for every held note and Stop for a running MIDI clock at offset, then
+    // resets, leaving the state prepare() leaves.
+    void restart(juce::MidiBuffer& midi, int offset) noexcept;
+
+    // Delay of the detector params select, in samples.
+    int getLatencySamples(const ParameterSnapshot& params) const noexcept;
+
+    // Runs the selected detector over one block. mono is the downmix of the numChannels input
+    // channels, and inputPeak its absolute peak; multi-input mode reads the channels instead.
+    // While sensitivity or minimum gap differ from the previous block, the envelope detector
+    // processes the block in short slices with interpolated values.
+    void detect(const float* mono, const float* const* channels, int numChannels, int numSamples, float inputPeak,
+                const ParameterSnapshot& params, BeatDetector::TriggerBuffer& triggers) noexcept;
+
+    // Appends the block's notes and, when enabled, MIDI clock to midi.
+    void generateMidi(const BeatDetector::TriggerBuffer& triggers, juce::MidiBuffer& midi, int numSamples,
+                      const ParameterSnapshot& params) noexcept;
+
+    const BeatDetector& getDetector() const noexcept { return detector; }
+    const TempoTracker& getTempoTracker() const noexcept { return tempoTracker; }
+
+private:
+    void runEnvelopeDetector(const float* mono, int numSamples, float inputPeak, const BeatDetector::Params& params,
+                             BeatDetector::TriggerBuffer& triggers) noexcept;
+
+    BeatDetector detector;
+    DetectorBank detectorBank;
+    SpectralFluxDetector spectralDetector;
+    NeuralOnsetDetector neuralDetector;
+    MidiEngine midiEngine;
+    TempoTracker tempoTracker;
+
+    // Detector parameters of the previous block, the start point of any automation ramp. The
+    // first block after a reset has none and does not ramp.
+    BeatDetector::Params previousDetectorParams;
+    bool hasPreviousDetectorParams = false;
+};
+
+} // namespace audiotomidi
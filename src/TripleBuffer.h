@@ -0,0 +1,51 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <type_traits>
+
+namespace audiotomidi {
+
+// Hands the latest value from one writer thread to one reader thread without locks or
+// allocation. The writer fills a private back slot and swaps it with the shared middle slot; the
+// reader swaps the middle slot into its private front slot only when something new was written.
+// Both sides are a single atomic exchange, so neither can block the other, and the reader always
+// sees a complete value.
+template <typename T>
+class TripleBuffer
+{
+public:
+    static_assert(std::is_trivially_copyable_v<T>, "TripleBuffer values are copied on the audio thread");
+    static_assert(std::atomic<int>::is_always_lock_free, "TripleBuffer needs a lock-free atomic int");
+
+    TripleBuffer() noexcept = default;
+    explicit TripleBuffer(const T& initial) noexcept { slots.fill(initial); }
+
+    // Writer thread only.
+    void write(const T& value) noexcept
+    {
+        slots[static_cast<std::size_t>(backIndex)] = value;
+        backIndex = state.exchange(backIndex | freshBit, std::memory_order_acq_rel) & indexMask;
+    }
+
+    // Reader thread only. The reference stays valid until the next call to read().
+    const T& read() noexcept
+    {
+        if ((state.load(std::memory_order_relaxed) & freshBit) != 0)
+            frontIndex = state.exchange(frontIndex, std::memory_order_acq_rel) & indexMask;
+
+        return slots[static_cast<std::size_t>(frontIndex)];
+    }
+
+private:
+    static constexpr int indexMask = 3;
+    static constexpr int freshBit = 4;
+
+    std::array<T, 3> slots {};
+    std::atomic<int> state { 1 };
+    int backIndex = 0;
+    int frontIndex = 2;
+};
+
+} // namespace audiotomidi